@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace reaplus {
+  // Position of one audio block on the continuous timeline of the audio hook (starts at zero when ReaPlus is
+  // initialized, independent of transport)
+  struct AudioBlockClock {
+    // Number of samples processed before this block
+    uint64_t blockStartSample;
+    // Seconds processed before this block. Stays accurate if the sample rate changes.
+    double blockStartTime;
+    double sampleRate;
+    int blockLength;
+
+    // Converts a frame offset as delivered by midi_Input::GetReadBuf() (1/1024000 seconds) into an absolute sample
+    uint64_t sampleTimeOf(int midiFrameOffset) const;
+
+    // Converts a frame offset as delivered by midi_Input::GetReadBuf() (1/1024000 seconds) into absolute seconds
+    double timeOf(int midiFrameOffset) const;
+  };
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+// Coroutines need C++20. The library itself is built as C++17, so everything in here is header-only and available only
+// to client code which is compiled with coroutine support.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include "Reaper.h"
+#include "Fx.h"
+#include "Track.h"
+#include "util/FramePool.h"
+#include "util/log.h"
+
+namespace reaplus {
+  namespace detail {
+    struct CoroutineState {
+      // Set in the main thread, read when the coroutine is resumed (which can be in another thread before it awaits
+      // mainThread())
+      std::atomic<bool> isCancelled{false};
+      // Main thread only from here on
+      bool isDone = false;
+      // Set while the coroutine is suspended and waits to be resumed by a subscription
+      std::coroutine_handle<> suspendedHandle;
+      rxcpp::composite_subscription pendingResumption;
+      // Incremented on each suspension, so that late callbacks of earlier suspensions are ignored
+      uint64_t suspensionCount = 0;
+    };
+  }
+
+  // Return type of fire-and-forget coroutines which run in the main thread, e.g.:
+  //
+  //   MainThreadTask addFxLater(Track track) {
+  //     co_await after(std::chrono::milliseconds(500));
+  //     auto fx = co_await nextFxAdded(track);
+  //     ...
+  //   }
+  //
+  // The coroutine starts immediately and runs until the first co_await. Frames and their shared state come from
+  // util::FramePool, so starting many short-lived coroutines doesn't go through the global allocator. Dropping the task doesn't stop the coroutine,
+  // cancel() does. Exceptions escaping the coroutine are logged.
+  class MainThreadTask {
+  public:
+    struct promise_type {
+      // Pooled like the frame itself
+      std::shared_ptr<detail::CoroutineState> state =
+          std::allocate_shared<detail::CoroutineState>(util::FramePoolAllocator<detail::CoroutineState>());
+
+      static void* operator new(size_t size) {
+        return util::FramePool::instance().allocate(size);
+      }
+
+      static void operator delete(void* frame, size_t size) {
+        util::FramePool::instance().deallocate(frame, size);
+      }
+
+      ~promise_type() {
+        // Reached when the coroutine finishes and when it's destroyed because of cancellation
+        state->isDone = true;
+        state->suspendedHandle = nullptr;
+      }
+
+      MainThreadTask get_return_object() {
+        return MainThreadTask(state);
+      }
+
+      std::suspend_never initial_suspend() noexcept {
+        return {};
+      }
+
+      std::suspend_never final_suspend() noexcept {
+        return {};
+      }
+
+      void return_void() {
+      }
+
+      void unhandled_exception() {
+        util::logException();
+      }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+  private:
+    std::shared_ptr<detail::CoroutineState> state_;
+
+    explicit MainThreadTask(std::shared_ptr<detail::CoroutineState> state) : state_(std::move(state)) {
+    }
+
+  public:
+    // Main thread
+    bool isDone() const {
+      return state_->isDone;
+    }
+
+    // Main thread. If the coroutine is suspended, it's destroyed right away (destructors of its locals run), otherwise
+    // at its next co_await. Doesn't do anything if the coroutine is done already.
+    void cancel() {
+      state_->isCancelled = true;
+      if (const auto handle = std::exchange(state_->suspendedHandle, nullptr)) {
+        std::exchange(state_->pendingResumption, rxcpp::composite_subscription()).unsubscribe();
+        handle.destroy();
+      }
+    }
+  };
+
+  namespace detail {
+    // Resumes a coroutine unless it has been resumed or cancelled since the suspension this object belongs to
+    class Resumption {
+    private:
+      std::shared_ptr<CoroutineState> state_;
+      uint64_t suspensionCount_;
+
+    public:
+      Resumption(std::shared_ptr<CoroutineState> state, uint64_t suspensionCount)
+          : state_(std::move(state)), suspensionCount_(suspensionCount) {
+      }
+
+      bool isPending() const {
+        return state_->suspensionCount == suspensionCount_ && state_->suspendedHandle;
+      }
+
+      void operator()() const {
+        if (!isPending()) {
+          return;
+        }
+        const auto handle = std::exchange(state_->suspendedHandle, nullptr);
+        state_->pendingResumption = rxcpp::composite_subscription();
+        handle.resume();
+      }
+    };
+
+    // Main thread. Suspends the coroutine until the subscription created by the given function calls the passed
+    // Resumption. The subscription may also resume synchronously.
+    template<typename Subscribe>
+    void suspendUntil(MainThreadTask::Handle handle, Subscribe&& subscribe) {
+      auto state = handle.promise().state;
+      if (state->isCancelled) {
+        handle.destroy();
+        return;
+      }
+      const auto suspensionCount = ++state->suspensionCount;
+      state->suspendedHandle = handle;
+      auto subscription = subscribe(Resumption(state, suspensionCount));
+      if (state->suspensionCount == suspensionCount && state->suspendedHandle) {
+        state->pendingResumption = std::move(subscription);
+      } else {
+        // Resumed synchronously (and maybe suspended again in the meantime)
+        subscription.unsubscribe();
+      }
+    }
+
+    class MainThreadAwaitable {
+    public:
+      bool await_ready() const {
+        return Reaper::instance().currentThreadIsMainThread();
+      }
+
+      void await_suspend(MainThreadTask::Handle handle) const {
+        // No suspendUntil() because we are not in the main thread. Cancellation is checked when arriving there.
+        Reaper::instance().executeLaterInMainThreadFast([handle] {
+          if (handle.promise().state->isCancelled) {
+            handle.destroy();
+          } else {
+            handle.resume();
+          }
+        });
+      }
+
+      void await_resume() const {
+      }
+    };
+
+    class NextIdleTickAwaitable {
+    public:
+      bool await_ready() const {
+        return false;
+      }
+
+      void await_suspend(MainThreadTask::Handle handle) const {
+        suspendUntil(handle, [](Resumption resume) {
+          return Reaper::instance().mainThreadIdle().take(1).subscribe([resume](auto) {
+            resume();
+          });
+        });
+      }
+
+      void await_resume() const {
+      }
+    };
+
+    class AfterAwaitable {
+    private:
+      std::chrono::milliseconds delay_;
+      rxcpp::observe_on_one_worker coordination_;
+
+    public:
+      AfterAwaitable(std::chrono::milliseconds delay, rxcpp::observe_on_one_worker coordination)
+          : delay_(delay), coordination_(std::move(coordination)) {
+      }
+
+      bool await_ready() const {
+        return delay_.count() <= 0;
+      }
+
+      void await_suspend(MainThreadTask::Handle handle) const {
+        suspendUntil(handle, [this](Resumption resume) {
+          return rxcpp::observable<>::timer(delay_, coordination_)
+              .subscribe([resume](auto) {
+                resume();
+              });
+        });
+      }
+
+      void await_resume() const {
+      }
+    };
+
+    template<typename T>
+    class NextValueAwaitable {
+    private:
+      rxcpp::observable<T> observable_;
+      std::optional<T> value_;
+
+    public:
+      explicit NextValueAwaitable(rxcpp::observable<T> observable) : observable_(std::move(observable)) {
+      }
+
+      bool await_ready() const {
+        return false;
+      }
+
+      void await_suspend(MainThreadTask::Handle handle) {
+        suspendUntil(handle, [this](Resumption resume) {
+          return observable_.take(1).subscribe([this, resume](const T& value) {
+            // The awaitable lives in the coroutine frame, which only exists as long as the resumption is pending
+            if (resume.isPending()) {
+              value_ = value;
+              resume();
+            }
+          });
+        });
+      }
+
+      T await_resume() {
+        return std::move(*value_);
+      }
+    };
+  }
+
+  // Continues in the main thread. Doesn't suspend if already there.
+  inline detail::MainThreadAwaitable mainThread() {
+    return {};
+  }
+
+  // Main thread. Continues when REAPER's main loop is idle the next time.
+  inline detail::NextIdleTickAwaitable nextIdleTick() {
+    return {};
+  }
+
+  // Main thread. Continues in the main thread after the given delay.
+  inline detail::AfterAwaitable after(std::chrono::milliseconds delay) {
+    return detail::AfterAwaitable(delay, Reaper::instance().mainThreadCoordination());
+  }
+
+  // Like after(delay) but the timer runs on the given coordination, which must resume in the thread the coroutine
+  // runs in. Allows driving coroutines without REAPER's main loop, e.g. in tests.
+  inline detail::AfterAwaitable after(std::chrono::milliseconds delay, rxcpp::observe_on_one_worker coordination) {
+    return detail::AfterAwaitable(delay, std::move(coordination));
+  }
+
+  // Main thread. Continues with the next value of the given observable, which must emit in the main thread. If the
+  // observable completes without a value, the coroutine stays suspended until it's cancelled.
+  template<typename T>
+  detail::NextValueAwaitable<T> nextValue(rxcpp::observable<T> observable) {
+    return detail::NextValueAwaitable<T>(std::move(observable));
+  }
+
+  // Main thread. Continues with the next FX added to the given track.
+  inline detail::NextValueAwaitable<Fx> nextFxAdded(Track track) {
+    return nextValue(Reaper::instance().fxAdded().filter([track = std::move(track)](const Fx& fx) {
+      return fx.track() == track;
+    }).as_dynamic());
+  }
+}
+
+#endif
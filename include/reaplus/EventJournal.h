@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "reaper_plugin.h"
+
+namespace reaplus {
+  enum class EventJournalRecordKind : uint16_t {
+    SetSurfaceVolume,
+    SetSurfacePan,
+    SetSurfaceMute,
+    SetSurfaceSelected,
+    SetSurfaceSolo,
+    SetSurfaceRecArm,
+    SetTrackTitle,
+    SetTrackListChange,
+    SetAutoMode,
+    Extended,
+    HookPostCommand,
+    IncomingMidiEvent,
+    IncomingSysExData
+  };
+
+  // Compact binary representation of one event as it came in from REAPER. The meaning of the generic fields depends
+  // on the kind:
+  // - Control surface callbacks: track = MediaTrack*, int1 = bool/int argument, double1 = double argument
+  // - Extended: track = parm1 if it's a MediaTrack*, int1 = call, int2 = int behind parm2 or parm3,
+  //   double1/double2 = doubles behind the other parameters, flags = which parameters were non-null (bits 0 to 2)
+  // - HookPostCommand: int1 = command ID, int2 = flag
+  // - IncomingMidiEvent: int1 = MIDI input device ID, int2 = frame offset, data = status and data bytes (LSB first),
+  //   flags = number of bytes. More than 3 bytes means SysEx, whose payload follows in IncomingSysExData records.
+  //   0 bytes means SysEx which was too large to be recorded.
+  // - IncomingSysExData: int1 = MIDI input device ID, int2 = offset within the SysEx message, track, double1,
+  //   double2 and data = raw payload bytes (EventJournal::SYSEX_BYTES_PER_RECORD, the last record is padded). Records
+  //   of other threads can come in between.
+  // In dumped files, track is not a pointer but the track index as returned by CSurf_TrackToID plus one (0 = none).
+  struct EventJournalRecord {
+    uint64_t timestamp;
+    uint64_t track;
+    double double1;
+    double double2;
+    int32_t int1;
+    int32_t int2;
+    uint32_t data;
+    EventJournalRecordKind kind;
+    uint16_t flags;
+  };
+
+  // Fixed-size lock-free ring buffer which records incoming events for offline analysis and replay. Records can be
+  // written from any thread (main thread callbacks and audio thread MIDI events) without locking or allocating. If
+  // the buffer is full, the oldest records are overwritten. Timestamps are nanoseconds since the journal was started.
+  class EventJournal {
+  private:
+    struct alignas(64) Slot {
+      // 2 * ticket + 1 while being written, 2 * ticket + 2 when complete
+      std::atomic<uint64_t> sequence{0};
+      EventJournalRecord record;
+    };
+    std::unique_ptr<Slot[]> slots_;
+    uint64_t capacityMask_;
+    std::atomic<uint64_t> writeTicket_{0};
+    // Records with older tickets are not dumped. Allows restarting without touching the slots.
+    std::atomic<uint64_t> firstTicket_{0};
+    std::atomic<int64_t> startTimeNanos_{0};
+  public:
+    // SysEx messages which are larger than this are only recorded as such, without payload
+    static constexpr size_t MAX_SYSEX_SIZE = 4096;
+    static constexpr size_t SYSEX_BYTES_PER_RECORD = 28;
+
+    // Capacity is rounded up to the next power of two
+    explicit EventJournal(size_t capacity);
+
+    size_t capacity() const;
+
+    // Forgets all records and resets the timestamp origin
+    void restart();
+
+    void record(EventJournalRecordKind kind, MediaTrack* track, int int1 = 0, int int2 = 0, double double1 = 0,
+        double double2 = 0, uint32_t data = 0, uint16_t flags = 0);
+
+    void recordExtended(int call, void* parm1, void* parm2, void* parm3);
+
+    void recordIncomingMidiEvent(int inputDeviceId, const MIDI_event_t& midiEvent);
+
+    // Must be called in main thread because tracks are translated to track indexes. Returns the number of written
+    // records. Records which were overwritten while dumping are left out.
+    size_t dump(const std::string& filePath) const;
+
+    // Reads a dumped file. Throws if the file can't be read.
+    static std::vector<EventJournalRecord> load(const std::string& filePath);
+
+    // Resolves the track of a loaded record in the current project. Returns nullptr if the record doesn't refer to a
+    // track or the track doesn't exist.
+    static MediaTrack* resolveTrack(const EventJournalRecord& record);
+
+    // Feeds a loaded control surface record back into the given control surface. Must be called in main thread.
+    // Returns false if the record couldn't be replayed (e.g. track doesn't exist or unsupported Extended call).
+    static bool replayControlSurfaceRecord(const EventJournalRecord& record, IReaperControlSurface& controlSurface);
+
+    // Copies the payload of a loaded IncomingSysExData record to its offset within sysExData. Returns the number of
+    // copied bytes, 0 if the record doesn't fit into a SysEx message of the given size.
+    static size_t copySysExData(const EventJournalRecord& record, unsigned char* sysExData, size_t sysExSize);
+
+  private:
+    uint64_t nowNanos() const;
+
+    template<typename Fill>
+    void write(EventJournalRecordKind kind, Fill&& fill);
+  };
+}
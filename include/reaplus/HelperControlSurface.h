@@ -6,12 +6,18 @@
 #include <memory>
 #include <vector>
 #include <array>
+#include <cstdint>
 #include <string>
 #include <mutex>
 #include <boost/optional.hpp>
 #include "reaper_plugin.h"
 #include "rxcpp/rx.hpp"
-#include "util/rx-relaxed-runloop.hpp"
+#include "util/rx-timer-wheel-runloop.hpp"
+#include "util/KeyedSubjects.h"
+#include "util/ListenerMask.h"
+#include "util/InplaceTask.h"
+#include "MainThreadScheduler.h"
+#include "MainThreadProfiler.h"
 #include "Project.h"
 #include "Fx.h"
 #include "FxParameter.h"
@@ -29,6 +35,15 @@ namespace reaplus {
 
   class Reaper;
 
+  // Track parameters which can be automated and whose envelope presence is cached in TrackData
+  enum class TrackEnvelopeType : int {
+    Volume,
+    Pan,
+    Mute,
+    SendVolume,
+    SendPan
+  };
+
   // DONE-rust
   struct TrackData {
     double volume;
@@ -41,12 +56,55 @@ namespace reaplus {
     int recmonitor;
     int recinput;
     std::string guid;
+    // Cached automation state for classifying changes as "touched". Valid as long as it equals the surface's
+    // automation state generation, refreshed lazily on next use.
+    uint64_t automationStateGeneration = 0;
+    // Bit n is set if the track has an envelope for TrackEnvelopeType n
+    int envelopeFlags = 0;
+    bool automationModeReadsEnvelopes = false;
+  };
+
+  // Identifies an FX parameter in keyed subscriptions. The FX must be GUID-based.
+  struct FxParameterKey {
+    MediaTrack* mediaTrack;
+    std::string fxGuid;
+    int paramIndex;
+
+    friend bool operator==(const FxParameterKey& lhs, const FxParameterKey& rhs);
+  };
+
+  struct FxParameterKeyHash {
+    std::size_t operator()(const FxParameterKey& key) const;
+  };
+
+  // Prebuilt FX parameter handle for emitting FX parameter events without querying REAPER
+  struct CachedFxParameter {
+    FxParameter parameter;
+    FxParameterKey key;
+  };
+
+  // Prebuilt FX handles of one track, indexed by FX index and parameter index. Filled lazily.
+  struct FxHandleCache {
+    struct Entry {
+      Fx fx;
+      std::vector<std::shared_ptr<const CachedFxParameter>> parameters;
+    };
+    std::vector<boost::optional<Entry>> normalFxs;
+    std::vector<boost::optional<Entry>> inputFxs;
+  };
+
+  // Binary FX GUIDs of one FX chain
+  struct FxChainGuids {
+    // In chain order
+    std::vector<GUID> ordered;
+    // Same GUIDs but sorted, for diffing
+    std::vector<GUID> sorted;
   };
 
   // DONE-rust
   struct FxChainPair {
-    std::set<std::string> inputFxGuids;
-    std::set<std::string> outputFxGuids;
+    FxChainGuids inputFxGuids;
+    FxChainGuids outputFxGuids;
   };
 
   class HelperControlSurface : public IReaperControlSurface {
@@ -65,10 +123,42 @@ namespace reaplus {
       PropagatingTrackSetChanges
     };
 
+    // Events whose payload is only built if somebody listens. At most 64.
+    enum class EventKind : int {
+      FxParameterValueChanged,
+      FxParameterTouched,
+      FxEnabledChanged,
+      TrackVolumeChanged,
+      TrackVolumeTouched,
+      TrackPanChanged,
+      TrackPanTouched,
+      TrackSendVolumeChanged,
+      TrackSendVolumeTouched,
+      TrackSendPanChanged,
+      TrackSendPanTouched,
+      TrackNameChanged,
+      TrackArmChanged,
+      TrackMuteChanged,
+      TrackMuteTouched,
+      TrackSoloChanged,
+      TrackSelectedChanged,
+      TrackInputMonitoringChanged,
+      TrackInputChanged
+    };
+
+    struct FxChainChanges {
+      bool addedOrRemoved = false;
+      // True if the order of FX which have been there before and are still there has changed
+      bool reordered = false;
+    };
+
     // DONE-rust
     static std::unique_ptr<HelperControlSurface> INSTANCE;
-    // DONE-rust
-    static constexpr int FAST_COMMAND_BUFFER_SIZE = 100;
+    // Run() is called about 30 times per second, so this is roughly once per second
+    static constexpr int MIDI_DEVICE_REFRESH_INTERVAL_IN_RUN_CYCLES = 30;
+    int runCyclesSinceMidiDeviceRefresh_ = 0;
+    // Incremented to invalidate the cached automation state of all tracks at once
+    uint64_t automationStateGeneration_ = 1;
     // DONE-rust
     int numTrackSetChangesLeftToBePropagated_ = 0;
     // DONE-rust
@@ -104,12 +194,27 @@ namespace reaplus {
     rxcpp::subjects::subject<Fx> fxClosedSubject_;
     rxcpp::subjects::subject<boost::optional<Fx>> fxFocusedSubject_;
     rxcpp::subjects::subject<Track> fxReorderedSubject_;
+    rxcpp::subjects::subject<Fx> fxMovedSubject_;
     rxcpp::subjects::subject<bool> masterTempoChangedSubject_;
     rxcpp::subjects::subject<bool> masterTempoTouchedSubject_;
     rxcpp::subjects::subject<bool> masterPlayrateChangedSubject_;
     rxcpp::subjects::subject<bool> masterPlayrateTouchedSubject_;
     rxcpp::subjects::subject<bool> mainThreadIdleSubject_;
     rxcpp::subjects::subject<Project> projectClosedSubject_;
+    // Which of the events above currently have listeners, including keyed ones
+    util::ListenerMask listenerMask_;
+    // Keyed variants of some of the subjects above
+    util::KeyedSubjects<FxParameterKey, FxParameter, FxParameterKeyHash> fxParameterValueChangedByKey_;
+    util::KeyedSubjects<FxParameterKey, FxParameter, FxParameterKeyHash> fxParameterTouchedByKey_;
+    util::KeyedSubjects<MediaTrack*, Track> trackVolumeChangedByMediaTrack_;
+    util::KeyedSubjects<MediaTrack*, Track> trackVolumeTouchedByMediaTrack_;
+    util::KeyedSubjects<MediaTrack*, Track> trackPanChangedByMediaTrack_;
+    util::KeyedSubjects<MediaTrack*, Track> trackPanTouchedByMediaTrack_;
+    util::KeyedSubjects<MediaTrack*, Track> trackMuteChangedByMediaTrack_;
+    util::KeyedSubjects<MediaTrack*, Track> trackMuteTouchedByMediaTrack_;
+    util::KeyedSubjects<MediaTrack*, Track> trackSoloChangedByMediaTrack_;
+    util::KeyedSubjects<MediaTrack*, Track> trackArmChangedByMediaTrack_;
+    util::KeyedSubjects<MediaTrack*, Track> trackSelectedChangedByMediaTrack_;
     // DONE-rust
     rxcpp::subjects::behavior<Project> activeProjectBehavior_;
     // DONE-rust
@@ -118,15 +223,20 @@ namespace reaplus {
     std::unordered_map<ReaProject*, TrackDataMap> trackDataByMediaTrackByReaProject_;
     // DONE-rust
     std::unordered_map<MediaTrack*, FxChainPair> fxChainPairByMediaTrack_;
-    rxcpp::schedulers::relaxed_run_loop mainThreadRunLoop_;
+    // Reused when diffing FX chains in order to avoid allocations
+    std::vector<GUID> currentFxGuidsBuffer_;
+    std::vector<GUID> sortedFxGuidsBuffer_;
+    // Invalidated whenever FX changes are detected on a track
+    std::unordered_map<MediaTrack*, FxHandleCache> fxHandleCacheByMediaTrack_;
+    rxcpp::schedulers::timer_wheel_run_loop mainThreadRunLoop_;
     rxcpp::observe_on_one_worker mainThreadCoordination_ =
-        rxcpp::observe_on_one_worker(rxcpp::schedulers::make_relaxed_run_loop(mainThreadRunLoop_));
+        rxcpp::observe_on_one_worker(rxcpp::schedulers::make_timer_wheel_run_loop(mainThreadRunLoop_));
     rxcpp::observe_on_one_worker::coordinator_type
         mainThreadCoordinator_ = mainThreadCoordination_.create_coordinator();
-    // DONE-rust
-    moodycamel::ConcurrentQueue<std::function<void(void)>> fastCommandQueue_;
-    // DONE-rust
-    std::array<std::function<void(void)>, FAST_COMMAND_BUFFER_SIZE> fastCommandBuffer_;
+    // Executes fast commands and the main thread run loop within a time budget
+    MainThreadScheduler mainThreadScheduler_;
+    // Times Run() and the other callbacks
+    MainThreadProfiler mainThreadProfiler_;
 
     // Capabilities depending on REAPER version
     // DONE-rust
@@ -177,6 +287,8 @@ namespace reaplus {
     // DONE-rust
     void SetSurfaceRecArm(MediaTrack* trackid, bool recarm) override;
 
+    void SetAutoMode(int mode) override;
+
   protected:
 
     // DONE-rust
@@ -254,6 +366,8 @@ namespace reaplus {
 
     rxcpp::observable<Track> fxReordered() const;
 
+    rxcpp::observable<Fx> fxMoved() const;
+
     rxcpp::observable<Fx> fxOpened() const;
 
     rxcpp::observable<Fx> fxClosed() const;
@@ -270,9 +384,37 @@ namespace reaplus {
 
     rxcpp::observable<bool> mainThreadIdle() const;
 
+    // Keyed subscriptions. They only emit events concerning the given track or FX parameter.
+
+    rxcpp::observable<FxParameter> fxParameterValueChanged(const FxParameter& fxParameter);
+
+    rxcpp::observable<FxParameter> fxParameterTouched(const FxParameter& fxParameter);
+
+    rxcpp::observable<Track> trackVolumeChanged(const Track& track);
+
+    rxcpp::observable<Track> trackVolumeTouched(const Track& track);
+
+    rxcpp::observable<Track> trackPanChanged(const Track& track);
+
+    rxcpp::observable<Track> trackPanTouched(const Track& track);
+
+    rxcpp::observable<Track> trackMuteChanged(const Track& track);
+
+    rxcpp::observable<Track> trackMuteTouched(const Track& track);
+
+    rxcpp::observable<Track> trackSoloChanged(const Track& track);
+
+    rxcpp::observable<Track> trackArmChanged(const Track& track);
+
+    rxcpp::observable<Track> trackSelectedChanged(const Track& track);
+
     rxcpp::composite_subscription enqueueCommand(std::function<void(void)> command);
 
-    void enqueueCommandFast(std::function<void(void)> command);
+    void enqueueCommandFast(util::InplaceTask command, MainThreadTaskPriority priority);
+
+    MainThreadScheduler& mainThreadScheduler();
+
+    MainThreadProfiler& mainThreadProfiler();
 
     const rxcpp::observe_on_one_worker& mainThreadCoordination() const;
 
@@ -302,34 +444,38 @@ namespace reaplus {
     void detectFxChangesOnTrack(Track track, bool notifyListenersAboutChanges,
         bool checkNormalFxChain, bool checkInputFxChain);
 
-    // Returns true if FX was added or removed
+    // Diffs the current FX GUIDs of the given chain against the given old ones, updates them and emits fxAdded,
+    // fxRemoved and fxMoved events. Returns the kind of changes.
     // DONE-rust
-    bool detectFxChangesOnTrack(Track track,
-        std::set<std::string>& oldFxGuids,
+    FxChainChanges detectFxChangesOnTrack(Track track,
+        FxChainGuids& oldFxGuids,
         bool isInputFx,
         bool notifyListenersAboutChanges);
 
-    // DONE-rust
-    void removeInvalidFx(Track track,
-        std::set<std::string>& oldFxGuids,
-        bool isInputFx,
-        bool notifyListenersAboutChanges);
+    // Reads the binary GUIDs of the given FX chain in chain order into the given vector
+    void readFxGuids(MediaTrack* mediaTrack, bool isInputFx, std::vector<GUID>& fxGuids) const;
 
     // DONE-rust
-    void addMissingFx(Track track, std::set<std::string>& fxGuids, bool isInputFx, bool notifyListenersAboutChanges);
+    bool isProbablyInputFx(Track track, int fxIndex, int paramIndex, double fxValue) const;
 
     // DONE-rust
-    std::set<std::string> fxGuidsOnTrack(Track track, bool isInputFx) const;
+    bool trackParameterIsAutomated(MediaTrack* mediaTrack, TrackData& trackData, TrackEnvelopeType envelopeType) const;
 
-    // DONE-rust
-    bool isProbablyInputFx(Track track, int fxIndex, int paramIndex, double fxValue) const;
+    void updateAutomationState(MediaTrack* mediaTrack, TrackData& trackData) const;
 
-    // DONE-rust
-    bool trackParameterIsAutomated(Track track, std::string parameterName) const;
+    void invalidateAutomationStates();
 
     // DONE-rust
     State state() const;
 
+    static FxParameterKey fxParameterKey(const FxParameter& fxParameter);
+
+    // To be called if the given MediaTrack* becomes invalid. Completes keyed subscriptions concerning this track.
+    void completeKeyedSubjects(MediaTrack* mediaTrack);
+
+    // To be called if the FX with the given GUID is removed. Completes keyed subscriptions concerning this FX.
+    void completeKeyedSubjects(const std::string& fxGuid);
+
     // DONE-rust
     TrackData* findTrackDataByTrack(MediaTrack* mediaTrack);
 
@@ -343,5 +489,9 @@ namespace reaplus {
 
     // DONE-rust
     void fxParamSet(void* parm1, void* parm2, void* parm3, bool isInputFxIfSupported);
+
+    // Returns nullptr if there's no such FX
+    std::shared_ptr<const CachedFxParameter> findOrCreateCachedFxParameter(MediaTrack* mediaTrack, bool isInputFx,
+        int fxIndex, int paramIndex);
   };
 }
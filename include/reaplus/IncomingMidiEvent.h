@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <vector>
 #include <helgoboss-midi/MidiMessage.h>
 #include "MidiInputDevice.h"
 
@@ -10,11 +13,33 @@ namespace reaplus {
     MidiInputDevice inputDevice_;
     helgoboss::MidiMessage message_;
     int frameOffset_;
+    uint64_t sampleTime_;
+    double time_;
+    // Only set for messages longer than 3 bytes (SysEx)
+    const unsigned char* sysExData_ = nullptr;
+    size_t sysExSize_ = 0;
+    std::shared_ptr<const std::vector<unsigned char>> ownedSysExData_;
   public:
-    IncomingMidiEvent(MidiInputDevice inputDevice, helgoboss::MidiMessage message, int frameOffset);
+    IncomingMidiEvent(MidiInputDevice inputDevice, helgoboss::MidiMessage message, int frameOffset,
+        uint64_t sampleTime = 0, double time = 0);
+    // Doesn't copy the SysEx data. It must stay valid as long as the event is used.
+    IncomingMidiEvent(MidiInputDevice inputDevice, helgoboss::MidiMessage message, int frameOffset,
+        uint64_t sampleTime, double time, const unsigned char* sysExData, size_t sysExSize);
     MidiInputDevice inputDevice() const;
     helgoboss::MidiMessage message() const;
+    // In units of 1/1024000 seconds relative to the start of the audio block
     int getFrameOffset() const;
+    // Absolute sample on the audio hook timeline (see Reaper::audioBlockClock())
+    uint64_t sampleTime() const;
+    // Absolute seconds on the audio hook timeline (see Reaper::audioBlockClock())
+    double time() const;
+    // Complete message bytes (including F0 and F7) if the message is longer than 3 bytes, otherwise nullptr. Events
+    // emitted in the audio thread point into REAPER's MIDI buffer, so the data is only valid during the notification.
+    // Use withOwnedSysExData() to keep it longer.
+    const unsigned char* sysExData() const;
+    size_t sysExSize() const;
+    // Returns a copy which owns its SysEx data. Allocates, so don't call it in the audio thread.
+    IncomingMidiEvent withOwnedSysExData() const;
   };
 }
 
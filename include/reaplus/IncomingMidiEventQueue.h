@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <boost/optional.hpp>
+#include "reaper_plugin.h"
+#include "IncomingMidiEvent.h"
+#include "AudioBlockClock.h"
+#include "MidiInputFilter.h"
+#include "MidiEventAggregator.h"
+#include "util/SpscRingBuffer.h"
+
+namespace reaplus {
+  // Fixed-size copy of an incoming MIDI event as read in the audio thread
+  struct RawIncomingMidiEvent {
+    uint64_t sampleTime;
+    double time;
+    int inputDeviceId;
+    int frameOffset;
+    // Size of the SysEx data which is stored separately, 0 if the message fits into bytes
+    uint32_t sysExSize;
+    unsigned char size;
+    unsigned char bytes[3];
+
+    static RawIncomingMidiEvent fromMidiEvent(int inputDeviceId, const MIDI_event_t& midiEvent,
+        const AudioBlockClock& clock);
+
+    // Copies the SysEx data (if any), so it allocates
+    IncomingMidiEvent toIncomingMidiEvent(const unsigned char* sysExData) const;
+  };
+
+  // Receives all incoming MIDI events from the audio thread without any locking or allocation on the producer side.
+  // There must be only one consumer thread, which can be the main thread or any real-time thread. If the consumer
+  // doesn't keep up, new events are dropped and counted. SysEx data is passed through a separate preallocated byte
+  // ring buffer. Only events accepted by the filter are enqueued.
+  //
+  // If aggregation is enabled, accepted messages which are part of a 14-bit CC pair, an NRPN/RPN sequence or a pitch
+  // bend are combined in the audio thread and delivered as composite events through a separate buffer instead of
+  // being enqueued as raw events. Both buffers can be correlated by sample time.
+  class IncomingMidiEventQueue : private MidiEventAggregator::Sink {
+  private:
+    const CompiledMidiInputFilter filter_;
+    util::SpscRingBuffer<RawIncomingMidiEvent> buffer_;
+    util::SpscRingBuffer<unsigned char> sysExBuffer_;
+    // Producer only, null if aggregation is disabled
+    std::unique_ptr<MidiEventAggregator> aggregator_;
+    util::SpscRingBuffer<CompositeMidiEvent> compositeBuffer_;
+    // Consumer only. The SysEx data of the last popped event is copied into here.
+    std::vector<unsigned char> poppedSysExData_;
+    std::atomic<uint64_t> overflowCount_{0};
+  public:
+    explicit IncomingMidiEventQueue(size_t capacity, size_t sysExCapacity = 65536,
+        const MidiInputFilter& filter = MidiInputFilter(),
+        const boost::optional<MidiAggregationConfig>& aggregation = boost::none);
+
+    const CompiledMidiInputFilter& filter() const;
+
+    bool isAggregating() const;
+
+    // Audio thread only. sysExData must point to event.sysExSize bytes if the event carries SysEx data.
+    void push(const RawIncomingMidiEvent& event, const unsigned char* sysExData = nullptr);
+
+    // Audio thread only. Emits MSBs whose LSB didn't arrive within the configured timeout as 7-bit composite events.
+    void flushExpiredCompositeEvents(double now);
+
+    // Consumer only. Returns false if empty. If the event carries SysEx data, sysExData is set to a buffer which is
+    // valid until the next pop, otherwise to nullptr.
+    bool tryPop(RawIncomingMidiEvent& event, const unsigned char*& sysExData);
+
+    // Consumer only. Invokes the given function with each available event and its SysEx data (or nullptr). Returns
+    // the number of events.
+    template<typename F>
+    size_t drain(F&& f) {
+      size_t count = 0;
+      RawIncomingMidiEvent event;
+      const unsigned char* sysExData;
+      while (tryPop(event, sysExData)) {
+        f(event, sysExData);
+        count++;
+      }
+      return count;
+    }
+
+    // Consumer only. Returns false if empty.
+    bool tryPopComposite(CompositeMidiEvent& event);
+
+    // Consumer only. Invokes the given function with each available composite event. Returns the number of events.
+    template<typename F>
+    size_t drainComposite(F&& f) {
+      size_t count = 0;
+      CompositeMidiEvent event;
+      while (tryPopComposite(event)) {
+        f(event);
+        count++;
+      }
+      return count;
+    }
+
+    size_t capacity() const;
+
+    // Number of raw or composite events dropped because the queue was full
+    uint64_t overflowCount() const;
+
+  private:
+    void emit(const CompositeMidiEvent& event) override;
+  };
+}
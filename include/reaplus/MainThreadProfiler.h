@@ -0,0 +1,197 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define REAPLUS_PROFILER_HAS_TSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define REAPLUS_PROFILER_HAS_TSC
+#endif
+
+namespace reaplus {
+  struct MainThreadProfilerConfig {
+    bool enabled = false;
+    // Section invocations which take longer are recorded as stalls, together with the subscribers which ran in them
+    std::chrono::microseconds stallThreshold = std::chrono::milliseconds(30);
+    // If not zero, a summary is logged in this interval
+    std::chrono::seconds dumpInterval{0};
+  };
+
+  struct ProfiledTimeStatistics {
+    std::string name;
+    uint64_t callCount;
+    std::chrono::microseconds totalTime;
+    std::chrono::microseconds maxTime;
+    // Bucket 0 counts calls shorter than 1 us, bucket n calls between 2^(n-1) and 2^n us. The last bucket counts all
+    // longer calls.
+    std::vector<uint64_t> histogram;
+  };
+
+  struct ProfiledStall {
+    std::string sectionName;
+    std::chrono::microseconds duration;
+    std::chrono::steady_clock::time_point endTime;
+    // Time of the subscribers which ran during the stall, most expensive first
+    std::vector<std::pair<std::string, std::chrono::microseconds>> subscriberTimes;
+  };
+
+  // Low-overhead timing of main thread entry points (control surface callbacks) and of individual subscribers, meant
+  // for finding the cause of UI hitches. Uses the CPU's time stamp counter where available. Main thread only. When
+  // disabled, sections and wrapped subscribers cost a branch.
+  class MainThreadProfiler {
+  public:
+    static constexpr int HISTOGRAM_BUCKET_COUNT = 20;
+    static constexpr size_t MAX_RECENT_STALL_COUNT = 32;
+    static constexpr size_t MAX_SUBSCRIBER_COUNT_PER_STALL = 10;
+
+    // Measures a section from construction to destruction
+    class Section {
+    private:
+      MainThreadProfiler* profiler_;
+
+    public:
+      explicit Section(MainThreadProfiler* profiler) : profiler_(profiler) {
+      }
+
+      Section(const Section&) = delete;
+
+      Section& operator=(const Section&) = delete;
+
+      ~Section() {
+        if (profiler_ != nullptr) {
+          profiler_->endSection();
+        }
+      }
+    };
+
+    // Measures a subscriber call from construction to destruction
+    class SubscriberCall {
+    private:
+      MainThreadProfiler* profiler_;
+      const char* subscriberName_;
+      uint64_t startTicks_;
+
+    public:
+      SubscriberCall(MainThreadProfiler& profiler, const char* subscriberName)
+          : profiler_(profiler.config_.enabled ? &profiler : nullptr), subscriberName_(subscriberName),
+          startTicks_(profiler_ == nullptr ? 0 : readTicks()) {
+      }
+
+      SubscriberCall(const SubscriberCall&) = delete;
+
+      SubscriberCall& operator=(const SubscriberCall&) = delete;
+
+      ~SubscriberCall() {
+        if (profiler_ != nullptr) {
+          profiler_->recordSubscriberCall(subscriberName_, readTicks() - startTicks_);
+        }
+      }
+    };
+
+  private:
+    struct Accumulator {
+      uint64_t callCount = 0;
+      uint64_t totalTicks = 0;
+      uint64_t maxTicks = 0;
+      std::array<uint64_t, HISTOGRAM_BUCKET_COUNT> histogram{};
+    };
+
+    struct ActiveSection {
+      const char* name;
+      uint64_t startTicks;
+      // Reused between invocations, so it doesn't allocate in the steady state
+      std::vector<std::pair<const char*, uint64_t>> subscriberTicks;
+    };
+
+    MainThreadProfilerConfig config_;
+    // Keyed by the address of the (static) name
+    std::unordered_map<const char*, Accumulator> sections_;
+    std::unordered_map<const char*, Accumulator> subscribers_;
+    // Sections can nest, e.g. if REAPER calls a callback while we call the REAPER API in Run()
+    std::vector<ActiveSection> activeSections_;
+    size_t activeSectionCount_ = 0;
+    std::deque<ProfiledStall> recentStalls_;
+    // Calibration of ticks against the steady clock
+    uint64_t calibrationStartTicks_;
+    std::chrono::steady_clock::time_point calibrationStartTime_;
+    double ticksPerMicrosecond_;
+    std::chrono::steady_clock::time_point lastDumpTime_;
+
+  public:
+    MainThreadProfiler();
+
+    void setConfig(const MainThreadProfilerConfig& config);
+
+    const MainThreadProfilerConfig& config() const;
+
+    // sectionName must have static storage duration (e.g. a string literal). Keep the result alive until the end of
+    // the section.
+    Section profile(const char* sectionName) {
+      if (!config_.enabled) {
+        return Section(nullptr);
+      }
+      beginSection(sectionName);
+      return Section(this);
+    }
+
+    // Wraps a subscriber (or any other function) so its execution time is attributed to the given name, e.g.
+    // reaper.trackVolumeChanged().subscribe(profiler.wrap("Feedback", [](Track track) { ... })).
+    // subscriberName must have static storage duration.
+    template<typename F>
+    auto wrap(const char* subscriberName, F f) {
+      return [this, subscriberName, f = std::move(f)](auto&& ... args) mutable {
+        SubscriberCall call(*this, subscriberName);
+        return f(std::forward<decltype(args)>(args)...);
+      };
+    }
+
+    // Must be called once per main loop cycle. Refines the calibration and logs the periodic summary.
+    void onMainLoopCycle();
+
+    // Sorted by maximum time, descending
+    std::vector<ProfiledTimeStatistics> sectionStatistics() const;
+
+    // Sorted by maximum time, descending
+    std::vector<ProfiledTimeStatistics> subscriberStatistics() const;
+
+    // Oldest first
+    std::vector<ProfiledStall> recentStalls() const;
+
+    // Human-readable summary of the worst sections, subscribers and the recent stalls
+    std::string summary() const;
+
+    void reset();
+
+    static uint64_t readTicks() {
+#ifdef REAPLUS_PROFILER_HAS_TSC
+      return __rdtsc();
+#else
+      return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()
+      ).count();
+#endif
+    }
+
+  private:
+    void beginSection(const char* sectionName);
+
+    void endSection();
+
+    void recordSubscriberCall(const char* subscriberName, uint64_t ticks);
+
+    void record(Accumulator& accumulator, uint64_t ticks) const;
+
+    std::chrono::microseconds toMicroseconds(uint64_t ticks) const;
+
+    std::vector<ProfiledTimeStatistics> statistics(
+        const std::unordered_map<const char*, Accumulator>& accumulators) const;
+  };
+}
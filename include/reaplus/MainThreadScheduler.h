@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <concurrentqueue/concurrentqueue.h>
+#include "util/InplaceTask.h"
+
+namespace reaplus {
+  enum class MainThreadTaskPriority {
+    // Controller feedback and everything else which is latency-sensitive
+    Feedback,
+    // rx main thread coordination and GUI updates
+    Ui,
+    // Work which can wait, e.g. scanning or persisting
+    Background
+  };
+
+  struct MainThreadSchedulerConfig {
+    // Fraction of the measured main loop period which may be spent for scheduled tasks
+    double budgetFractionOfTick = 0.25;
+    std::chrono::microseconds minBudget = std::chrono::milliseconds(1);
+    std::chrono::microseconds maxBudget = std::chrono::milliseconds(50);
+    // Share of the budget which each priority class is guaranteed to get if it has work, indexed by priority.
+    // Budget not needed by a class goes to the others in priority order.
+    std::array<double, 3> budgetShares = {0.5, 0.3, 0.2};
+  };
+
+  struct MainThreadTaskClassMetrics {
+    // Approximate number of queued tasks
+    size_t queueDepth;
+    uint64_t executedCount;
+    // Time between enqueuing and execution. External sources (e.g. rx) are not included.
+    std::chrono::microseconds averageWaitTime;
+    std::chrono::microseconds maxWaitTime;
+  };
+
+  struct MainThreadSchedulerMetrics {
+    // Indexed by priority
+    std::array<MainThreadTaskClassMetrics, 3> classes;
+    uint64_t tickCount;
+    // Ticks which took more than 10% longer than their budget, e.g. because a single task ran too long
+    uint64_t overrunCount;
+    std::chrono::microseconds currentBudget;
+    std::chrono::microseconds averageTickPeriod;
+  };
+
+  // Executes tasks in the main thread within a per-tick time budget. The budget adapts to how often REAPER calls the
+  // main loop and to how long the rest of the loop takes. Each priority class with pending work gets at least one task
+  // and its budget share per tick, so lower priorities can't starve. Tasks can be enqueued from any thread without
+  // locking. Enqueuing allocates only for a thread's first task and when the preallocated storage is used up, because
+  // tasks must not get lost. Real-time threads should therefore not schedule tasks directly.
+  class MainThreadScheduler {
+  public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr int PRIORITY_COUNT = 3;
+  private:
+    struct QueuedTask {
+      util::InplaceTask task;
+      Clock::time_point enqueueTime;
+    };
+
+    struct TaskClass {
+      moodycamel::ConcurrentQueue<QueuedTask> queue;
+      // Executes one item of another source (e.g. a run loop) and returns false if there was none
+      std::function<bool()> externalSource;
+      // Alternates between queue and external source
+      bool preferExternalSource = false;
+      uint64_t executedCount = 0;
+      double averageWaitTimeInMicros = 0;
+      Clock::duration maxWaitTime{0};
+
+      TaskClass() : queue(1000) {
+      }
+    };
+
+    MainThreadSchedulerConfig config_;
+    std::array<TaskClass, PRIORITY_COUNT> taskClasses_;
+    // Main thread only
+    Clock::time_point lastTickStartTime_;
+    double averageTickPeriodInMicros_ = 0;
+    double averageOverheadInMicros_ = 0;
+    Clock::duration currentBudget_;
+    uint64_t tickCount_ = 0;
+    uint64_t overrunCount_ = 0;
+
+  public:
+    MainThreadScheduler();
+
+    // Any thread except real-time threads (see class comment)
+    void schedule(MainThreadTaskPriority priority, util::InplaceTask task);
+
+    // Main thread. The given function is polled for work as part of the given priority class.
+    void setExternalSource(MainThreadTaskPriority priority, std::function<bool()> source);
+
+    // Main thread
+    void setConfig(const MainThreadSchedulerConfig& config);
+
+    const MainThreadSchedulerConfig& config() const;
+
+    // Main thread. Must be called once per main loop cycle. tickStartTime is when the main loop cycle started, so
+    // that the time needed by the rest of the cycle can be taken into account.
+    void runTick(Clock::time_point tickStartTime);
+
+    // Main thread
+    MainThreadSchedulerMetrics metrics() const;
+
+  private:
+    // Returns false if the class had nothing to do
+    bool executeOne(TaskClass& taskClass);
+
+    void updateBudget(Clock::time_point tickStartTime, Clock::time_point now);
+  };
+}
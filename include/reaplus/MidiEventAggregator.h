@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace reaplus {
+  struct RawIncomingMidiEvent;
+
+  // Result of combining several incoming short MIDI messages into one logical value
+  struct CompositeMidiEvent {
+    enum class Type : uint8_t {
+      // Controller 0-31 (MSB) combined with controller 32-63 (LSB). Number is the MSB controller number.
+      ControlChange14Bit,
+      // Number is the 14-bit parameter number
+      Nrpn,
+      // Number is the 14-bit parameter number
+      Rpn,
+      PitchBendChange
+    };
+    uint64_t sampleTime;
+    double time;
+    int inputDeviceId;
+    Type type;
+    uint8_t channel;
+    // False if only the MSB arrived within the timeout. value is then MSB << 7.
+    bool is14Bit;
+    // +1 or -1 for (N)RPN data increment/decrement messages (value then is the last known value), otherwise 0
+    int8_t delta;
+    uint16_t number;
+    uint16_t value;
+  };
+
+  // Declares that a device sends the given controller 0-31 as MSB of a 14-bit controller pair
+  struct MidiController14BitPair {
+    // -1 means all devices
+    int inputDeviceId;
+    uint8_t msbControllerNumber;
+  };
+
+  struct MidiAggregationConfig {
+    // Devices whose messages are aggregated. Empty means all devices.
+    std::vector<int> deviceIds;
+    bool aggregateControlChange14Bit = true;
+    // Only these controllers are held back waiting for their LSB. All other controllers pass through unchanged, since
+    // most controllers 0-31 are plain 7-bit ones (e.g. modulation or volume).
+    std::vector<MidiController14BitPair> controllerPairs14Bit;
+    bool aggregateParameterNumbers = true;
+    bool aggregatePitchBend = true;
+    // How long to wait for the LSB after the MSB arrived before emitting the MSB alone
+    double timeoutInSeconds = 0.01;
+  };
+
+  // Stateful per-device and per-channel combination of 14-bit CC pairs, NRPN/RPN sequences and pitch bend. Uses fixed
+  // state tables allocated at construction time, so processing doesn't allocate and can happen in the audio thread.
+  class MidiEventAggregator {
+  public:
+    class Sink {
+    public:
+      virtual void emit(const CompositeMidiEvent& event) = 0;
+    protected:
+      ~Sink() = default;
+    };
+
+  private:
+    static constexpr int MAX_DEVICE_COUNT = 256;
+    // If no device IDs are configured, state slots are assigned to devices in the order they send. Messages of
+    // further devices are not aggregated.
+    static constexpr int MAX_AGGREGATED_DEVICE_COUNT = 16;
+    static constexpr int8_t NONE = -1;
+
+    enum class SelectedParameterKind : uint8_t {
+      None,
+      Nrpn,
+      Rpn
+    };
+
+    struct PendingMsb {
+      uint64_t sampleTime = 0;
+      double time = 0;
+      int8_t value = NONE;
+    };
+
+    struct ChannelState {
+      // Indexed by MSB controller number 0-31
+      std::array<PendingMsb, 32> pendingControllerMsbs;
+      std::array<int8_t, 32> lastControllerMsbs;
+      // Bit n = pendingControllerMsbs[n] is set. Keeps flushing cheap.
+      uint32_t pendingControllerMask = 0;
+      SelectedParameterKind selectedParameterKind = SelectedParameterKind::None;
+      int8_t nrpnMsb = NONE;
+      int8_t nrpnLsb = NONE;
+      int8_t rpnMsb = NONE;
+      int8_t rpnLsb = NONE;
+      PendingMsb pendingDataMsb;
+      int8_t lastDataMsb = NONE;
+      int8_t lastDataLsb = NONE;
+
+      ChannelState() {
+        lastControllerMsbs.fill(NONE);
+      }
+    };
+
+    struct DeviceState {
+      int inputDeviceId = -1;
+      // Bit n = controller n is the MSB of a declared 14-bit pair
+      uint32_t controllers14BitMask = 0;
+      // Bit n = channel n has pending MSBs
+      uint16_t pendingChannelMask = 0;
+      std::array<ChannelState, 16> channels;
+    };
+
+    MidiAggregationConfig config_;
+    // Index into deviceStates_ for each device ID, -1 if device doesn't have a state slot (yet)
+    std::array<int16_t, MAX_DEVICE_COUNT> deviceStateIndexes_;
+    std::vector<DeviceState> deviceStates_;
+    int usedDeviceStateCount_ = 0;
+
+  public:
+    explicit MidiEventAggregator(MidiAggregationConfig config);
+
+    // Returns true if the message was consumed by the aggregator (no matter if it resulted in an emission)
+    bool process(const RawIncomingMidiEvent& event, Sink& sink);
+
+    // Emits MSB-only events for pending MSBs whose LSB didn't arrive in time
+    void flushExpired(double now, Sink& sink);
+
+  private:
+    DeviceState* findOrAssignDeviceState(int inputDeviceId);
+
+    void assignDeviceState(DeviceState& deviceState, int inputDeviceId) const;
+
+    bool processControlChange(DeviceState& deviceState, const RawIncomingMidiEvent& event, Sink& sink);
+
+    bool processParameterNumberControlChange(DeviceState& deviceState, const RawIncomingMidiEvent& event,
+        Sink& sink);
+
+    bool processControlChange14Bit(DeviceState& deviceState, const RawIncomingMidiEvent& event, Sink& sink);
+
+    // Emits the data entry MSB alone if its LSB didn't arrive (yet)
+    void flushPendingDataMsb(const DeviceState& deviceState, ChannelState& channelState, uint8_t channel,
+        Sink& sink) const;
+
+    void flushPendingControllerMsb(DeviceState& deviceState, uint8_t channel, uint8_t controllerNumber,
+        Sink& sink) const;
+
+    void emitParameterValue(const DeviceState& deviceState, const ChannelState& channelState, uint8_t channel,
+        bool is14Bit, int8_t delta, uint64_t sampleTime, double time, Sink& sink) const;
+  };
+}
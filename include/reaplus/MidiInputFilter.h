@@ -0,0 +1,73 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+#include "reaper_plugin.h"
+
+namespace reaplus {
+  class CompiledMidiInputFilter;
+
+  // Describes which incoming MIDI messages a consumer is interested in. Compiled into lookup tables, so that the audio
+  // thread can drop unwanted messages (e.g. MIDI clock floods) before enqueuing them.
+  struct MidiInputFilter {
+    // Message type bits. Channel messages are indexed by the high nibble of the status byte, system messages by the
+    // low nibble.
+    static constexpr uint32_t NOTE_OFF = 1u << 0u;
+    static constexpr uint32_t NOTE_ON = 1u << 1u;
+    static constexpr uint32_t POLYPHONIC_KEY_PRESSURE = 1u << 2u;
+    static constexpr uint32_t CONTROL_CHANGE = 1u << 3u;
+    static constexpr uint32_t PROGRAM_CHANGE = 1u << 4u;
+    static constexpr uint32_t CHANNEL_PRESSURE = 1u << 5u;
+    static constexpr uint32_t PITCH_BEND_CHANGE = 1u << 6u;
+    static constexpr uint32_t SYSTEM_EXCLUSIVE = 1u << 7u;
+    static constexpr uint32_t TIME_CODE_QUARTER_FRAME = 1u << 8u;
+    static constexpr uint32_t SONG_POSITION_POINTER = 1u << 9u;
+    static constexpr uint32_t SONG_SELECT = 1u << 10u;
+    static constexpr uint32_t TUNE_REQUEST = 1u << 13u;
+    static constexpr uint32_t TIMING_CLOCK = 1u << 15u;
+    static constexpr uint32_t START = 1u << 17u;
+    static constexpr uint32_t CONTINUE = 1u << 18u;
+    static constexpr uint32_t STOP = 1u << 19u;
+    static constexpr uint32_t ACTIVE_SENSING = 1u << 21u;
+    static constexpr uint32_t SYSTEM_RESET = 1u << 22u;
+    static constexpr uint32_t ALL_CHANNEL_MESSAGES = (1u << 7u) - 1;
+    static constexpr uint32_t ALL_MESSAGES = (1u << 23u) - 1;
+    static constexpr int MAX_DEVICE_COUNT = 256;
+
+    // Empty means all devices
+    std::vector<int> deviceIds;
+    // Bit n = channel n
+    uint16_t channelMask = 0xFFFF;
+    // Active sensing is never delivered anyway
+    uint32_t messageTypeMask = ALL_MESSAGES & ~ACTIVE_SENSING;
+    // Inclusive range of accepted controller numbers, only relevant for control change messages
+    int minControllerNumber = 0;
+    int maxControllerNumber = 127;
+
+    CompiledMidiInputFilter compile() const;
+  };
+
+  // Lookup table representation of a MidiInputFilter. Evaluating it is a few bit tests and doesn't allocate.
+  class CompiledMidiInputFilter {
+    friend struct MidiInputFilter;
+  private:
+    std::bitset<MidiInputFilter::MAX_DEVICE_COUNT> acceptedDevices_;
+    std::bitset<256> acceptedStatusBytes_;
+    std::bitset<128> acceptedControllerNumbers_;
+  public:
+    bool accepts(int inputDeviceId, const MIDI_event_t& midiEvent) const {
+      if (inputDeviceId < 0 || inputDeviceId >= MidiInputFilter::MAX_DEVICE_COUNT || !acceptedDevices_[inputDeviceId]) {
+        return false;
+      }
+      const auto statusByte = midiEvent.midi_message[0];
+      if (!acceptedStatusBytes_[statusByte]) {
+        return false;
+      }
+      if ((statusByte & 0xF0) == 0xB0 && !acceptedControllerNumbers_[midiEvent.midi_message[1] & 0x7F]) {
+        return false;
+      }
+      return true;
+    }
+  };
+}
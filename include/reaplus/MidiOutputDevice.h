@@ -31,6 +31,12 @@ namespace reaplus {
     // TODO-rust
     void send(const helgoboss::MidiMessage& message, int frameOffset) const;
 
+    // Sends a message of any length, e.g. SysEx including F0 and F7. Doesn't allocate, so it can be called in the
+    // audio thread. Throws if the message is longer than MAX_MESSAGE_SIZE.
+    void send(const unsigned char* data, size_t size, int frameOffset) const;
+
+    static constexpr size_t MAX_MESSAGE_SIZE = 4096;
+
     // DONE-rust
     friend bool operator==(const MidiOutputDevice& lhs, const MidiOutputDevice& rhs);
 
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <concurrentqueue/concurrentqueue.h>
+#include <helgoboss-midi/MidiMessage.h>
+#include "reaper_plugin.h"
+
+namespace reaplus {
+  // Fixed-size copy of an outgoing MIDI message
+  struct QueuedMidiOutputMessage {
+    static constexpr size_t MAX_SIZE = 128;
+
+    int frameOffset;
+    uint32_t size;
+    unsigned char bytes[MAX_SIZE];
+  };
+
+  // Token bucket which limits the number of bytes sent to one output device per second. Shared by all queues of that
+  // device, so that the limit holds for the device as a whole. Audio thread only after construction.
+  class MidiOutputByteBudget {
+  private:
+    double maxBytesPerSecond_;
+    double availableBytes_ = 0;
+    uint64_t lastRefilledAudioBlock_ = UINT64_MAX;
+  public:
+    explicit MidiOutputByteBudget(double maxBytesPerSecond);
+
+    double maxBytesPerSecond() const;
+
+    // Adds the budget of the given audio block. Further calls for the same block have no effect.
+    void refill(uint64_t audioBlockIndex, double blockDurationInSeconds);
+
+    // Returns false if there's not enough budget left for the given number of bytes
+    bool tryConsume(size_t byteCount);
+  };
+
+  // Collects outgoing MIDI messages for one device from any number of threads and sends them in the audio thread.
+  // Enqueuing is lock-free and only uses the storage preallocated for the capacity, so feedback for many controls can
+  // be pushed without waiting for REAPER. If a byte budget is given, messages which exceed it stay queued for the next
+  // blocks, which keeps slow hardware from being overrun. Messages are sent in the order they were enqueued by each
+  // thread or Producer.
+  class MidiOutputQueue {
+  public:
+    // Lets one thread at a time send without allocating at all, e.g. a real-time thread. Create it ahead of time
+    // outside of real-time threads. Must not outlive its queue.
+    class Producer {
+      friend class MidiOutputQueue;
+    private:
+      moodycamel::ProducerToken token_;
+
+      explicit Producer(moodycamel::ConcurrentQueue<QueuedMidiOutputMessage>& queue);
+    };
+
+  private:
+    int deviceId_;
+    // Null if not rate-limited
+    std::shared_ptr<MidiOutputByteBudget> byteBudget_;
+    moodycamel::ConcurrentQueue<QueuedMidiOutputMessage> queue_;
+    std::atomic<size_t> approximateSize_{0};
+    size_t capacity_;
+    std::atomic<uint64_t> overflowCount_{0};
+    // Audio thread only
+    midi_Output* midiOutput_ = nullptr;
+    uint64_t midiOutputGeneration_ = UINT64_MAX;
+    // Audio thread only. Message which has been dequeued but couldn't be sent yet because of the rate limit.
+    QueuedMidiOutputMessage deferredMessage_{};
+    bool hasDeferredMessage_ = false;
+  public:
+    // A null byte budget means no rate limit
+    explicit MidiOutputQueue(int deviceId, size_t capacity = 4096,
+        std::shared_ptr<MidiOutputByteBudget> byteBudget = nullptr);
+
+    int deviceId() const;
+
+    // Null if not rate-limited
+    const std::shared_ptr<MidiOutputByteBudget>& byteBudget() const;
+
+    // Allocates, so not in real-time threads
+    Producer createProducer();
+
+    // Any thread. The first call in each thread registers the thread as producer, which allocates once, so real-time
+    // threads should use a Producer instead. Returns false if the queue is full.
+    bool send(const helgoboss::MidiMessage& message, int frameOffset = 0);
+
+    // Any thread, like the other send(). Sends a message of any length up to QueuedMidiOutputMessage::MAX_SIZE, e.g.
+    // SysEx including F0 and F7. Throws if the message is longer. Returns false if the queue is full.
+    bool send(const unsigned char* data, size_t size, int frameOffset = 0);
+
+    // Like send(), but never allocates. Only one thread at a time may use the given producer.
+    bool send(Producer& producer, const helgoboss::MidiMessage& message, int frameOffset = 0);
+
+    // Like send(), but never allocates. Only one thread at a time may use the given producer.
+    bool send(Producer& producer, const unsigned char* data, size_t size, int frameOffset = 0);
+
+    // Audio thread only. Sends as many queued messages as the byte budget allows. The output device is looked up
+    // again whenever the given generation changes.
+    void flush(uint64_t audioBlockIndex, double blockDurationInSeconds, uint64_t midiOutputGeneration);
+
+    // Approximate number of messages waiting to be sent
+    size_t size() const;
+
+    size_t capacity() const;
+
+    // Number of messages dropped because the queue was full or its preallocated storage was used up
+    uint64_t overflowCount() const;
+
+  private:
+    static QueuedMidiOutputMessage createQueuedMessage(const helgoboss::MidiMessage& message, int frameOffset);
+
+    static QueuedMidiOutputMessage createQueuedMessage(const unsigned char* data, size_t size, int frameOffset);
+
+    // Without producer, the implicit producer of the current thread is used
+    bool enqueue(Producer* producer, const QueuedMidiOutputMessage& message);
+
+    void sendNow(const QueuedMidiOutputMessage& message) const;
+  };
+}
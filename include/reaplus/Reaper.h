@@ -4,8 +4,12 @@
 #include <functional>
 #include <boost/filesystem.hpp>
 #include <thread>
+#include <atomic>
 #include <memory>
+#include <map>
 #include <unordered_map>
+#include <vector>
+#include <type_traits>
 #include <reaper_plugin.h>
 #include <rxcpp/rx.hpp>
 #include <boost/optional.hpp>
@@ -13,7 +17,19 @@
 #include "AutomationMode.h"
 #include <helgoboss-midi/MidiMessage.h>
 #include "Guid.h"
-#include "util/rx-relaxed-runloop.hpp"
+#include "EventJournal.h"
+#include "IncomingMidiEventQueue.h"
+#include "MidiOutputQueue.h"
+#include "util/AudioThreadSnapshot.h"
+#include "util/SeqLock.h"
+#include "util/RealTimeSafety.h"
+#include "util/InplaceTask.h"
+#include "util/ListenerMask.h"
+#include "util/UndoSnapshotStore.h"
+#include "MainThreadScheduler.h"
+#include "WorkerPool.h"
+#include "AudioBlockClock.h"
+#include "util/rx-timer-wheel-runloop.hpp"
 
 namespace reaplus {
   class Action;
@@ -56,16 +72,41 @@ namespace reaplus {
     VirtualMidiKeyboardOnCurrentChannel
   };
 
+  // How a project config extension takes part in undo points
+  enum class ProjectConfigUndoMode {
+    // Writes its state into each undo point
+    Full,
+    // Writes nothing into undo points, so undo doesn't restore its state
+    Skip,
+    // Writes only a reference into undo points and keeps the distinct states in a bounded memory store (see
+    // util::UndoSnapshotStore). Undo points whose state has been evicted, or which were saved with the project and
+    // loaded in a later session, can't resolve their reference, so their state is not restored. Only takes effect
+    // together with tracksDirtiness, because otherwise each undo point would need to generate and compare the
+    // complete state. Without it, behaves like Full.
+    Deduplicate
+  };
+
   // TODO-rust
   struct ProjectConfigExtension {
     std::function<bool(const char*, ProjectStateContext*, bool, struct project_config_extension_t*)>
         processExtensionLine;
     std::function<void(bool, struct project_config_extension_t*)> beginLoadProjectState;
     std::function<void(ProjectStateContext*, bool, struct project_config_extension_t*)> saveExtensionConfig;
+    // First tokens of the extension lines this extension owns, e.g. "MY_VALUE" or "<MY_BLOCK". Lines are routed to
+    // their owner by a hash lookup. Extensions without tokens are offered all lines which no other extension owns.
+    std::vector<std::string> tokens;
+    // Optional. If set, the lines within an owned block (without its opening and closing line) are streamed to this
+    // function instead of processExtensionLine having to read them from the context. Receives nested blocks verbatim.
+    std::function<void(const char* line, bool isUndo)> processBlockLine;
+    // If true, saveExtensionConfig is only called again after Reaper::markProjectConfigExtensionDirty() or after
+    // loading project state. In between, its previous output is written from a cache.
+    bool tracksDirtiness = false;
+    ProjectConfigUndoMode undoMode = ProjectConfigUndoMode::Full;
   };
 
   class Reaper {
     friend class RegisteredAction;
+    friend class HelperControlSurface;
 
   private:
     // TODO-rust
@@ -123,15 +164,78 @@ namespace reaplus {
     std::unordered_map<int, Command> commandByIndex_;
     // TODO-rust
     std::vector<ProjectConfigExtension> projectConfigExtensions_;
+    // Index into projectConfigExtensions_
+    std::unordered_map<std::string, size_t> projectConfigExtensionIndexByToken_;
+    // Extensions without tokens
+    std::vector<size_t> catchAllProjectConfigExtensionIndexes_;
+    // Reused for looking up the first token of each extension line without allocating
+    std::string tokenBuffer_;
+    struct ProjectConfigExtensionCache {
+      // Newline-separated output of the last saveExtensionConfig call by project and isUndo
+      std::map<std::pair<ReaProject*, bool>, std::string> outputByProject;
+      // Undo snapshots of an extension in Deduplicate mode, by project
+      std::map<ReaProject*, util::UndoSnapshotStore> undoSnapshotsByProject;
+      // Snapshot of the current state by project, reused by undo points until the extension gets dirty
+      std::map<ReaProject*, uint64_t> currentUndoSnapshotIdByProject;
+    };
+    // Parallel to projectConfigExtensions_
+    std::vector<ProjectConfigExtensionCache> projectConfigExtensionCaches_;
+    // Written into undo snapshot references, so references from undo points of an earlier session are recognized
+    uint64_t sessionId_;
+    // Forgets undo snapshots of closed projects
+    rxcpp::composite_subscription projectClosedSubscription_;
     // DONE-rust
     rxcpp::subjects::subject<IncomingMidiEvent> incomingMidiEventsSubject_;
     // DONE-rust
     rxcpp::subjects::subject<Action> actionInvokedSubject_;
-    // TODO-rust
-    uint64_t sampleCounter_ = 0;
-    rxcpp::schedulers::relaxed_run_loop audioThreadRunLoop_;
+    enum class EventKind : int {
+      ActionInvoked
+    };
+    // Lets hooks skip building event payloads nobody listens to
+    util::ListenerMask listenerMask_;
+    // Written by the audio thread at the start of each block
+    util::SeqLock<AudioBlockClock> audioBlockClock_;
+    // Audio thread only
+    AudioBlockClock audioThreadBlockClock_{};
+    rxcpp::schedulers::timer_wheel_run_loop audioThreadRunLoop_;
     rxcpp::observe_on_one_worker audioThreadCoordination_ =
-        rxcpp::observe_on_one_worker(rxcpp::schedulers::make_relaxed_run_loop(audioThreadRunLoop_));
+        rxcpp::observe_on_one_worker(rxcpp::schedulers::make_timer_wheel_run_loop(audioThreadRunLoop_));
+    // Journals are never destroyed before the audio hook is unregistered because the audio thread might still write
+    std::vector<std::unique_ptr<EventJournal>> eventJournals_;
+    std::atomic<EventJournal*> activeEventJournal_{nullptr};
+    using IncomingMidiEventQueueList = std::vector<std::shared_ptr<IncomingMidiEventQueue>>;
+    // Replaced as a whole by the main thread whenever a queue is added or removed
+    util::AudioThreadSnapshot<IncomingMidiEventQueueList> incomingMidiEventQueues_;
+    // IDs of MIDI input devices which are connected. Saves the audio thread from probing all possible devices.
+    util::AudioThreadSnapshot<std::vector<int>> openMidiInputDeviceIds_;
+    std::atomic<uint64_t> audioBlockCount_{0};
+    using MidiOutputQueueList = std::vector<std::shared_ptr<MidiOutputQueue>>;
+    util::AudioThreadSnapshot<MidiOutputQueueList> midiOutputQueues_;
+    // Incremented whenever MIDI devices might have changed, so that the audio thread looks up outputs again
+    std::atomic<uint64_t> midiOutputGeneration_{0};
+    std::atomic<bool> audioBlockTimingEnabled_{false};
+    util::BlockTimeHistogram audioBlockTimeHistogram_;
+    struct MainThreadIncomingMidiEventConsumer {
+      std::shared_ptr<IncomingMidiEventQueue> queue;
+      rxcpp::composite_subscription subscription;
+      // Forwards the queued events to the subscriber
+      std::function<void(IncomingMidiEventQueue&)> drain;
+    };
+    std::vector<MainThreadIncomingMidiEventConsumer> mainThreadIncomingMidiEventConsumers_;
+    // Carries replayed MIDI events from the main thread (producer) to the audio thread, which dispatches them like
+    // live input
+    struct ReplayedMidiInput {
+      IncomingMidiEventQueue queue;
+      // Audio thread only. Replayed events are rebuilt in here as MIDI_event_t including their SysEx data.
+      std::vector<unsigned char> eventBuffer;
+
+      ReplayedMidiInput();
+    };
+    // Created on first replay. Never destroyed before the audio hook is unregistered.
+    std::unique_ptr<ReplayedMidiInput> replayedMidiInput_;
+    std::atomic<ReplayedMidiInput*> audioThreadReplayedMidiInput_{nullptr};
+    // Created on first use
+    std::unique_ptr<WorkerPool> workerPool_;
 
   public:
     // DONE-rust
@@ -160,7 +264,11 @@ namespace reaplus {
     // TODO-rust
     // TODO Make it unregisterable
     // TODO Make it more intuitive (like registering actions)
-    void registerProjectConfigExtension(ProjectConfigExtension extension);
+    // Throws if one of the extension's tokens is already owned by another extension. Returns the ID of the extension.
+    size_t registerProjectConfigExtension(ProjectConfigExtension extension);
+
+    // Main thread. Lets the next save call saveExtensionConfig of an extension which tracks dirtiness.
+    void markProjectConfigExtensionDirty(size_t extensionId);
 
     // TODO-rust
     boost::optional<FxParameter> lastTouchedFxParameter() const;
@@ -199,9 +307,48 @@ namespace reaplus {
     // DONE-rust
     Guid generateGuid() const;
 
+    // Emits in the audio thread, so subscribers run in the real-time context. Prefer
+    // incomingMidiEventsInMainThread() or createIncomingMidiEventQueue() because they don't lock or allocate in the
+    // audio thread.
     // DONE-rust
     rxcpp::observable<IncomingMidiEvent> incomingMidiEvents() const;
 
+    // Emits incoming MIDI events accepted by the given filter in the main thread. Each subscription gets its own
+    // lock-free queue which is filled by the audio thread. Unwanted messages are dropped in the audio thread already.
+    // Must be subscribed to in the main thread.
+    rxcpp::observable<IncomingMidiEvent> incomingMidiEventsInMainThread(
+        const MidiInputFilter& filter = MidiInputFilter());
+
+    // Emits 14-bit CC, NRPN/RPN and pitch bend values in the main thread. The stateful pairing of the single messages
+    // happens in the audio thread, so values are complete even if the main thread lags. Messages which are not part of
+    // such a combination are ignored. Must be subscribed to in the main thread.
+    rxcpp::observable<CompositeMidiEvent> compositeMidiEventsInMainThread(
+        const MidiAggregationConfig& aggregation = MidiAggregationConfig(),
+        const MidiInputFilter& filter = MidiInputFilter());
+
+    // Creates and registers a queue which receives incoming MIDI events accepted by the given filter from the audio
+    // thread. It can be drained by one thread of choice, also in a real-time context. If an aggregation config is
+    // given, the queue additionally delivers composite events. Must be called in the main thread.
+    std::shared_ptr<IncomingMidiEventQueue> createIncomingMidiEventQueue(size_t capacity = 4096,
+        size_t sysExCapacity = 65536, const MidiInputFilter& filter = MidiInputFilter(),
+        const boost::optional<MidiAggregationConfig>& aggregation = boost::none);
+
+    // Must be called in the main thread. The queue won't receive events anymore as soon as the current audio block is
+    // processed.
+    void removeIncomingMidiEventQueue(const std::shared_ptr<IncomingMidiEventQueue>& queue);
+
+    // Creates and registers a queue which accepts outgoing MIDI messages for the given device from any thread and
+    // sends them in each audio block after incoming MIDI has been processed. Prefer this over
+    // MidiOutputDevice::send() when sending many messages, e.g. controller feedback. A maxBytesPerSecond of 0 means no
+    // rate limit (classic 5-pin MIDI transmits 3125 bytes per second). The limit applies to the device as a whole, so
+    // all queues of one device must be created with the same limit, otherwise this throws. Must be called in the main
+    // thread.
+    std::shared_ptr<MidiOutputQueue> createMidiOutputQueue(const MidiOutputDevice& device, size_t capacity = 4096,
+        double maxBytesPerSecond = 0);
+
+    // Must be called in the main thread. Messages which are still queued are discarded.
+    void removeMidiOutputQueue(const std::shared_ptr<MidiOutputQueue>& queue);
+
     // It's correct that this method returns an optional because the index isn't a stable identifier of a project.
     // The project could move. So this should do a runtime lookup of the project and return a stable ReaProject-backed
     // Project object if a project exists at that index.
@@ -318,6 +465,9 @@ namespace reaplus {
     // TODO-rust
     rxcpp::observable<Track> fxReordered() const;
 
+    // Emits each FX whose position relative to the other already existing FX has changed, with its new index
+    rxcpp::observable<Fx> fxMoved() const;
+
     // DONE-rust
     rxcpp::observable<Track> trackInputMonitoringChanged() const;
 
@@ -366,10 +516,107 @@ namespace reaplus {
     // TODO-rust
     rxcpp::observable<bool> mainThreadIdle() const;
 
+    // Keyed subscriptions. Unlike filtering the global observables, their dispatch cost doesn't grow with the number
+    // of subscribers interested in other tracks or FX parameters. They complete when the track or FX is removed.
+    // Only GUID-based FX parameters are supported.
+
+    rxcpp::observable<FxParameter> fxParameterValueChanged(const FxParameter& fxParameter) const;
+
+    rxcpp::observable<FxParameter> fxParameterTouched(const FxParameter& fxParameter) const;
+
+    rxcpp::observable<Track> trackVolumeChanged(const Track& track) const;
+
+    rxcpp::observable<Track> trackVolumeTouched(const Track& track) const;
+
+    rxcpp::observable<Track> trackPanChanged(const Track& track) const;
+
+    rxcpp::observable<Track> trackPanTouched(const Track& track) const;
+
+    rxcpp::observable<Track> trackMuteChanged(const Track& track) const;
+
+    rxcpp::observable<Track> trackMuteTouched(const Track& track) const;
+
+    rxcpp::observable<Track> trackSoloChanged(const Track& track) const;
+
+    rxcpp::observable<Track> trackArmChanged(const Track& track) const;
+
+    rxcpp::observable<Track> trackSelectedChanged(const Track& track) const;
+
+    // Starts recording all control surface callbacks, post-command hooks and incoming MIDI events into a ring buffer
+    // with the given number of records. Restarting forgets previous records.
+    void startEventJournal(size_t capacity = 65536);
+
+    void stopEventJournal();
+
+    // Returns nullptr if not recording. Can be called from any thread.
+    EventJournal* activeEventJournal() const;
+
+    // Writes the records of the most recently started journal to the given file. Returns the number of records.
+    size_t dumpEventJournal(const std::string& filePath) const;
+
+    // Feeds the records of a dumped journal back through the event dispatching as fast as possible (timestamps are
+    // ignored). Tracks are resolved by index in the current project. MIDI events are handed over to the audio thread,
+    // which delivers them in its next block exactly like live input, so they arrive after the other replayed events.
+    // MIDI events which don't fit into the handover queue are dropped. Returns the number of replayed records.
+    size_t replayEventJournal(const std::string& filePath);
+
     rxcpp::composite_subscription executeLaterInMainThread(std::function<void(void)> command);
 
-    // DONE-rust
-    void executeLaterInMainThreadFast(std::function<void(void)> command);
+    // The command must fit into util::InplaceTask::CAPACITY bytes, so wrapping it doesn't allocate. Enqueuing might
+    // allocate (see MainThreadScheduler), so don't call this from real-time threads. Commands with higher priority are
+    // preferred when the main loop is busy, but each priority class gets a guaranteed share of the main loop time.
+    // DONE-rust
+    void executeLaterInMainThreadFast(util::InplaceTask command,
+        MainThreadTaskPriority priority = MainThreadTaskPriority::Feedback);
+
+    // Main thread only
+    void setMainThreadSchedulerConfig(const MainThreadSchedulerConfig& config);
+
+    // Main thread only. Queue depths, wait times and budget overruns of the main loop.
+    MainThreadSchedulerMetrics mainThreadSchedulerMetrics() const;
+
+    // Main thread only. Profiler of the control surface callbacks, disabled by default. Wrap subscribers with
+    // MainThreadProfiler::wrap() to see which of them cause stalls.
+    MainThreadProfiler& mainThreadProfiler();
+
+    // Main thread only. Executes the given job in a worker thread and passes its result and timing to onResult in the
+    // main thread. The job is called with a BackgroundJobContext, must return a value and must not use the REAPER API.
+    // Unsubscribing the returned subscription skips the job if it hasn't started yet (long-running jobs can check
+    // BackgroundJobContext::isCancelled()) and suppresses the result.
+    template<typename Job, typename OnResult>
+    rxcpp::composite_subscription executeInBackground(Job job, OnResult onResult) {
+      using Result = std::invoke_result_t<Job&, const BackgroundJobContext&>;
+      static_assert(!std::is_void<Result>::value, "Background jobs must return their result");
+      struct Delivery {
+        Result result;
+        BackgroundJobTiming timing;
+        OnResult onResult;
+        rxcpp::composite_subscription cancellation;
+      };
+      rxcpp::composite_subscription cancellation;
+      workerPool().submit(
+          [this, job = std::move(job), onResult = std::move(onResult), cancellation](
+              const BackgroundJobContext& context) mutable {
+            auto result = job(context);
+            if (context.isCancelled()) {
+              return;
+            }
+            // Only the shared_ptr is captured, so the task fits into util::InplaceTask
+            auto delivery = std::make_shared<Delivery>(
+                Delivery{std::move(result), context.timing(), std::move(onResult), cancellation});
+            executeLaterInMainThreadFast([delivery] {
+              if (delivery->cancellation.is_subscribed()) {
+                delivery->onResult(std::move(delivery->result), delivery->timing);
+              }
+            }, MainThreadTaskPriority::Ui);
+          },
+          cancellation
+      );
+      return cancellation;
+    }
+
+    // Main thread only. Pool used by executeInBackground(), created on first use.
+    WorkerPool& workerPool();
 
     // DONE-rust (without subscription)
     rxcpp::composite_subscription executeWhenInMainThread(std::function<void(void)> command);
@@ -395,9 +642,22 @@ namespace reaplus {
     // DONE-rust
     HWND mainWindow() const;
 
+    // Number of samples processed by the audio hook so far, including the current block. Can be called from any
+    // thread.
     // TODO-rust
     uint64_t sampleCounter() const;
 
+    // Clock of the audio block which is currently processed (or was processed last). Allows correlating incoming
+    // MIDI events with the audio timeline from any thread.
+    AudioBlockClock audioBlockClock() const;
+
+    // Measures how long the audio hook takes in each block compared to the block duration. Off by default.
+    void setAudioBlockTimingEnabled(bool enabled);
+
+    util::BlockTimeStatistics audioBlockTimeStatistics() const;
+
+    void resetAudioBlockTimeStatistics();
+
     // DONE-rust
     void stuffMidiMessage(StuffMidiMessageTarget target, const helgoboss::MidiMessage& message);
 
@@ -419,12 +679,28 @@ namespace reaplus {
 
     // DONE-rust
     static void processAudioBuffer(bool isPost, int len, double srate, struct audio_hook_register_t* reg);
+    // Audio thread only. Delivers one incoming MIDI event to the journal (if not null), the queues and the subject.
+    void dispatchIncomingMidiEvent(int inputDeviceId, const MIDI_event_t& midiEvent, const AudioBlockClock& clock,
+        EventJournal* journal, const IncomingMidiEventQueueList* queues);
+    // Audio thread only
+    void dispatchReplayedMidiEvents(const AudioBlockClock& clock, const IncomingMidiEventQueueList* queues);
     static bool processExtensionLine(const char* line, ProjectStateContext* ctx, bool isUndo,
         struct project_config_extension_t* reg);
+    // Feeds the remaining lines of a block to the extension's processBlockLine
+    static void streamBlock(ProjectConfigExtension& extension, ProjectStateContext* ctx, bool isUndo);
+    // Feeds a deduplicated undo snapshot to its extension as if REAPER had read it from the undo point
+    static void restoreUndoSnapshot(const char* line, bool isUndo, struct project_config_extension_t* reg);
+    void forgetUndoSnapshots(ReaProject* project);
     static void beginLoadProjectState(bool isUndo, struct project_config_extension_t* reg);
     static void saveExtensionConfig(ProjectStateContext* ctx, bool isUndo, struct project_config_extension_t* reg);
     
     static helgoboss::MidiMessage createMidiMessageFromEvent(const MIDI_event_t& event);
+
+    // Called by HelperControlSurface whenever MIDI devices might have changed
+    void refreshOpenMidiDevices();
+
+    // Called by HelperControlSurface in each main loop cycle
+    void processIncomingMidiEventsInMainThread();
   };
 }
 
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <rxcpp/rx.hpp>
+
+namespace reaplus {
+  struct BackgroundJobTiming {
+    // Time between submission and start of execution
+    std::chrono::microseconds waitTime;
+    std::chrono::microseconds executionTime;
+  };
+
+  // Passed to background jobs while they are executed
+  class BackgroundJobContext {
+  public:
+    using Clock = std::chrono::steady_clock;
+  private:
+    rxcpp::composite_subscription cancellation_;
+    Clock::time_point submitTime_;
+    Clock::time_point startTime_;
+
+  public:
+    BackgroundJobContext(rxcpp::composite_subscription cancellation, Clock::time_point submitTime,
+        Clock::time_point startTime);
+
+    // Long-running jobs should check this regularly and return early if true
+    bool isCancelled() const;
+
+    // Timing up to now
+    BackgroundJobTiming timing() const;
+  };
+
+  struct WorkerPoolMetrics {
+    size_t threadCount;
+    size_t pendingJobCount;
+    uint64_t executedJobCount;
+    // Jobs which were cancelled before they started
+    uint64_t skippedJobCount;
+    // Jobs which were executed by another worker than the one they were queued at
+    uint64_t stolenJobCount;
+  };
+
+  // Thread pool for pure CPU work (parsing chunks, diffing, searching) which must not touch the REAPER API. Each worker
+  // has its own job queue. Jobs submitted from outside are distributed round-robin, jobs submitted from within a job go
+  // to the queue of the current worker. Idle workers steal from the others. Use Reaper::executeInBackground() instead
+  // of using this directly, it marshals results back to the main thread.
+  class WorkerPool {
+  public:
+    using Clock = BackgroundJobContext::Clock;
+    using Job = std::function<void(const BackgroundJobContext&)>;
+  private:
+    struct QueuedJob {
+      Job job;
+      rxcpp::composite_subscription cancellation;
+      Clock::time_point submitTime;
+    };
+
+    struct Worker {
+      std::mutex mutex;
+      std::deque<QueuedJob> jobs;
+      std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex sleepMutex_;
+    std::condition_variable wakeUpCondition_;
+    // Incremented before a job becomes visible to the workers, so it's never less than the number of queued jobs
+    std::atomic<size_t> pendingJobCount_{0};
+    std::atomic<size_t> nextWorkerIndex_{0};
+    std::atomic<bool> isStopping_{false};
+    std::atomic<uint64_t> executedJobCount_{0};
+    std::atomic<uint64_t> skippedJobCount_{0};
+    std::atomic<uint64_t> stolenJobCount_{0};
+
+  public:
+    // One less than the number of hardware threads (so the main thread keeps a core), at least 1, at most 4
+    static size_t defaultThreadCount();
+
+    explicit WorkerPool(size_t threadCount = defaultThreadCount());
+
+    WorkerPool(const WorkerPool&) = delete;
+
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Waits for running jobs to finish. Jobs which haven't started yet are dropped.
+    ~WorkerPool();
+
+    // Any thread. The job is skipped if the cancellation subscription is unsubscribed before it starts. Exceptions
+    // thrown by the job are logged.
+    void submit(Job job, rxcpp::composite_subscription cancellation = rxcpp::composite_subscription());
+
+    WorkerPoolMetrics metrics() const;
+
+  private:
+    void runWorker(size_t workerIndex);
+
+    bool tryTakeJob(size_t workerIndex, QueuedJob& job);
+
+    void execute(QueuedJob& job);
+  };
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Attributes REAPER API calls to the enclosing ReaPlus method. Costs one atomic load if accounting isn't installed.
+#define REAPLUS_API_CALL_SCOPE(name) \
+  const ::reaplus::util::ApiCallScope REAPLUS_API_CALL_CONCAT(reaplusApiCallScope, __COUNTER__)(name)
+#define REAPLUS_API_CALL_CONCAT(a, b) REAPLUS_API_CALL_CONCAT_IMPL(a, b)
+#define REAPLUS_API_CALL_CONCAT_IMPL(a, b) a##b
+
+namespace reaplus::util {
+  constexpr int MAX_ACCOUNTED_API_COUNT = 128;
+
+  // Main thread. Replaces the REAPER API function pointers used by ReaPlus with trampolines which count each call per
+  // thread and per active ApiCallScope before forwarding. Must be called after the REAPER API has been loaded. Costs
+  // nothing as long as it's not installed. Other threads, e.g. the audio thread, may keep calling REAPER functions
+  // meanwhile because each pointer is swapped atomically.
+  void installApiCallAccounting();
+
+  // Main thread. Restores the original function pointers, atomically like installApiCallAccounting().
+  void uninstallApiCallAccounting();
+
+  bool isApiCallAccountingInstalled();
+
+  struct ApiCallCount {
+    std::string apiName;
+    uint64_t count;
+  };
+
+  // REAPER API calls made by the current thread since installation or reset, most frequent first
+  std::vector<ApiCallCount> threadApiCallCounts();
+
+  void resetThreadApiCallCounts();
+
+  struct ApiCallScopeReport {
+    std::string scopeName;
+    uint64_t invocationCount;
+    // Including calls made in nested scopes
+    uint64_t totalApiCallCount;
+    // Most frequent first
+    std::vector<ApiCallCount> apiCallCounts;
+  };
+
+  // Accumulated API calls of all ApiCallScopes which ended so far, highest average call count per invocation first
+  std::vector<ApiCallScopeReport> apiCallScopeReports();
+
+  // Human-readable version of apiCallScopeReports()
+  std::string formatApiCallScopeReports();
+
+  void resetApiCallScopeReports();
+
+  // Number of ApiCallBudgets which have been exceeded so far
+  uint64_t apiCallBudgetViolationCount();
+
+  // Counts the REAPER API calls of the current thread during its lifetime. Scopes nest, calls are counted in the
+  // innermost one and added to the enclosing one when it ends. When a scope ends, its counts are added to the
+  // per-scope reports. Not meant for real-time threads.
+  class ApiCallScope {
+  private:
+    const char* name_;
+    ApiCallScope* parent_ = nullptr;
+    bool isActive_;
+    std::array<uint32_t, MAX_ACCOUNTED_API_COUNT> counts_;
+
+    friend void recordApiCall(int apiIndex);
+
+  public:
+    // name must have static storage duration (e.g. a string literal)
+    explicit ApiCallScope(const char* name);
+
+    ApiCallScope(const ApiCallScope&) = delete;
+
+    ApiCallScope& operator=(const ApiCallScope&) = delete;
+
+    ~ApiCallScope();
+
+    const char* name() const;
+
+    // Calls so far, including ended nested scopes. Always 0 if accounting was not installed when the scope began.
+    uint64_t totalCount() const;
+
+    uint64_t count(const std::string& apiName) const;
+
+    std::vector<ApiCallCount> counts() const;
+  };
+
+  // Scope which logs the API calls and counts a violation if more than maxCallCount calls are made during its
+  // lifetime. Use it in tests or around high-level operations to catch regressions in the number of host calls.
+  class ApiCallBudget : public ApiCallScope {
+  private:
+    uint64_t maxCallCount_;
+
+  public:
+    ApiCallBudget(const char* name, uint64_t maxCallCount);
+
+    ~ApiCallBudget();
+
+    bool isExceeded() const;
+  };
+
+  // Called by the trampolines
+  void recordApiCall(int apiIndex);
+}
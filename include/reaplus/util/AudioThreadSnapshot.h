@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace reaplus::util {
+
+  // Immutable value which is replaced as a whole by the main thread and read lock-free by the audio thread. Replaced
+  // values are not freed immediately because the audio thread might still use them. They are freed as soon as the
+  // audio block counter has advanced beyond the count observed at replacement time. The audio thread must load the
+  // snapshot at most once per block and must not keep it beyond the block.
+  template<typename T>
+  class AudioThreadSnapshot {
+  private:
+    struct RetiredValue {
+      uint64_t retiredAtAudioBlock;
+      std::unique_ptr<const T> value;
+    };
+    std::unique_ptr<const T> current_;
+    std::atomic<const T*> snapshot_{nullptr};
+    std::vector<RetiredValue> retiredValues_;
+
+  public:
+    // Audio thread. Returns nullptr if nothing has been published yet.
+    const T* load() const {
+      return snapshot_.load();
+    }
+
+    // Main thread. Returns nullptr if nothing has been published yet.
+    const T* current() const {
+      return current_.get();
+    }
+
+    // Main thread
+    void publish(std::unique_ptr<const T> value, const std::atomic<uint64_t>& audioBlockCounter) {
+      auto previousValue = std::move(current_);
+      current_ = std::move(value);
+      snapshot_.store(current_.get());
+      // Must be read after storing the new snapshot. The audio thread might have loaded the previous one in the
+      // current block but not in any later one.
+      const auto audioBlockCount = audioBlockCounter.load();
+      if (previousValue != nullptr) {
+        retiredValues_.push_back({audioBlockCount, std::move(previousValue)});
+      }
+      freeRetiredValues(audioBlockCounter);
+    }
+
+    // Main thread
+    void freeRetiredValues(const std::atomic<uint64_t>& audioBlockCounter) {
+      if (retiredValues_.empty()) {
+        return;
+      }
+      const auto audioBlockCount = audioBlockCounter.load();
+      retiredValues_.erase(
+          std::remove_if(retiredValues_.begin(), retiredValues_.end(), [audioBlockCount](const RetiredValue& r) {
+            return audioBlockCount > r.retiredAtAudioBlock;
+          }),
+          retiredValues_.end()
+      );
+    }
+  };
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+
+namespace reaplus::util {
+
+  // Recycles memory blocks of a few size classes, e.g. for coroutine frames. Freed blocks are kept in per-class free
+  // lists (up to a limit) instead of being returned to the global allocator. Blocks larger than the largest size class
+  // are allocated normally. Thread-safe, but not lock-free, so don't use it in the audio thread.
+  class FramePool {
+  public:
+    static constexpr size_t MIN_BLOCK_SIZE = 128;
+    // Block sizes are 128, 256, 512, 1024 and 2048 bytes
+    static constexpr size_t SIZE_CLASS_COUNT = 5;
+    static constexpr size_t MAX_CACHED_BLOCK_COUNT_PER_CLASS = 64;
+  private:
+    struct FreeBlock {
+      FreeBlock* next;
+    };
+
+    struct SizeClass {
+      std::mutex mutex;
+      FreeBlock* head = nullptr;
+      size_t cachedBlockCount = 0;
+    };
+
+    std::array<SizeClass, SIZE_CLASS_COUNT> sizeClasses_;
+
+  public:
+    static FramePool& instance();
+
+    FramePool() = default;
+
+    FramePool(const FramePool&) = delete;
+
+    FramePool& operator=(const FramePool&) = delete;
+
+    ~FramePool();
+
+    void* allocate(size_t size);
+
+    // size must be the same as passed to allocate()
+    void deallocate(void* block, size_t size) noexcept;
+
+    // Number of blocks currently cached in the free lists
+    size_t cachedBlockCount();
+
+  private:
+    // Returns SIZE_CLASS_COUNT if the size is too large for pooling
+    static size_t sizeClassIndexOf(size_t size);
+
+    static size_t blockSizeOf(size_t sizeClassIndex);
+  };
+
+  // Standard allocator which takes its memory from FramePool::instance(), e.g. for std::allocate_shared()
+  template<typename T>
+  class FramePoolAllocator {
+  public:
+    using value_type = T;
+
+    FramePoolAllocator() = default;
+
+    template<typename U>
+    FramePoolAllocator(const FramePoolAllocator<U>&) noexcept {
+    }
+
+    T* allocate(size_t count) {
+      return static_cast<T*>(FramePool::instance().allocate(count * sizeof(T)));
+    }
+
+    void deallocate(T* block, size_t count) noexcept {
+      FramePool::instance().deallocate(block, count * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const FramePoolAllocator<U>&) const noexcept {
+      return true;
+    }
+
+    template<typename U>
+    bool operator!=(const FramePoolAllocator<U>&) const noexcept {
+      return false;
+    }
+  };
+}
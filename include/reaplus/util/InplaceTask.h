@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace reaplus::util {
+
+  // Move-only replacement for std::function<void(void)> which stores the callable inline, so creating, moving and
+  // destroying it never allocate. A queue of tasks might still allocate storage of its own. Callables which don't fit
+  // into CAPACITY bytes are rejected at compile time. Capture large data by pointer or in a shared_ptr (which allocates
+  // once when created, not when the task is moved).
+  class InplaceTask {
+  public:
+    static constexpr size_t CAPACITY = 64;
+  private:
+    struct Operations {
+      void (* invoke)(void* storage);
+      // Move-constructs into target and destroys source
+      void (* relocate)(void* source, void* target);
+      void (* destroy)(void* storage);
+    };
+
+    template<typename F>
+    struct OperationsFor {
+      static void invoke(void* storage) {
+        (*static_cast<F*>(storage))();
+      }
+
+      static void relocate(void* source, void* target) {
+        auto sourceCallable = static_cast<F*>(source);
+        new(target) F(std::move(*sourceCallable));
+        sourceCallable->~F();
+      }
+
+      static void destroy(void* storage) {
+        static_cast<F*>(storage)->~F();
+      }
+
+      static constexpr Operations OPERATIONS = {&invoke, &relocate, &destroy};
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[CAPACITY];
+    const Operations* operations_ = nullptr;
+
+  public:
+    InplaceTask() = default;
+
+    template<typename F, typename Callable = std::decay_t<F>,
+        typename = std::enable_if_t<!std::is_same<Callable, InplaceTask>::value>>
+    InplaceTask(F&& f) {
+      static_assert(sizeof(Callable) <= CAPACITY, "Callable is too large for InplaceTask, capture less");
+      static_assert(alignof(Callable) <= alignof(std::max_align_t), "Callable is over-aligned for InplaceTask");
+      static_assert(std::is_invocable<Callable&>::value, "InplaceTask requires a callable without arguments");
+      new(storage_) Callable(std::forward<F>(f));
+      operations_ = &OperationsFor<Callable>::OPERATIONS;
+    }
+
+    InplaceTask(InplaceTask&& other) noexcept {
+      if (other.operations_ != nullptr) {
+        other.operations_->relocate(other.storage_, storage_);
+        operations_ = other.operations_;
+        other.operations_ = nullptr;
+      }
+    }
+
+    InplaceTask& operator=(InplaceTask&& other) noexcept {
+      if (this != &other) {
+        reset();
+        if (other.operations_ != nullptr) {
+          other.operations_->relocate(other.storage_, storage_);
+          operations_ = other.operations_;
+          other.operations_ = nullptr;
+        }
+      }
+      return *this;
+    }
+
+    InplaceTask(const InplaceTask&) = delete;
+
+    InplaceTask& operator=(const InplaceTask&) = delete;
+
+    ~InplaceTask() {
+      reset();
+    }
+
+    explicit operator bool() const {
+      return operations_ != nullptr;
+    }
+
+    // Must not be called on an empty task
+    void operator()() {
+      operations_->invoke(storage_);
+    }
+
+    void reset() {
+      if (operations_ != nullptr) {
+        operations_->destroy(storage_);
+        operations_ = nullptr;
+      }
+    }
+  };
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <unordered_map>
+#include <functional>
+#include <vector>
+#include "rxcpp/rx.hpp"
+
+namespace reaplus::util {
+
+  // Hash-indexed table of subjects. Allows consumers to subscribe to events concerning one key only (e.g. one track),
+  // so dispatching an event costs one lookup instead of one filter invocation per subscriber.
+  // Not thread-safe. Meant to be used from the main thread only.
+  template<typename Key, typename T, typename Hash = std::hash<Key>>
+  class KeyedSubjects {
+  private:
+    std::unordered_map<Key, rxcpp::subjects::subject<T>, Hash> subjectByKey_;
+  public:
+    rxcpp::observable<T> observable(Key key) {
+      // Deferred because subjects without observers are removed on dispatch. That way the subject is looked up (and
+      // created if necessary) not before subscription time.
+      return rxcpp::observable<>::defer([this, key] {
+        return subjectByKey_[key].get_observable();
+      });
+    }
+
+    bool empty() const {
+      return subjectByKey_.empty();
+    }
+
+    void next(const Key& key, const T& value) {
+      const auto it = subjectByKey_.find(key);
+      if (it == subjectByKey_.end()) {
+        return;
+      }
+      if (it->second.has_observers()) {
+        it->second.get_subscriber().on_next(value);
+      } else {
+        // All observers have unsubscribed in the meantime
+        subjectByKey_.erase(it);
+      }
+    }
+
+    // Completes and removes the subjects of all keys matching the given predicate. To be called when the objects
+    // identified by these keys cease to exist, e.g. because the key contains a pointer which could be reused.
+    void completeIf(const std::function<bool(const Key&)>& predicate) {
+      // Remove first and complete afterwards because observers might subscribe again while being completed
+      std::vector<rxcpp::subjects::subject<T>> removedSubjects;
+      for (auto it = subjectByKey_.begin(); it != subjectByKey_.end();) {
+        if (predicate(it->first)) {
+          removedSubjects.push_back(std::move(it->second));
+          it = subjectByKey_.erase(it);
+        } else {
+          it++;
+        }
+      }
+      for (auto& subject : removedSubjects) {
+        subject.get_subscriber().on_completed();
+      }
+    }
+  };
+}
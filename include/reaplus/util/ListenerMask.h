@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "rxcpp/rx.hpp"
+
+namespace reaplus::util {
+
+  // Knows for up to 64 event kinds whether anybody listens. Emitters consult it before building event payloads or
+  // querying REAPER, so events nobody is interested in cost one relaxed atomic load. Observables handed out to
+  // consumers must be wrapped with observe() in order to be counted.
+  class ListenerMask {
+  private:
+    struct State {
+      std::atomic<uint64_t> mask{0};
+      // Guards counts and writes to mask. Only locked on subscribe and unsubscribe.
+      std::mutex mutex;
+      std::array<uint32_t, 64> counts{};
+
+      void add(int kind) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (counts[kind]++ == 0) {
+          mask.fetch_or(uint64_t{1} << kind, std::memory_order_relaxed);
+        }
+      }
+
+      void remove(int kind) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--counts[kind] == 0) {
+          mask.fetch_and(~(uint64_t{1} << kind), std::memory_order_relaxed);
+        }
+      }
+    };
+
+    // Shared with the subscriptions because they might end after the owner of this mask has been destroyed
+    std::shared_ptr<State> state_ = std::make_shared<State>();
+
+  public:
+    template<typename Kind>
+    bool hasListeners(Kind kind) const {
+      return (state_->mask.load(std::memory_order_relaxed) & bitOf(kind)) != 0;
+    }
+
+    template<typename Kind>
+    bool hasListeners(Kind kind, Kind otherKind) const {
+      return (state_->mask.load(std::memory_order_relaxed) & (bitOf(kind) | bitOf(otherKind))) != 0;
+    }
+
+    // Returns an observable which counts as listener of the given kind for as long as it's subscribed
+    template<typename Kind, typename T>
+    rxcpp::observable<T> observe(Kind kind, rxcpp::observable<T> source) const {
+      const auto state = state_;
+      const auto kindIndex = static_cast<int>(kind);
+      return rxcpp::observable<>::create<T>([state, kindIndex, source](rxcpp::subscriber<T> subscriber) {
+        state->add(kindIndex);
+        subscriber.add([state, kindIndex] {
+          state->remove(kindIndex);
+        });
+        source.subscribe(subscriber);
+      });
+    }
+
+  private:
+    template<typename Kind>
+    static uint64_t bitOf(Kind kind) {
+      return uint64_t{1} << static_cast<int>(kind);
+    }
+  };
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compile with REAPLUS_RT_SAFETY_CHECKS to enable the checkpoints and to replace the global operator new/delete by
+// versions which report allocations in real-time scopes. Without it, the checkpoints compile to nothing.
+#ifdef REAPLUS_RT_SAFETY_CHECKS
+#define REAPLUS_RT_CHECK(kind) \
+  ::reaplus::util::checkRealTimeSafety(::reaplus::util::RealTimeViolationKind::kind, __FILE__ ":" REAPLUS_RT_LINE)
+#define REAPLUS_RT_LINE REAPLUS_RT_STRINGIFY(__LINE__)
+#define REAPLUS_RT_STRINGIFY(x) REAPLUS_RT_STRINGIFY_IMPL(x)
+#define REAPLUS_RT_STRINGIFY_IMPL(x) #x
+#else
+#define REAPLUS_RT_CHECK(kind) ((void) 0)
+#endif
+
+namespace reaplus::util {
+  enum class RealTimeViolationKind : uint8_t {
+    Allocation,
+    Deallocation,
+    MutexLock,
+    Logging
+  };
+
+  enum class RealTimeSafetyMode {
+    // Violations are ignored
+    Off,
+    // Violations are counted per call site
+    Count,
+    // Violations stop the process, so a debugger shows the offending stack
+    Trap
+  };
+
+  struct RealTimeViolation {
+    RealTimeViolationKind kind;
+    // Source location for explicit checkpoints, code address for allocations (resolve e.g. with addr2line)
+    std::string callSite;
+    uint64_t count;
+  };
+
+  // Marks the current thread as executing real-time code (e.g. the audio hook) as long as it exists. Nestable.
+  class RealTimeScope {
+  public:
+    RealTimeScope();
+
+    ~RealTimeScope();
+
+    RealTimeScope(const RealTimeScope&) = delete;
+
+    RealTimeScope& operator=(const RealTimeScope&) = delete;
+  };
+
+  bool isInRealTimeScope();
+
+  // Default is Count if compiled with REAPLUS_RT_SAFETY_CHECKS, otherwise Off
+  void setRealTimeSafetyMode(RealTimeSafetyMode mode);
+
+  RealTimeSafetyMode realTimeSafetyMode();
+
+  // Reports a violation if the current thread is in a real-time scope. Doesn't allocate or lock. callSite must have
+  // static storage duration. Use REAPLUS_RT_CHECK instead of calling this directly.
+  void checkRealTimeSafety(RealTimeViolationKind kind, const char* callSite);
+
+  // Same for call sites which are only known as code address
+  void checkRealTimeSafety(RealTimeViolationKind kind, const void* codeAddress);
+
+  // Main thread. Returns all violations recorded so far. Call sites beyond a fixed table size are aggregated into
+  // one entry with an empty call site.
+  std::vector<RealTimeViolation> realTimeViolations();
+
+  void resetRealTimeViolations();
+
+  std::string toString(RealTimeViolationKind kind);
+
+  struct BlockTimeStatistics {
+    // Bucket n counts blocks which took between n and n + 1 BUCKET_WIDTH fractions of their deadline. The last
+    // bucket counts blocks which missed their deadline.
+    std::vector<uint64_t> buckets;
+    double bucketWidth;
+    uint64_t blockCount;
+    uint64_t deadlineMissCount;
+    // Highest execution time divided by deadline
+    double maxLoad;
+  };
+
+  // Lock-free histogram of execution times of real-time blocks relative to their deadline. Recording is wait-free and
+  // can happen in the audio thread.
+  class BlockTimeHistogram {
+  public:
+    static constexpr int BUCKET_COUNT = 21;
+    static constexpr double BUCKET_WIDTH = 0.05;
+  private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_;
+    std::atomic<uint64_t> maxLoadInPermille_{0};
+  public:
+    BlockTimeHistogram();
+
+    void record(double elapsedSeconds, double deadlineSeconds);
+
+    BlockTimeStatistics statistics() const;
+
+    void reset();
+  };
+}
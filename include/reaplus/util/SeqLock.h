@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace reaplus::util {
+
+  // Publishes a small value from exactly one writer thread to any number of reader threads. Writing never blocks,
+  // so the writer can be the audio thread. Readers retry if they raced with the writer.
+  template<typename T>
+  class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock values must be trivially copyable");
+  private:
+    static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    // Odd while being written
+    std::atomic<uint64_t> sequence_{0};
+    std::array<std::atomic<uint64_t>, WORD_COUNT> words_{};
+
+  public:
+    // Writer only
+    void store(const T& value) {
+      uint64_t words[WORD_COUNT] = {};
+      std::memcpy(words, &value, sizeof(T));
+      const auto sequence = sequence_.load(std::memory_order_relaxed);
+      sequence_.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (size_t i = 0; i < WORD_COUNT; i++) {
+        words_[i].store(words[i], std::memory_order_relaxed);
+      }
+      sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Returns a zero-initialized value if nothing has been stored yet
+    T load() const {
+      uint64_t words[WORD_COUNT];
+      while (true) {
+        const auto sequenceBefore = sequence_.load(std::memory_order_acquire);
+        if ((sequenceBefore & 1) != 0) {
+          continue;
+        }
+        for (size_t i = 0; i < WORD_COUNT; i++) {
+          words[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_.load(std::memory_order_relaxed) == sequenceBefore) {
+          break;
+        }
+      }
+      T value;
+      std::memcpy(&value, words, sizeof(T));
+      return value;
+    }
+  };
+}
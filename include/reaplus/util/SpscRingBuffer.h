@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace reaplus::util {
+
+  // Wait-free bounded queue for exactly one producer thread and one consumer thread. Doesn't allocate after
+  // construction, so it can be used on the audio thread. Capacity is rounded up to the next power of two.
+  template<typename T>
+  class SpscRingBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRingBuffer elements must be trivially copyable");
+  private:
+    std::unique_ptr<T[]> elements_;
+    size_t capacityMask_;
+    // Written by consumer only
+    alignas(64) std::atomic<size_t> readIndex_{0};
+    // Written by producer only
+    alignas(64) std::atomic<size_t> writeIndex_{0};
+
+    static size_t nextPowerOfTwo(size_t value) {
+      size_t result = 1;
+      while (result < value) {
+        result <<= 1;
+      }
+      return result;
+    }
+
+  public:
+    explicit SpscRingBuffer(size_t capacity) :
+        elements_(new T[nextPowerOfTwo(capacity)]),
+        capacityMask_(nextPowerOfTwo(capacity) - 1) {
+    }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    size_t capacity() const {
+      return capacityMask_ + 1;
+    }
+
+    // Producer only. Returns false if full.
+    bool tryPush(const T& element) {
+      const auto writeIndex = writeIndex_.load(std::memory_order_relaxed);
+      if (writeIndex - readIndex_.load(std::memory_order_acquire) > capacityMask_) {
+        return false;
+      }
+      elements_[writeIndex & capacityMask_] = element;
+      writeIndex_.store(writeIndex + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer only. Returns false if empty.
+    bool tryPop(T& element) {
+      const auto readIndex = readIndex_.load(std::memory_order_relaxed);
+      if (readIndex == writeIndex_.load(std::memory_order_acquire)) {
+        return false;
+      }
+      element = elements_[readIndex & capacityMask_];
+      readIndex_.store(readIndex + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Producer only. Pushes either all of the given elements or none. Returns false if there's not enough space.
+    bool tryPushAll(const T* elements, size_t count) {
+      const auto writeIndex = writeIndex_.load(std::memory_order_relaxed);
+      if (capacity() - (writeIndex - readIndex_.load(std::memory_order_acquire)) < count) {
+        return false;
+      }
+      for (size_t i = 0; i < count; i++) {
+        elements_[(writeIndex + i) & capacityMask_] = elements[i];
+      }
+      writeIndex_.store(writeIndex + count, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer only. Pops either exactly the given number of elements or none. Returns false if not enough available.
+    bool tryPopAll(T* elements, size_t count) {
+      const auto readIndex = readIndex_.load(std::memory_order_relaxed);
+      if (writeIndex_.load(std::memory_order_acquire) - readIndex < count) {
+        return false;
+      }
+      for (size_t i = 0; i < count; i++) {
+        elements[i] = elements_[(readIndex + i) & capacityMask_];
+      }
+      readIndex_.store(readIndex + count, std::memory_order_release);
+      return true;
+    }
+
+    // Approximate if called while the other side is active
+    size_t size() const {
+      return writeIndex_.load(std::memory_order_acquire) - readIndex_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+      return size() == 0;
+    }
+  };
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Compile with REAPLUS_TRACING to record trace spans. Without it, REAPLUS_TRACE_SPAN compiles to nothing.
+#ifdef REAPLUS_TRACING
+#define REAPLUS_TRACE_SPAN(name) \
+  const ::reaplus::util::TraceSpan REAPLUS_TRACE_CONCAT(reaplusTraceSpan, __COUNTER__)(name)
+#define REAPLUS_TRACE_THREAD_NAME(name) ::reaplus::util::setTraceThreadName(name)
+#define REAPLUS_TRACE_CONCAT(a, b) REAPLUS_TRACE_CONCAT_IMPL(a, b)
+#define REAPLUS_TRACE_CONCAT_IMPL(a, b) a##b
+#else
+#define REAPLUS_TRACE_SPAN(name) ((void) 0)
+#define REAPLUS_TRACE_THREAD_NAME(name) ((void) 0)
+#endif
+
+namespace reaplus::util {
+  struct TraceEvent {
+    // Static string
+    const char* name;
+    // Since the first recorded event of the process
+    uint64_t startInNanos;
+    uint64_t durationInNanos;
+  };
+
+  // Records the time from construction to destruction into a buffer of the current thread. Recording is lock-free and
+  // doesn't allocate, except for the first span of each thread, which creates that thread's buffer (or takes over the
+  // buffer of an exited thread). If the buffer is full, the event is dropped. Use REAPLUS_TRACE_SPAN instead of using
+  // this directly.
+  class TraceSpan {
+  private:
+    const char* name_;
+    uint64_t startInNanos_;
+
+  public:
+    // name must have static storage duration
+    explicit TraceSpan(const char* name);
+
+    TraceSpan(const TraceSpan&) = delete;
+
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan();
+  };
+
+  // Names the current thread in exported traces, e.g. "Main" or "Audio". name must have static storage duration. Also
+  // creates the buffer of the current thread, so real-time threads should call it before entering a RealTimeScope.
+  // Calling it again with the same name is cheap. Use REAPLUS_TRACE_THREAD_NAME instead of calling this directly.
+  void setTraceThreadName(const char* name);
+
+  // Removes all recorded events from the buffers of all threads and writes them in the Chrome trace event format,
+  // which can be opened in chrome://tracing and in the Perfetto UI. Returns the number of written events. Must not be
+  // called in a real-time thread.
+  size_t flushTraceToChromeJson(const std::string& filePath);
+
+  // Number of events dropped so far because a buffer was full
+  uint64_t droppedTraceEventCount();
+}
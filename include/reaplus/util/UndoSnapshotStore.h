@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace reaplus::util {
+
+  // Keeps the distinct states which undo points refer to. REAPER doesn't tell which undo points it still has, so the
+  // least recently used snapshots are evicted as soon as either limit is exceeded. Undo points which refer to an
+  // evicted snapshot can't be restored anymore.
+  class UndoSnapshotStore {
+  public:
+    static constexpr size_t DEFAULT_MAX_SNAPSHOT_COUNT = 100;
+    static constexpr size_t DEFAULT_MAX_TOTAL_SIZE = 16 * 1024 * 1024;
+  private:
+    struct Snapshot {
+      uint64_t id;
+      size_t contentHash;
+      std::string content;
+    };
+
+    size_t maxSnapshotCount_;
+    size_t maxTotalSize_;
+    // Most recently used first
+    std::list<Snapshot> snapshots_;
+    std::unordered_map<uint64_t, std::list<Snapshot>::iterator> snapshotById_;
+    // Keyed by content hash. Contents are compared on lookup, so colliding states are not mixed up.
+    std::unordered_multimap<size_t, std::list<Snapshot>::iterator> snapshotByContentHash_;
+    size_t totalSize_ = 0;
+    uint64_t nextId_ = 0;
+
+  public:
+    explicit UndoSnapshotStore(size_t maxSnapshotCount = DEFAULT_MAX_SNAPSHOT_COUNT,
+        size_t maxTotalSize = DEFAULT_MAX_TOTAL_SIZE);
+
+    // Returns the ID of the snapshot with the given content, adding one if there's none yet. The returned snapshot is
+    // never evicted by this call, even if it alone exceeds the size limit.
+    uint64_t add(std::string content);
+
+    // Returns null if there's no such snapshot (anymore). Counts as a use.
+    const std::string* find(uint64_t id);
+
+    bool contains(uint64_t id) const;
+
+    size_t snapshotCount() const;
+
+    // Sum of the content sizes
+    size_t totalSize() const;
+
+  private:
+    void touch(std::list<Snapshot>::iterator snapshot);
+
+    void evictExcessSnapshots();
+  };
+}
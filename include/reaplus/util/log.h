@@ -12,12 +12,39 @@ namespace reaplus::util {
   spdlog::sinks_init_list& getDefaultLogSinks();
   // DONE-rust
   spdlog::logger& getMainLogger();
+  // Messages are rate-limited per call site. Suppressed messages are counted and reported later. Messages longer than
+  // 512 bytes are truncated.
   // DONE-rust
   void log(const std::string& msg);
+  // Must be called while handling an exception. In real-time threads only the exception's what() is logged because
+  // the full diagnostic information would allocate.
   // DONE-rust
   void logException();
+  // Like logException() but rate-limited under the given site instead of the calling code location. The site must
+  // have static storage duration, e.g. a string literal.
+  void logException(const char* site);
+  // Starts a background thread which writes the log messages, so that logging doesn't do I/O in the calling thread.
+  // If logFilePath is not empty, messages are also written to that file (rotated when it gets large). Before starting
+  // and after stopping, messages are written synchronously.
+  void startAsyncLogging(const std::string& logFilePath);
+
+  // Writes the queued messages and stops the background thread
+  void stopAsyncLogging();
+
+  struct LogStatistics {
+    // Messages not logged because their call site exceeded its rate limit
+    uint64_t suppressedCount;
+    // Messages not logged because the async queue was full
+    uint64_t droppedCount;
+  };
+
+  LogStatistics logStatistics();
+
+  // All errors passed to this handler share one rate limit. Prefer makeLoggingErrorHandler().
   // DONE-rust
   std::function<void(std::exception_ptr)>& getLoggingErrorHandler();
+  // Returns an error handler which logs errors rate-limited under the given site (see logException(const char*))
+  std::function<void(std::exception_ptr)> makeLoggingErrorHandler(const char* site);
   // DONE-rust
   std::function<void(std::exception_ptr)>& getRethrowErrorHandler();
 }
\ No newline at end of file
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "rxcpp/rx.hpp"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace rxcpp {
+
+namespace schedulers {
+
+namespace detail {
+
+// State shared between a timer_wheel_run_loop (the only consumer) and its workers (any number of producers). Producers
+// push onto a lock-free stack. The consumer owns the timer wheel, so scheduling is O(1) and dispatching never blocks.
+struct timer_wheel_state : public std::enable_shared_from_this<timer_wheel_state>
+{
+    typedef scheduler::clock_type clock_type;
+
+    struct item
+    {
+        item(clock_type::time_point w, const schedulable& s) : when(w), what(s), next(nullptr) {}
+        clock_type::time_point when;
+        schedulable what;
+        item* next;
+    };
+
+    struct item_list
+    {
+        item* head = nullptr;
+        item* tail = nullptr;
+
+        bool empty() const {
+            return head == nullptr;
+        }
+
+        void push_back(item* i) {
+            i->next = nullptr;
+            if (tail == nullptr) {
+                head = i;
+            } else {
+                tail->next = i;
+            }
+            tail = i;
+        }
+
+        item* pop_front() {
+            auto i = head;
+            if (i != nullptr) {
+                head = i->next;
+                if (head == nullptr) {
+                    tail = nullptr;
+                }
+                i->next = nullptr;
+            }
+            return i;
+        }
+
+        item* take_all() {
+            auto i = head;
+            head = nullptr;
+            tail = nullptr;
+            return i;
+        }
+    };
+
+    static constexpr int slot_bits = 6;
+    static constexpr int slot_count = 1 << slot_bits;
+    static constexpr int level_count = 4;
+
+    explicit timer_wheel_state(clock_type::duration r)
+        : resolution(r)
+        , epoch(clock_type::now())
+    {
+    }
+
+    ~timer_wheel_state()
+    {
+        delete_chain(submitted.exchange(nullptr));
+        delete_chain(retired.exchange(nullptr));
+        delete_chain(ready.take_all());
+        delete_chain(far.take_all());
+        for (auto& level : wheel) {
+            for (auto& slot : level) {
+                delete_chain(slot.take_all());
+            }
+        }
+    }
+
+    composite_subscription lifetime;
+    recursion r;
+    // Written by producers, taken as a whole by the consumer
+    std::atomic<item*> submitted{nullptr};
+    // Executed items, written by the consumer, freed by whoever calls collect_garbage()
+    std::atomic<item*> retired{nullptr};
+    // Consumer only
+    const clock_type::duration resolution;
+    const clock_type::time_point epoch;
+    uint64_t current_tick = 0;
+    size_t pending_count = 0;
+    item_list wheel[level_count][slot_count];
+    // Bit n of level l is set if wheel[l][n] is not empty. Lets advance() skip idle ticks.
+    uint64_t occupied_slots[level_count] = {};
+    // Items too far in the future for the wheel
+    item_list far;
+    item_list ready;
+
+    static void delete_chain(item* i) {
+        while (i != nullptr) {
+            auto next = i->next;
+            delete i;
+            i = next;
+        }
+    }
+
+    static void push(std::atomic<item*>& stack, item* i) {
+        i->next = stack.load(std::memory_order_relaxed);
+        while (!stack.compare_exchange_weak(i->next, i, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Rounds up, so items are never executed early
+    uint64_t due_tick_of(clock_type::time_point when) const {
+        if (when <= epoch) {
+            return 0;
+        }
+        return (uint64_t) ((when - epoch + resolution - clock_type::duration(1)) / resolution);
+    }
+
+    uint64_t elapsed_tick_of(clock_type::time_point now) const {
+        if (now <= epoch) {
+            return 0;
+        }
+        return (uint64_t) ((now - epoch) / resolution);
+    }
+
+    // Any thread
+    void submit(item* i) {
+        push(submitted, i);
+    }
+
+    // Any thread except the consumer thread if that one is real-time
+    void collect_garbage() {
+        delete_chain(retired.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    // Consumer only
+    void retire(item* i) {
+        push(retired, i);
+    }
+
+    // Index of the lowest set bit. Must not be called with 0.
+    static int lowest_set_bit(uint64_t bits) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return (int) index;
+#else
+        return __builtin_ctzll(bits);
+#endif
+    }
+
+    // Consumer only
+    void insert(item* i) {
+        const auto tick = due_tick_of(i->when);
+        if (tick <= current_tick) {
+            ready.push_back(i);
+            return;
+        }
+        // Choose the lowest level whose slot is cascaded before the item is due
+        for (int level = 0; level < level_count; level++) {
+            const auto upper_shift = slot_bits * (level + 1);
+            if ((tick >> upper_shift) == (current_tick >> upper_shift)) {
+                const auto slot = (tick >> (slot_bits * level)) & (slot_count - 1);
+                wheel[level][slot].push_back(i);
+                occupied_slots[level] |= uint64_t(1) << slot;
+                pending_count++;
+                return;
+            }
+        }
+        far.push_back(i);
+        pending_count++;
+    }
+
+    // Consumer only
+    void take_submitted() {
+        auto i = submitted.exchange(nullptr, std::memory_order_acquire);
+        // Reverse in order to restore submission order
+        item* reversed = nullptr;
+        while (i != nullptr) {
+            auto next = i->next;
+            i->next = reversed;
+            reversed = i;
+            i = next;
+        }
+        while (reversed != nullptr) {
+            auto next = reversed->next;
+            insert(reversed);
+            reversed = next;
+        }
+    }
+
+    // Consumer only
+    void reinsert_all(item_list& list) {
+        auto i = list.take_all();
+        while (i != nullptr) {
+            auto next = i->next;
+            pending_count--;
+            insert(i);
+            i = next;
+        }
+    }
+
+    // Consumer only
+    void cascade(int level, uint64_t slot) {
+        occupied_slots[level] &= ~(uint64_t(1) << slot);
+        reinsert_all(wheel[level][slot]);
+    }
+
+    // Consumer only. Returns the next tick after the current one at which a slot must be cascaded or moved to the
+    // ready list. Returns UINT64_MAX if there's none. Items of each level are always in slots after the current one
+    // within the current period of the next higher level, so later periods don't need to be considered.
+    uint64_t next_event_tick() const {
+        auto result = UINT64_MAX;
+        for (int level = 0; level < level_count; level++) {
+            const auto shift = slot_bits * level;
+            const auto current_slot = (current_tick >> shift) & (slot_count - 1);
+            // Shifting by 64 would be undefined
+            const auto slots_after_current = current_slot == slot_count - 1
+                                             ? uint64_t(0)
+                                             : ~((uint64_t(2) << current_slot) - 1);
+            const auto candidates = occupied_slots[level] & slots_after_current;
+            if (candidates == 0) {
+                continue;
+            }
+            const auto period_start = (current_tick >> (shift + slot_bits)) << (shift + slot_bits);
+            const auto tick = period_start | (uint64_t(lowest_set_bit(candidates)) << shift);
+            if (tick < result) {
+                result = tick;
+            }
+        }
+        if (!far.empty()) {
+            const auto wheel_bits = slot_bits * level_count;
+            const auto tick = ((current_tick >> wheel_bits) + 1) << wheel_bits;
+            if (tick < result) {
+                result = tick;
+            }
+        }
+        return result;
+    }
+
+    // Consumer only. Moves all items which are due at the given time to the ready list. Jumps over ticks at which
+    // nothing is due, so the work doesn't depend on how long the loop hasn't been advanced.
+    void advance(clock_type::time_point now) {
+        take_submitted();
+        const auto target_tick = elapsed_tick_of(now);
+        while (current_tick < target_tick) {
+            const auto event_tick = pending_count == 0 ? UINT64_MAX : next_event_tick();
+            if (event_tick > target_tick) {
+                current_tick = target_tick;
+                break;
+            }
+            current_tick = event_tick;
+            // Cascade from the highest level whose period has just started down to level 1
+            int highest_level = 0;
+            while (highest_level < level_count
+                && (current_tick & ((uint64_t(1) << (slot_bits * (highest_level + 1))) - 1)) == 0) {
+                highest_level++;
+            }
+            if (highest_level == level_count) {
+                reinsert_all(far);
+                highest_level--;
+            }
+            for (int level = highest_level; level >= 1; level--) {
+                cascade(level, (current_tick >> (slot_bits * level)) & (slot_count - 1));
+            }
+            const auto slot_index = current_tick & (slot_count - 1);
+            auto& slot = wheel[0][slot_index];
+            while (auto i = slot.pop_front()) {
+                pending_count--;
+                ready.push_back(i);
+            }
+            occupied_slots[0] &= ~(uint64_t(1) << slot_index);
+        }
+    }
+
+    // Consumer only. Executes the first ready item. Returns false if there was none.
+    bool dispatch_ready() {
+        auto i = ready.pop_front();
+        if (i == nullptr) {
+            return false;
+        }
+        if (i->what.is_subscribed()) {
+            r.reset(ready.empty());
+            try {
+                i->what(r.get_recurse());
+            } catch (...) {
+                retire(i);
+                throw;
+            }
+        }
+        retire(i);
+        return true;
+    }
+};
+
+}
+
+struct timer_wheel_scheduler : public scheduler_interface
+{
+private:
+    typedef timer_wheel_scheduler this_type;
+    timer_wheel_scheduler(const this_type&);
+
+    struct timer_wheel_worker : public worker_interface
+    {
+    private:
+        typedef timer_wheel_worker this_type;
+        timer_wheel_worker(const this_type&);
+    public:
+        std::weak_ptr<detail::timer_wheel_state> state;
+        virtual ~timer_wheel_worker()
+        {
+        }
+        explicit timer_wheel_worker(std::weak_ptr<detail::timer_wheel_state> ws)
+            : state(ws)
+        {
+        }
+
+        virtual clock_type::time_point now() const {
+            return clock_type::now();
+        }
+
+        virtual void schedule(const schedulable& scbl) const {
+            schedule(now(), scbl);
+        }
+
+        virtual void schedule(clock_type::time_point when, const schedulable& scbl) const {
+            if (scbl.is_subscribed()) {
+                if (auto st = state.lock()) {
+                    st->submit(new detail::timer_wheel_state::item(when, scbl));
+                }
+            }
+        }
+    };
+
+    std::weak_ptr<detail::timer_wheel_state> state;
+
+public:
+    explicit timer_wheel_scheduler(std::weak_ptr<detail::timer_wheel_state> ws)
+        : state(ws)
+    {
+    }
+    virtual ~timer_wheel_scheduler()
+    {
+    }
+
+    virtual clock_type::time_point now() const {
+        return clock_type::now();
+    }
+
+    virtual worker create_worker(composite_subscription cs) const {
+        // If the run loop is already gone, the worker just doesn't schedule anything
+        if (auto st = state.lock()) {
+            auto lifetime = st->lifetime;
+            auto token = lifetime.add(cs);
+            cs.add([=](){lifetime.remove(token);});
+        }
+        return worker(cs, std::make_shared<timer_wheel_worker>(state));
+    }
+};
+
+// Run loop which is driven manually, e.g. from REAPER's main loop or audio hook. Items can be scheduled from any thread
+// without locking. They are executed by whichever thread calls dispatch() (the consumer). Executed items are not freed
+// by the consumer, which makes this suitable for the audio thread, as long as some other thread calls
+// collect_garbage() regularly.
+class timer_wheel_run_loop
+{
+private:
+    typedef timer_wheel_run_loop this_type;
+    // don't allow this instance to copy/move since it owns the state
+    timer_wheel_run_loop(const this_type&);
+    timer_wheel_run_loop(const this_type&&);
+
+    typedef scheduler::clock_type clock_type;
+
+    std::shared_ptr<detail::timer_wheel_state> state;
+    std::shared_ptr<timer_wheel_scheduler> sc;
+
+public:
+    explicit timer_wheel_run_loop(clock_type::duration resolution = std::chrono::milliseconds(1))
+        : state(std::make_shared<detail::timer_wheel_state>(resolution))
+        , sc(std::make_shared<timer_wheel_scheduler>(state))
+    {
+    }
+    ~timer_wheel_run_loop()
+    {
+        state->lifetime.unsubscribe();
+    }
+
+    clock_type::time_point now() const {
+        return clock_type::now();
+    }
+
+    composite_subscription get_subscription() const {
+        return state->lifetime;
+    }
+
+    // Consumer only. Moves items which are due at the given time to the ready list.
+    void advance(clock_type::time_point now) const {
+        state->advance(now);
+    }
+
+    // Consumer only. Executes the next ready item. Returns false if no item is ready.
+    bool dispatch_ready() const {
+        return state->dispatch_ready();
+    }
+
+    // Consumer only. Executes all items which are due now. Items scheduled while dispatching wait for the next call.
+    void dispatch() const {
+        state->advance(now());
+        while (state->dispatch_ready()) {
+        }
+    }
+
+    // Frees executed items. Must not be called in a real-time thread.
+    void collect_garbage() const {
+        state->collect_garbage();
+    }
+
+    scheduler get_scheduler() const {
+        return make_scheduler(sc);
+    }
+};
+
+inline scheduler make_timer_wheel_run_loop(const timer_wheel_run_loop& r) {
+    return r.get_scheduler();
+}
+
+}
+
+}
@@ -0,0 +1,19 @@
+#include <reaplus/AudioBlockClock.h>
+#include <cmath>
+
+namespace {
+  const double MIDI_FRAME_OFFSETS_PER_SECOND = 1024000.0;
+}
+
+namespace reaplus {
+  uint64_t AudioBlockClock::sampleTimeOf(int midiFrameOffset) const {
+    const auto offsetInSamples = std::llround(midiFrameOffset * sampleRate / MIDI_FRAME_OFFSETS_PER_SECOND);
+    return offsetInSamples < 0 && (uint64_t) -offsetInSamples > blockStartSample
+           ? 0
+           : blockStartSample + offsetInSamples;
+  }
+
+  double AudioBlockClock::timeOf(int midiFrameOffset) const {
+    return blockStartTime + midiFrameOffset / MIDI_FRAME_OFFSETS_PER_SECOND;
+  }
+}
@@ -0,0 +1,358 @@
+#include <reaplus/EventJournal.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <reaper_plugin_functions.h>
+
+using std::string;
+using std::vector;
+
+namespace {
+  const char JOURNAL_FILE_MAGIC[4] = {'R', 'P', 'E', 'J'};
+  // Version 1 didn't record SysEx payloads but is otherwise compatible
+  const uint32_t JOURNAL_FILE_VERSION = 2;
+
+  struct JournalFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+    uint64_t recordCount;
+  };
+
+  const uint16_t PARM1_PRESENT = 1;
+  const uint16_t PARM2_PRESENT = 2;
+  const uint16_t PARM3_PRESENT = 4;
+
+  uint64_t nextPowerOfTwo(size_t value) {
+    uint64_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+  }
+
+  int readInt(void* parm) {
+    return parm == nullptr ? 0 : *static_cast<int*>(parm);
+  }
+
+  double readDouble(void* parm) {
+    return parm == nullptr ? 0 : *static_cast<double*>(parm);
+  }
+
+  // The fields of a record which carry SysEx payload, in order
+  template<typename Record, typename F>
+  void forEachPayloadField(Record& record, F&& f) {
+    f(&record.track, sizeof(record.track));
+    f(&record.double1, sizeof(record.double1));
+    f(&record.double2, sizeof(record.double2));
+    f(&record.data, sizeof(record.data));
+  }
+}
+
+namespace reaplus {
+  EventJournal::EventJournal(size_t capacity) :
+      slots_(new Slot[nextPowerOfTwo(capacity)]),
+      capacityMask_(nextPowerOfTwo(capacity) - 1),
+      startTimeNanos_(steadyNanos()) {
+  }
+
+  size_t EventJournal::capacity() const {
+    return capacityMask_ + 1;
+  }
+
+  void EventJournal::restart() {
+    startTimeNanos_.store(steadyNanos(), std::memory_order_relaxed);
+    firstTicket_.store(writeTicket_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+
+  uint64_t EventJournal::nowNanos() const {
+    return (uint64_t) (steadyNanos() - startTimeNanos_.load(std::memory_order_relaxed));
+  }
+
+  template<typename Fill>
+  void EventJournal::write(EventJournalRecordKind kind, Fill&& fill) {
+    const auto ticket = writeTicket_.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = slots_[ticket & capacityMask_];
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    auto& r = slot.record;
+    r.timestamp = nowNanos();
+    r.kind = kind;
+    fill(r);
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+  }
+
+  void EventJournal::record(EventJournalRecordKind kind, MediaTrack* track, int int1, int int2, double double1,
+      double double2, uint32_t data, uint16_t flags) {
+    write(kind, [&](EventJournalRecord& r) {
+      r.track = (uint64_t) (uintptr_t) track;
+      r.double1 = double1;
+      r.double2 = double2;
+      r.int1 = int1;
+      r.int2 = int2;
+      r.data = data;
+      r.flags = flags;
+    });
+  }
+
+  void EventJournal::recordExtended(int call, void* parm1, void* parm2, void* parm3) {
+    const uint16_t flags = (parm1 ? PARM1_PRESENT : 0) | (parm2 ? PARM2_PRESENT : 0) | (parm3 ? PARM3_PRESENT : 0);
+    const auto kind = EventJournalRecordKind::Extended;
+    const auto track = (MediaTrack*) parm1;
+    switch (call) {
+      case CSURF_EXT_SETINPUTMONITOR:
+        record(kind, track, call, readInt(parm2), 0, 0, 0, flags);
+        break;
+      case CSURF_EXT_SETFXPARAM:
+      case CSURF_EXT_SETFXPARAM_RECFX:
+      case CSURF_EXT_SETSENDVOLUME:
+      case CSURF_EXT_SETSENDPAN:
+        record(kind, track, call, readInt(parm2), readDouble(parm3), 0, 0, flags);
+        break;
+      case CSURF_EXT_SETFXENABLED:
+      case CSURF_EXT_SETFXOPEN:
+        // parm3 is a boolean encoded as pointer, so flags are enough
+        record(kind, track, call, readInt(parm2), 0, 0, 0, flags);
+        break;
+      case CSURF_EXT_SETLASTTOUCHEDFX:
+      case CSURF_EXT_SETFOCUSEDFX:
+        record(kind, track, call, readInt(parm3), 0, 0, (uint32_t) readInt(parm2), flags);
+        break;
+      case CSURF_EXT_SETFXCHANGE:
+        record(kind, track, call, (int) (intptr_t) parm2, 0, 0, 0, flags);
+        break;
+      case CSURF_EXT_SETLASTTOUCHEDTRACK:
+      case CSURF_EXT_SETMIXERSCROLL:
+        record(kind, track, call, 0, 0, 0, 0, flags);
+        break;
+      case CSURF_EXT_SETBPMANDPLAYRATE:
+        record(kind, nullptr, call, 0, readDouble(parm1), readDouble(parm2), 0, flags);
+        break;
+      default:
+        // We don't know what the parameters mean, so just record that the call happened
+        record(kind, nullptr, call, 0, 0, 0, 0, flags);
+        break;
+    }
+  }
+
+  void EventJournal::recordIncomingMidiEvent(int inputDeviceId, const MIDI_event_t& midiEvent) {
+    const auto& msg = midiEvent.midi_message;
+    const uint32_t data = (uint32_t) msg[0] | ((uint32_t) msg[1] << 8) | ((uint32_t) msg[2] << 16);
+    const bool isSysEx = midiEvent.size > 3;
+    const bool isTooLarge = isSysEx && (size_t) midiEvent.size > MAX_SYSEX_SIZE;
+    const auto size = (uint16_t) (isTooLarge ? 0 : std::max(midiEvent.size, 0));
+    record(EventJournalRecordKind::IncomingMidiEvent, nullptr, inputDeviceId, midiEvent.frame_offset, 0, 0, data,
+        size);
+    if (!isSysEx || isTooLarge) {
+      return;
+    }
+    for (size_t offset = 0; offset < size; offset += SYSEX_BYTES_PER_RECORD) {
+      write(EventJournalRecordKind::IncomingSysExData, [&](EventJournalRecord& r) {
+        r.int1 = inputDeviceId;
+        r.int2 = (int32_t) offset;
+        r.flags = 0;
+        auto source = midiEvent.midi_message + offset;
+        auto remaining = (size_t) size - offset;
+        forEachPayloadField(r, [&](void* field, size_t fieldSize) {
+          std::memset(field, 0, fieldSize);
+          const auto count = std::min(fieldSize, remaining);
+          std::memcpy(field, source, count);
+          source += count;
+          remaining -= count;
+        });
+      });
+    }
+  }
+
+  size_t EventJournal::dump(const string& filePath) const {
+    const auto endTicket = writeTicket_.load(std::memory_order_acquire);
+    const auto firstTicket = firstTicket_.load(std::memory_order_relaxed);
+    const auto beginTicket = endTicket - firstTicket > capacity() ? endTicket - capacity() : firstTicket;
+    vector<EventJournalRecord> records;
+    records.reserve(endTicket - beginTicket);
+    for (auto ticket = beginTicket; ticket < endTicket; ticket++) {
+      const auto& slot = slots_[ticket & capacityMask_];
+      const auto sequenceBefore = slot.sequence.load(std::memory_order_acquire);
+      if (sequenceBefore != 2 * ticket + 2) {
+        // Still being written or already overwritten
+        continue;
+      }
+      auto r = slot.record;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != sequenceBefore) {
+        continue;
+      }
+      if (r.kind == EventJournalRecordKind::IncomingSysExData) {
+        // Carries payload instead of a track
+        records.push_back(r);
+        continue;
+      }
+      // Pointers are meaningless outside of this session
+      const auto track = (MediaTrack*) (uintptr_t) r.track;
+      if (track != nullptr && reaper::ValidatePtr2(nullptr, (void*) track, "MediaTrack*")) {
+        r.track = (uint64_t) reaper::CSurf_TrackToID(track, false) + 1;
+      } else {
+        r.track = 0;
+      }
+      records.push_back(r);
+    }
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("couldn't open event journal file for writing");
+    }
+    JournalFileHeader header{};
+    std::memcpy(header.magic, JOURNAL_FILE_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_FILE_VERSION;
+    header.recordSize = sizeof(EventJournalRecord);
+    header.recordCount = records.size();
+    file.write((const char*) &header, sizeof(header));
+    file.write((const char*) records.data(), records.size() * sizeof(EventJournalRecord));
+    if (!file) {
+      throw std::runtime_error("couldn't write event journal file");
+    }
+    return records.size();
+  }
+
+  vector<EventJournalRecord> EventJournal::load(const string& filePath) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("couldn't open event journal file for reading");
+    }
+    JournalFileHeader header{};
+    file.read((char*) &header, sizeof(header));
+    if (!file || std::memcmp(header.magic, JOURNAL_FILE_MAGIC, sizeof(header.magic)) != 0
+        || header.version == 0 || header.version > JOURNAL_FILE_VERSION
+        || header.recordSize != sizeof(EventJournalRecord)) {
+      throw std::runtime_error("not a compatible event journal file");
+    }
+    vector<EventJournalRecord> records(header.recordCount);
+    file.read((char*) records.data(), records.size() * sizeof(EventJournalRecord));
+    if (!file) {
+      throw std::runtime_error("event journal file is truncated");
+    }
+    return records;
+  }
+
+  MediaTrack* EventJournal::resolveTrack(const EventJournalRecord& record) {
+    if (record.track == 0) {
+      return nullptr;
+    }
+    return reaper::CSurf_TrackFromID((int) (record.track - 1), false);
+  }
+
+  bool EventJournal::replayControlSurfaceRecord(const EventJournalRecord& record,
+      IReaperControlSurface& controlSurface) {
+    const auto track = resolveTrack(record);
+    if (record.track != 0 && track == nullptr) {
+      return false;
+    }
+    switch (record.kind) {
+      case EventJournalRecordKind::SetSurfaceVolume:
+        controlSurface.SetSurfaceVolume(track, record.double1);
+        return true;
+      case EventJournalRecordKind::SetSurfacePan:
+        controlSurface.SetSurfacePan(track, record.double1);
+        return true;
+      case EventJournalRecordKind::SetSurfaceMute:
+        controlSurface.SetSurfaceMute(track, record.int1 != 0);
+        return true;
+      case EventJournalRecordKind::SetSurfaceSelected:
+        controlSurface.SetSurfaceSelected(track, record.int1 != 0);
+        return true;
+      case EventJournalRecordKind::SetSurfaceSolo:
+        controlSurface.SetSurfaceSolo(track, record.int1 != 0);
+        return true;
+      case EventJournalRecordKind::SetSurfaceRecArm:
+        controlSurface.SetSurfaceRecArm(track, record.int1 != 0);
+        return true;
+      case EventJournalRecordKind::SetTrackTitle:
+        // The title itself is not recorded
+        controlSurface.SetTrackTitle(track, "");
+        return true;
+      case EventJournalRecordKind::SetTrackListChange:
+        controlSurface.SetTrackListChange();
+        return true;
+      case EventJournalRecordKind::SetAutoMode:
+        controlSurface.SetAutoMode(record.int1);
+        return true;
+      case EventJournalRecordKind::Extended:
+        break;
+      default:
+        return false;
+    }
+    // Extended: Reconstruct parameters
+    const int call = record.int1;
+    const bool parm1Present = (record.flags & PARM1_PRESENT) != 0;
+    const bool parm2Present = (record.flags & PARM2_PRESENT) != 0;
+    const bool parm3Present = (record.flags & PARM3_PRESENT) != 0;
+    int intValue = record.int2;
+    int mediaItemIndex = (int) record.data;
+    double double1 = record.double1;
+    double double2 = record.double2;
+    // Non-null dummy for boolean pointer parameters
+    void* const truePointer = (void*) 1;
+    switch (call) {
+      case CSURF_EXT_SETINPUTMONITOR:
+        controlSurface.Extended(call, track, parm2Present ? &intValue : nullptr, nullptr);
+        return true;
+      case CSURF_EXT_SETFXPARAM:
+      case CSURF_EXT_SETFXPARAM_RECFX:
+      case CSURF_EXT_SETSENDVOLUME:
+      case CSURF_EXT_SETSENDPAN:
+        controlSurface.Extended(call, track, parm2Present ? &intValue : nullptr, parm3Present ? &double1 : nullptr);
+        return true;
+      case CSURF_EXT_SETFXENABLED:
+      case CSURF_EXT_SETFXOPEN:
+        controlSurface.Extended(call, track, parm2Present ? &intValue : nullptr, parm3Present ? truePointer : nullptr);
+        return true;
+      case CSURF_EXT_SETLASTTOUCHEDFX:
+      case CSURF_EXT_SETFOCUSEDFX:
+        controlSurface.Extended(call, track, parm2Present ? &mediaItemIndex : nullptr,
+            parm3Present ? &intValue : nullptr);
+        return true;
+      case CSURF_EXT_SETFXCHANGE:
+        controlSurface.Extended(call, track, (void*) (intptr_t) intValue, nullptr);
+        return true;
+      case CSURF_EXT_SETLASTTOUCHEDTRACK:
+      case CSURF_EXT_SETMIXERSCROLL:
+        controlSurface.Extended(call, track, nullptr, nullptr);
+        return true;
+      case CSURF_EXT_SETBPMANDPLAYRATE:
+        controlSurface.Extended(call, parm1Present ? &double1 : nullptr, parm2Present ? &double2 : nullptr, nullptr);
+        return true;
+      default:
+        if (parm1Present || parm2Present || parm3Present) {
+          // Parameters unknown
+          return false;
+        }
+        controlSurface.Extended(call, nullptr, nullptr, nullptr);
+        return true;
+    }
+  }
+
+  size_t EventJournal::copySysExData(const EventJournalRecord& record, unsigned char* sysExData, size_t sysExSize) {
+    if (record.kind != EventJournalRecordKind::IncomingSysExData || record.int2 < 0
+        || (size_t) record.int2 >= sysExSize) {
+      return 0;
+    }
+    auto destination = sysExData + record.int2;
+    auto remaining = std::min(SYSEX_BYTES_PER_RECORD, sysExSize - (size_t) record.int2);
+    const auto copiedCount = remaining;
+    forEachPayloadField(record, [&](const void* field, size_t fieldSize) {
+      const auto count = std::min(fieldSize, remaining);
+      std::memcpy(destination, field, count);
+      destination += count;
+      remaining -= count;
+    });
+    return copiedCount;
+  }
+}
@@ -7,6 +7,8 @@
 #include <reaper_plugin_functions.h>
 
 #include <reaplus/utility.h>
+#include <reaplus/util/Tracing.h>
+#include <reaplus/util/ApiCallAccounting.h>
 
 using rxcpp::subscriber;
 using rxcpp::observable;
@@ -19,6 +21,7 @@ using std::string;
 namespace reaplus {
 
   int Fx::index() const {
+    REAPLUS_API_CALL_SCOPE("Fx::index");
     if (!isLoadedAndAtCorrectIndex()) {
       loadByGuid();
     }
@@ -30,6 +33,7 @@ namespace reaplus {
   }
 
   string Fx::name() const {
+    REAPLUS_API_CALL_SCOPE("Fx::name");
     loadIfNecessaryOrComplain();
     return reaplus::toString(256, [this](char* buffer, int maxSize) {
       reaper::TrackFX_GetFXName(track_.mediaTrack(), queryIndex(), buffer, maxSize);
@@ -188,6 +192,8 @@ namespace reaplus {
   }
 
   bool Fx::loadByGuid() const {
+    REAPLUS_TRACE_SPAN("Fx::loadByGuid");
+    REAPLUS_API_CALL_SCOPE("Fx::loadByGuid");
     if (!chain().isAvailable()) {
       return false;
     }
@@ -225,6 +231,7 @@ namespace reaplus {
   }
 
   ChunkRegion Fx::chunk() const {
+    REAPLUS_TRACE_SPAN("Fx::chunk");
     loadIfNecessaryOrComplain();
     return chain().chunk()
         ->findLineStartingWith(fxIdLine())
@@ -246,6 +253,7 @@ namespace reaplus {
   }
 
   FxInfo Fx::getFxInfo() const {
+    REAPLUS_TRACE_SPAN("Fx::getFxInfo");
     return FxInfo(tagChunk().firstLine().content().to_string());
   }
   std::string FxInfo::getEffectName() const {
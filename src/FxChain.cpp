@@ -1,5 +1,6 @@
 #include <reaplus/FxChain.h>
 #include <reaplus/Fx.h>
+#include <reaplus/util/Tracing.h>
 #include <reaper_plugin_functions.h>
 #include <utility>
 using rxcpp::observable;
@@ -175,6 +176,7 @@ DOCKED 0
   }
 
   optional<ChunkRegion> FxChain::findChunkRegion(Chunk trackChunk) const {
+    REAPLUS_TRACE_SPAN("FxChain::findChunkRegion");
     return trackChunk.region().findFirstTagNamed(0, chunkTagName());
   }
 
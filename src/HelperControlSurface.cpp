@@ -1,5 +1,8 @@
 #include <reaplus/HelperControlSurface.h>
 #include <utility>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
 #include <reaplus/TrackSend.h>
 #include <reaplus/Reaper.h>
 #include <reaplus/TrackVolume.h>
@@ -16,6 +19,7 @@
 #include <reaper_plugin_functions.h>
 #include <reaplus/utility.h>
 #include <reaplus/util/log.h>
+#include <reaplus/util/Tracing.h>
 
 using std::unique_lock;
 namespace rx = rxcpp;
@@ -29,12 +33,50 @@ using std::unique_ptr;
 using boost::none;
 using reaplus::util::logException;
 
+namespace {
+  bool guidIsLess(const GUID& lhs, const GUID& rhs) {
+    return std::memcmp(&lhs, &rhs, sizeof(GUID)) < 0;
+  }
+
+  bool guidsAreEqual(const GUID& lhs, const GUID& rhs) {
+    return std::memcmp(&lhs, &rhs, sizeof(GUID)) == 0;
+  }
+
+  // Marks the elements of one longest strictly increasing subsequence of the given distinct values. O(n log n).
+  std::vector<bool> markLongestIncreasingSubsequence(const std::vector<int>& values) {
+    // tailIndexes[k] = index of the smallest value which ends an increasing subsequence of length k + 1
+    std::vector<int> tailIndexes;
+    std::vector<int> predecessorIndexes(values.size(), -1);
+    for (int i = 0; i < (int) values.size(); i++) {
+      const auto tail = std::lower_bound(tailIndexes.begin(), tailIndexes.end(), values[i],
+          [&values](int index, int value) {
+            return values[index] < value;
+          });
+      if (tail != tailIndexes.begin()) {
+        predecessorIndexes[i] = *(tail - 1);
+      }
+      if (tail == tailIndexes.end()) {
+        tailIndexes.push_back(i);
+      } else {
+        *tail = i;
+      }
+    }
+    std::vector<bool> isMember(values.size(), false);
+    for (int i = tailIndexes.empty() ? -1 : tailIndexes.back(); i != -1; i = predecessorIndexes[i]) {
+      isMember[i] = true;
+    }
+    return isMember;
+  }
+}
+
 namespace reaplus {
   std::unique_ptr<HelperControlSurface> HelperControlSurface::INSTANCE = nullptr;
 
   HelperControlSurface::HelperControlSurface() :
-      activeProjectBehavior_(Reaper::instance().currentProject()),
-      fastCommandQueue_(1000) {
+      activeProjectBehavior_(Reaper::instance().currentProject()) {
+    mainThreadScheduler_.setExternalSource(MainThreadTaskPriority::Ui, [this] {
+      return mainThreadRunLoop_.dispatch_ready();
+    });
     // Detect features
     const string reaperVersion = reaper::GetAppVersion();
     supportsDetectionOfInputFx_ = reaperVersion >= "5.95"; // since pre1
@@ -69,8 +111,16 @@ namespace reaplus {
     return subscription;
   }
 
-  void HelperControlSurface::enqueueCommandFast(std::function<void(void)> command) {
-    fastCommandQueue_.enqueue(std::move(command));
+  void HelperControlSurface::enqueueCommandFast(util::InplaceTask command, MainThreadTaskPriority priority) {
+    mainThreadScheduler_.schedule(priority, std::move(command));
+  }
+
+  MainThreadScheduler& HelperControlSurface::mainThreadScheduler() {
+    return mainThreadScheduler_;
+  }
+
+  MainThreadProfiler& HelperControlSurface::mainThreadProfiler() {
+    return mainThreadProfiler_;
   }
 
   const char* HelperControlSurface::GetTypeString() {
@@ -87,21 +137,28 @@ namespace reaplus {
 
   void HelperControlSurface::Run() {
     try {
+      mainThreadProfiler_.onMainLoopCycle();
+      const auto profiledSection = mainThreadProfiler_.profile("Run");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::Run");
+      const auto runStartTime = MainThreadScheduler::Clock::now();
       // Invoke custom idle code
       mainThreadIdleSubject_.get_subscriber().on_next(true);
-      // Process items from fast queue
-      const auto count = fastCommandQueue_.try_dequeue_bulk(fastCommandBuffer_.begin(), FAST_COMMAND_BUFFER_SIZE);
-      for (auto i = 0; i < count; i++) {
-        fastCommandBuffer_.at(i)();
-      }
-      // Process items from slow queue
-      const auto fixedNow = mainThreadRunLoop_.now();
-      const auto maxExecutionTime = std::chrono::milliseconds(50);
-      while (mainThreadRunLoop_.now() - fixedNow <= maxExecutionTime
-          && !mainThreadRunLoop_.empty()
-          && mainThreadRunLoop_.peek().when <= fixedNow) {
-        mainThreadRunLoop_.dispatch();
+      // Envelopes can also appear or disappear without any notification (e.g. via state chunks, FX changes or
+      // actions), so the cached automation state must not outlive one main loop cycle
+      invalidateAutomationStates();
+      // Notice connected or disconnected MIDI devices (there's no reliable notification for that)
+      if (++runCyclesSinceMidiDeviceRefresh_ >= MIDI_DEVICE_REFRESH_INTERVAL_IN_RUN_CYCLES) {
+        runCyclesSinceMidiDeviceRefresh_ = 0;
+        Reaper::instance().refreshOpenMidiDevices();
       }
+      // Emit MIDI events passed from the audio thread
+      Reaper::instance().processIncomingMidiEventsInMainThread();
+      // Process fast commands and items from slow queue (only those which are due already)
+      mainThreadRunLoop_.advance(mainThreadRunLoop_.now());
+      mainThreadScheduler_.runTick(runStartTime);
+      mainThreadRunLoop_.collect_garbage();
+      // The audio thread doesn't free executed items itself
+      Reaper::instance().audioThreadRunLoop_.collect_garbage();
     } catch (...) {
       logException();
     }
@@ -109,14 +166,25 @@ namespace reaplus {
 
   void HelperControlSurface::SetSurfaceVolume(MediaTrack* trackid, double volume) {
     try {
+      const auto profiledSection = mainThreadProfiler_.profile("SetSurfaceVolume");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::SetSurfaceVolume");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->record(EventJournalRecordKind::SetSurfaceVolume, trackid, 0, 0, volume);
+      }
       if (state() != State::PropagatingTrackSetChanges) {
         if (auto td = findTrackDataByTrack(trackid)) {
           if (td->volume != volume) {
             td->volume = volume;
+            if (!listenerMask_.hasListeners(EventKind::TrackVolumeChanged, EventKind::TrackVolumeTouched)) {
+              return;
+            }
             Track track(trackid, nullptr);
             trackVolumeChangedSubject_.get_subscriber().on_next(track);
-            if (!trackParameterIsAutomated(track, "Volume")) {
+            trackVolumeChangedByMediaTrack_.next(trackid, track);
+            if (listenerMask_.hasListeners(EventKind::TrackVolumeTouched)
+                && !trackParameterIsAutomated(trackid, *td, TrackEnvelopeType::Volume)) {
               trackVolumeTouchedSubject_.get_subscriber().on_next(track);
+              trackVolumeTouchedByMediaTrack_.next(trackid, track);
             }
           }
         }
@@ -128,14 +196,25 @@ namespace reaplus {
 
   void HelperControlSurface::SetSurfacePan(MediaTrack* trackid, double pan) {
     try {
+      const auto profiledSection = mainThreadProfiler_.profile("SetSurfacePan");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::SetSurfacePan");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->record(EventJournalRecordKind::SetSurfacePan, trackid, 0, 0, pan);
+      }
       if (state() != State::PropagatingTrackSetChanges) {
         if (auto td = findTrackDataByTrack(trackid)) {
           if (td->pan != pan) {
             td->pan = pan;
+            if (!listenerMask_.hasListeners(EventKind::TrackPanChanged, EventKind::TrackPanTouched)) {
+              return;
+            }
             Track track(trackid, nullptr);
             trackPanChangedSubject_.get_subscriber().on_next(track);
-            if (!trackParameterIsAutomated(track, "Pan")) {
+            trackPanChangedByMediaTrack_.next(trackid, track);
+            if (listenerMask_.hasListeners(EventKind::TrackPanTouched)
+                && !trackParameterIsAutomated(trackid, *td, TrackEnvelopeType::Pan)) {
               trackPanTouchedSubject_.get_subscriber().on_next(track);
+              trackPanTouchedByMediaTrack_.next(trackid, track);
             }
           }
         }
@@ -164,14 +243,19 @@ namespace reaplus {
   }
 
   rx::observable<FxParameter> HelperControlSurface::fxParameterValueChanged() const {
-    return fxParameterValueChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::FxParameterValueChanged, fxParameterValueChangedSubject_.get_observable());
   }
 
   void HelperControlSurface::SetTrackTitle(MediaTrack* trackid, const char*) {
     try {
+      const auto profiledSection = mainThreadProfiler_.profile("SetTrackTitle");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::SetTrackTitle");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->record(EventJournalRecordKind::SetTrackTitle, trackid);
+      }
       if (state() == State::PropagatingTrackSetChanges) {
         numTrackSetChangesLeftToBePropagated_--;
-      } else {
+      } else if (listenerMask_.hasListeners(EventKind::TrackNameChanged)) {
         trackNameChangedSubject_.get_subscriber().on_next(Track(trackid, nullptr));
       }
     } catch (...) {
@@ -180,7 +264,7 @@ namespace reaplus {
   }
 
   rxcpp::observable<Fx> HelperControlSurface::fxEnabledChanged() const {
-    return fxEnabledChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::FxEnabledChanged, fxEnabledChangedSubject_.get_observable());
   }
 
   rxcpp::observable<Fx> HelperControlSurface::fxEnabledTouched() const {
@@ -200,6 +284,11 @@ namespace reaplus {
 
   int HelperControlSurface::Extended(int call, void* parm1, void* parm2, void* parm3) {
     try {
+      const auto profiledSection = mainThreadProfiler_.profile("Extended");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::Extended");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->recordExtended(call, parm1, parm2, parm3);
+      }
       switch (call) {
         // DONE-rust
         case CSURF_EXT_SETINPUTMONITOR: {
@@ -210,14 +299,18 @@ namespace reaplus {
                 const auto recmonitor = (int*) parm2;
                 if (td->recmonitor != *recmonitor) {
                   td->recmonitor = *recmonitor;
-                  trackInputMonitoringChangedSubject_.get_subscriber().on_next(Track(mediaTrack, nullptr));
+                  if (listenerMask_.hasListeners(EventKind::TrackInputMonitoringChanged)) {
+                    trackInputMonitoringChangedSubject_.get_subscriber().on_next(Track(mediaTrack, nullptr));
+                  }
                 }
               }
               {
                 const auto recinput = (int) reaper::GetMediaTrackInfo_Value(mediaTrack, "I_RECINPUT");
                 if (td->recinput != recinput) {
                   td->recinput = recinput;
-                  trackInputChangedSubject_.get_subscriber().on_next(Track(mediaTrack, nullptr));
+                  if (listenerMask_.hasListeners(EventKind::TrackInputChanged)) {
+                    trackInputChangedSubject_.get_subscriber().on_next(Track(mediaTrack, nullptr));
+                  }
                 }
               }
             }
@@ -242,7 +335,7 @@ namespace reaplus {
         }
         // DONE-rust
         case CSURF_EXT_SETFXENABLED: {
-          if (!parm1 || !parm2) {
+          if (!parm1 || !parm2 || !listenerMask_.hasListeners(EventKind::FxEnabledChanged)) {
             return 0;
           }
           const auto mediaTrack = (MediaTrack*) parm1;
@@ -257,20 +350,30 @@ namespace reaplus {
         // DONE-rust
         case CSURF_EXT_SETSENDVOLUME:
         case CSURF_EXT_SETSENDPAN: {
+          const auto isVolume = call == CSURF_EXT_SETSENDVOLUME;
+          const auto hasListeners = isVolume
+              ? listenerMask_.hasListeners(EventKind::TrackSendVolumeChanged, EventKind::TrackSendVolumeTouched)
+              : listenerMask_.hasListeners(EventKind::TrackSendPanChanged, EventKind::TrackSendPanTouched);
+          if (!hasListeners) {
+            return 0;
+          }
           const auto mediaTrack = (MediaTrack*) parm1;
           const int sendIdx = *(int*) parm2;
           const Track track(mediaTrack, nullptr);
           const auto trackSend = track.indexBasedSendByIndex(sendIdx);
-          if (call == CSURF_EXT_SETSENDVOLUME) {
+          const auto td = findTrackDataByTrack(mediaTrack);
+          if (isVolume) {
             trackSendVolumeChangedSubject_.get_subscriber().on_next(trackSend);
             // Send volume touch event only if not automated
-            if (!trackParameterIsAutomated(track, "Send Volume")) {
+            if (listenerMask_.hasListeners(EventKind::TrackSendVolumeTouched)
+                && (!td || !trackParameterIsAutomated(mediaTrack, *td, TrackEnvelopeType::SendVolume))) {
               trackSendVolumeTouchedSubject_.get_subscriber().on_next(trackSend);
             }
-          } else if (call == CSURF_EXT_SETSENDPAN) {
+          } else {
             trackSendPanChangedSubject_.get_subscriber().on_next(trackSend);
             // Send pan touch event only if not automated
-            if (!trackParameterIsAutomated(track, "Send Pan")) {
+            if (listenerMask_.hasListeners(EventKind::TrackSendPanTouched)
+                && (!td || !trackParameterIsAutomated(mediaTrack, *td, TrackEnvelopeType::SendPan))) {
               trackSendPanTouchedSubject_.get_subscriber().on_next(trackSend);
             }
           }
@@ -334,6 +437,12 @@ namespace reaplus {
         case CSURF_EXT_SETLASTTOUCHEDFX: {
           fxHasBeenTouchedJustAMomentAgo_ = true;
           return 0;
+        }
+        case CSURF_EXT_RESET: {
+          // Sent e.g. after changing MIDI device preferences
+          Reaper::instance().refreshOpenMidiDevices();
+          runCyclesSinceMidiDeviceRefresh_ = 0;
+          return 0;
         }
           // DONE-rust
         case CSURF_EXT_SETBPMANDPLAYRATE: {
@@ -362,23 +471,61 @@ namespace reaplus {
     const auto fxAndParamIndex = *static_cast<int*>(parm2);
     const int fxIndex = (fxAndParamIndex >> 16) & 0xffff;
     const int paramIndex = fxAndParamIndex & 0xffff;
-    // Unfortunately, we don't have a ReaProject* here. Therefore we pass a nullptr.
-    const Track track(mediaTrack, nullptr);
     const double paramValue = *(double*) parm3;
+    if (!listenerMask_.hasListeners(EventKind::FxParameterValueChanged, EventKind::FxParameterTouched)) {
+      fxHasBeenTouchedJustAMomentAgo_ = false;
+      return;
+    }
+    // Fast path: Emit prebuilt handles without any REAPER API call if possible
     const bool isInputFx = supportsDetectionOfInputFx_
                            ? isInputFxIfSupported
-                           : isProbablyInputFx(track, fxIndex, paramIndex, paramValue);
-    const auto fxChain = isInputFx ? track.inputFxChain() : track.normalFxChain();
-    if (const auto fx = fxChain.fxByIndex(fxIndex)) {
-      const auto fxParam = fx->parameterByIndex(paramIndex);
+                           // Unfortunately, we don't have a ReaProject* here. Therefore we pass a nullptr.
+                           : isProbablyInputFx(Track(mediaTrack, nullptr), fxIndex, paramIndex, paramValue);
+    if (const auto cachedFxParam = findOrCreateCachedFxParameter(mediaTrack, isInputFx, fxIndex, paramIndex)) {
+      const auto& fxParam = cachedFxParam->parameter;
       fxParameterValueChangedSubject_.get_subscriber().on_next(fxParam);
+      fxParameterValueChangedByKey_.next(cachedFxParam->key, fxParam);
       if (fxHasBeenTouchedJustAMomentAgo_) {
         fxHasBeenTouchedJustAMomentAgo_ = false;
         fxParameterTouchedSubject_.get_subscriber().on_next(fxParam);
+        fxParameterTouchedByKey_.next(cachedFxParam->key, fxParam);
       }
     }
   }
 
+  std::shared_ptr<const CachedFxParameter> HelperControlSurface::findOrCreateCachedFxParameter(
+      MediaTrack* mediaTrack, bool isInputFx, int fxIndex, int paramIndex) {
+    auto& fxHandleCache = fxHandleCacheByMediaTrack_[mediaTrack];
+    auto& entries = isInputFx ? fxHandleCache.inputFxs : fxHandleCache.normalFxs;
+    if (fxIndex >= (int) entries.size()) {
+      entries.resize(fxIndex + 1);
+    }
+    auto& entry = entries[fxIndex];
+    if (!entry) {
+      // Unfortunately, we don't have a ReaProject* here. Therefore we pass a nullptr.
+      const Track track(mediaTrack, nullptr);
+      const auto fxChain = isInputFx ? track.inputFxChain() : track.normalFxChain();
+      const auto fx = fxChain.fxByIndex(fxIndex);
+      if (!fx) {
+        return nullptr;
+      }
+      entry = FxHandleCache::Entry{*fx, {}};
+    }
+    auto& parameters = entry->parameters;
+    if (paramIndex >= (int) parameters.size()) {
+      parameters.resize(paramIndex + 1);
+    }
+    auto& parameter = parameters[paramIndex];
+    if (!parameter) {
+      parameter = std::make_shared<const CachedFxParameter>(CachedFxParameter{
+          entry->fx.parameterByIndex(paramIndex),
+          FxParameterKey{mediaTrack, entry->fx.guid(), paramIndex}
+      });
+    }
+    // Returned as shared pointer because observers might trigger an invalidation while we are still emitting
+    return parameter;
+  }
+
   rxcpp::observable<bool> HelperControlSurface::masterTempoChanged() const {
     return masterTempoChangedSubject_.get_observable();
   }
@@ -396,23 +543,24 @@ namespace reaplus {
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackInputMonitoringChanged() const {
-    return trackInputMonitoringChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackInputMonitoringChanged,
+        trackInputMonitoringChangedSubject_.get_observable());
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackArmChanged() const {
-    return trackArmChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackArmChanged, trackArmChangedSubject_.get_observable());
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackMuteChanged() const {
-    return trackMuteChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackMuteChanged, trackMuteChangedSubject_.get_observable());
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackMuteTouched() const {
-    return trackMuteTouchedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackMuteTouched, trackMuteTouchedSubject_.get_observable());
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackSoloChanged() const {
-    return trackSoloChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackSoloChanged, trackSoloChangedSubject_.get_observable());
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackSoloTouched() const {
@@ -421,7 +569,7 @@ namespace reaplus {
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackSelectedChanged() const {
-    return trackSelectedChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackSelectedChanged, trackSelectedChangedSubject_.get_observable());
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackSelectedTouched() const {
@@ -440,12 +588,19 @@ namespace reaplus {
 
   void HelperControlSurface::SetTrackListChange() {
     try {
+      const auto profiledSection = mainThreadProfiler_.profile("SetTrackListChange");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::SetTrackListChange");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->record(EventJournalRecordKind::SetTrackListChange, nullptr);
+      }
       // FIXME Not multi-project compatible!
       const auto newActiveProject = Reaper::instance().currentProject();
       if (newActiveProject != activeProjectBehavior_.get_value()) {
         activeProjectBehavior_.get_subscriber().on_next(newActiveProject);
       }
       numTrackSetChangesLeftToBePropagated_ = reaper::CountTracks(nullptr) + 1;
+      // Envelopes might have been added or removed
+      invalidateAutomationStates();
       removeInvalidReaProjects();
       detectTrackSetChanges();
     } catch (...) {
@@ -492,7 +647,7 @@ namespace reaplus {
             detectFxChangesOnTrack(track, false, true, true);
           }
         },
-        util::getLoggingErrorHandler()
+        util::makeLoggingErrorHandler("HelperControlSurface::addMissingMediaTracks")
     );
   }
 
@@ -528,14 +683,25 @@ namespace reaplus {
 
   void HelperControlSurface::SetSurfaceMute(MediaTrack* trackid, bool mute) {
     try {
+      const auto profiledSection = mainThreadProfiler_.profile("SetSurfaceMute");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::SetSurfaceMute");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->record(EventJournalRecordKind::SetSurfaceMute, trackid, mute);
+      }
       if (state() != State::PropagatingTrackSetChanges) {
         if (auto td = findTrackDataByTrack(trackid)) {
           if (td->mute != mute) {
             td->mute = mute;
+            if (!listenerMask_.hasListeners(EventKind::TrackMuteChanged, EventKind::TrackMuteTouched)) {
+              return;
+            }
             Track track(trackid, nullptr);
             trackMuteChangedSubject_.get_subscriber().on_next(track);
-            if (!trackParameterIsAutomated(track, "Mute")) {
+            trackMuteChangedByMediaTrack_.next(trackid, track);
+            if (listenerMask_.hasListeners(EventKind::TrackMuteTouched)
+                && !trackParameterIsAutomated(trackid, *td, TrackEnvelopeType::Mute)) {
               trackMuteTouchedSubject_.get_subscriber().on_next(track);
+              trackMuteTouchedByMediaTrack_.next(trackid, track);
             }
           }
         }
@@ -547,12 +713,21 @@ namespace reaplus {
 
   void HelperControlSurface::SetSurfaceSelected(MediaTrack* trackid, bool selected) {
     try {
+      const auto profiledSection = mainThreadProfiler_.profile("SetSurfaceSelected");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::SetSurfaceSelected");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->record(EventJournalRecordKind::SetSurfaceSelected, trackid, selected);
+      }
       if (state() != State::PropagatingTrackSetChanges) {
         if (auto td = findTrackDataByTrack(trackid)) {
           if (td->selected != selected) {
             td->selected = selected;
+            if (!listenerMask_.hasListeners(EventKind::TrackSelectedChanged)) {
+              return;
+            }
             Track track(trackid, nullptr);
             trackSelectedChangedSubject_.get_subscriber().on_next(track);
+            trackSelectedChangedByMediaTrack_.next(trackid, track);
           }
         }
       }
@@ -563,12 +738,21 @@ namespace reaplus {
 
   void HelperControlSurface::SetSurfaceSolo(MediaTrack* trackid, bool solo) {
     try {
+      const auto profiledSection = mainThreadProfiler_.profile("SetSurfaceSolo");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::SetSurfaceSolo");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->record(EventJournalRecordKind::SetSurfaceSolo, trackid, solo);
+      }
       if (state() != State::PropagatingTrackSetChanges) {
         if (auto td = findTrackDataByTrack(trackid)) {
           if (td->solo != solo) {
             td->solo = solo;
+            if (!listenerMask_.hasListeners(EventKind::TrackSoloChanged)) {
+              return;
+            }
             Track track(trackid, nullptr);
             trackSoloChangedSubject_.get_subscriber().on_next(track);
+            trackSoloChangedByMediaTrack_.next(trackid, track);
           }
         }
       }
@@ -579,12 +763,21 @@ namespace reaplus {
 
   void HelperControlSurface::SetSurfaceRecArm(MediaTrack* trackid, bool recarm) {
     try {
+      const auto profiledSection = mainThreadProfiler_.profile("SetSurfaceRecArm");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::SetSurfaceRecArm");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->record(EventJournalRecordKind::SetSurfaceRecArm, trackid, recarm);
+      }
       if (state() != State::PropagatingTrackSetChanges) {
         if (auto td = findTrackDataByTrack(trackid)) {
           if (td->recarm != recarm) {
             td->recarm = recarm;
+            if (!listenerMask_.hasListeners(EventKind::TrackArmChanged)) {
+              return;
+            }
             Track track(trackid, nullptr);
             trackArmChangedSubject_.get_subscriber().on_next(track);
+            trackArmChangedByMediaTrack_.next(trackid, track);
           }
         }
       }
@@ -593,6 +786,20 @@ namespace reaplus {
     }
   }
 
+  void HelperControlSurface::SetAutoMode(int mode) {
+    try {
+      const auto profiledSection = mainThreadProfiler_.profile("SetAutoMode");
+      REAPLUS_TRACE_SPAN("HelperControlSurface::SetAutoMode");
+      if (auto journal = Reaper::instance().activeEventJournal()) {
+        journal->record(EventJournalRecordKind::SetAutoMode, nullptr, mode);
+      }
+      // We don't know for which track(s) the automation mode has changed (it might also be the global override)
+      invalidateAutomationStates();
+    } catch (...) {
+      logException();
+    }
+  }
+
   void HelperControlSurface::removeInvalidMediaTracks(const Project& project, TrackDataMap& trackDatas) {
     for (auto it = trackDatas.begin(); it != trackDatas.end();) {
       const auto mediaTrack = it->first;
@@ -601,8 +808,10 @@ namespace reaplus {
         it++;
       } else {
         fxChainPairByMediaTrack_.erase(mediaTrack);
+        fxHandleCacheByMediaTrack_.erase(mediaTrack);
         trackRemovedSubject_.get_subscriber().on_next(project.trackByGuid(trackData.guid));
         it = trackDatas.erase(it);
+        completeKeyedSubjects(mediaTrack);
       }
     }
   }
@@ -615,6 +824,10 @@ namespace reaplus {
         it++;
       } else {
         projectClosedSubject_.get_subscriber().on_next(Project(project));
+        for (const auto& trackDataPair : pair.second) {
+          fxHandleCacheByMediaTrack_.erase(trackDataPair.first);
+          completeKeyedSubjects(trackDataPair.first);
+        }
         it = trackDataByMediaTrackByReaProject_.erase(it);
       }
     }
@@ -629,31 +842,31 @@ namespace reaplus {
   }
 
   rx::observable<Track> HelperControlSurface::trackVolumeChanged() const {
-    return trackVolumeChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackVolumeChanged, trackVolumeChangedSubject_.get_observable());
   }
 
   rx::observable<Track> HelperControlSurface::trackPanChanged() const {
-    return trackPanChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackPanChanged, trackPanChangedSubject_.get_observable());
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackNameChanged() const {
-    return trackNameChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackNameChanged, trackNameChangedSubject_.get_observable());
   }
 
   rxcpp::observable<Track> HelperControlSurface::trackInputChanged() const {
-    return trackInputChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackInputChanged, trackInputChangedSubject_.get_observable());
   }
 
   rx::observable<TrackSend> HelperControlSurface::trackSendVolumeChanged() const {
-    return trackSendVolumeChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackSendVolumeChanged, trackSendVolumeChangedSubject_.get_observable());
   }
 
   rxcpp::observable<TrackSend> HelperControlSurface::trackSendPanChanged() const {
-    return trackSendPanChangedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackSendPanChanged, trackSendPanChangedSubject_.get_observable());
   }
 
   rxcpp::observable<TrackSend> HelperControlSurface::trackSendPanTouched() const {
-    return trackSendPanTouchedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackSendPanTouched, trackSendPanTouchedSubject_.get_observable());
   }
 
   const rxcpp::observe_on_one_worker& HelperControlSurface::mainThreadCoordination() const {
@@ -667,6 +880,10 @@ namespace reaplus {
   rx::observable<Track> HelperControlSurface::fxReordered() const {
     return fxReorderedSubject_.get_observable();
   }
+
+  rxcpp::observable<Fx> HelperControlSurface::fxMoved() const {
+    return fxMovedSubject_.get_observable();
+  }
   rxcpp::observable<Fx> HelperControlSurface::fxOpened() const {
     return fxOpenedSubject_.get_observable();
   }
@@ -682,83 +899,117 @@ namespace reaplus {
     if (track.isAvailable()) {
       MediaTrack* mediaTrack = track.mediaTrack();
       auto& fxChainPair = fxChainPairByMediaTrack_[mediaTrack];
-      const bool addedOrRemovedOutputFx =
+      const auto outputFxChanges =
           checkNormalFxChain
           ? detectFxChangesOnTrack(track, fxChainPair.outputFxGuids, false, notifyListenersAboutChanges)
-          : false;
-      const bool addedOrRemovedInputFx =
+          : FxChainChanges();
+      const auto inputFxChanges =
           checkInputFxChain
           ? detectFxChangesOnTrack(track, fxChainPair.inputFxGuids, true, notifyListenersAboutChanges)
-          : false;
-      if (notifyListenersAboutChanges && !addedOrRemovedInputFx && !addedOrRemovedOutputFx) {
+          : FxChainChanges();
+      const bool reordered = outputFxChanges.reordered || inputFxChanges.reordered;
+      if (reordered || outputFxChanges.addedOrRemoved || inputFxChanges.addedOrRemoved) {
+        // FX indexes might have changed
+        fxHandleCacheByMediaTrack_.erase(mediaTrack);
+      }
+      if (notifyListenersAboutChanges && reordered) {
         fxReorderedSubject_.get_subscriber().on_next(track);
       }
     }
   }
 
-  bool HelperControlSurface::detectFxChangesOnTrack(Track track,
-      set<string>& oldFxGuids,
+  HelperControlSurface::FxChainChanges HelperControlSurface::detectFxChangesOnTrack(Track track,
+      FxChainGuids& oldFxGuids,
       bool isInputFx,
       bool notifyListenersAboutChanges) {
-    const auto oldFxCount = (int) oldFxGuids.size();
-    const int newFxCount = (isInputFx ? track.inputFxChain() : track.normalFxChain()).fxCount();
-    if (newFxCount < oldFxCount) {
-      removeInvalidFx(track, oldFxGuids, isInputFx, notifyListenersAboutChanges);
-      return true;
-    } else if (newFxCount > oldFxCount) {
-      addMissingFx(track, oldFxGuids, isInputFx, notifyListenersAboutChanges);
-      return true;
-    } else {
-      // Reordering (or nothing)
-      return false;
+    auto& newFxGuids = currentFxGuidsBuffer_;
+    readFxGuids(track.mediaTrack(), isInputFx, newFxGuids);
+    FxChainChanges changes;
+    if (newFxGuids.size() == oldFxGuids.ordered.size()
+        && std::equal(newFxGuids.begin(), newFxGuids.end(), oldFxGuids.ordered.begin(), guidsAreEqual)) {
+      // Nothing changed (the usual case)
+      return changes;
     }
-  }
-
-  void HelperControlSurface::removeInvalidFx(Track track,
-      std::set<string>& oldFxGuids,
-      bool isInputFx,
-      bool notifyListenersAboutChanges) {
-    const auto newFxGuids = fxGuidsOnTrack(track, isInputFx);
-    for (auto it = oldFxGuids.begin(); it != oldFxGuids.end();) {
-      const string oldFxGuid = *it;
-      if (newFxGuids.count(oldFxGuid)) {
-        it++;
-      } else {
-        if (notifyListenersAboutChanges) {
-          const auto fxChain = isInputFx ? track.inputFxChain() : track.normalFxChain();
-          fxRemovedSubject_.get_subscriber().on_next(fxChain.fxByGuid(oldFxGuid));
-        }
-        it = oldFxGuids.erase(it);
+    auto& newSortedFxGuids = sortedFxGuidsBuffer_;
+    newSortedFxGuids.assign(newFxGuids.begin(), newFxGuids.end());
+    std::sort(newSortedFxGuids.begin(), newSortedFxGuids.end(), guidIsLess);
+    // Merge sorted GUIDs to find out which FX have been added or removed
+    std::vector<GUID> removedFxGuids;
+    std::vector<GUID> addedFxGuids;
+    std::set_difference(oldFxGuids.sorted.begin(), oldFxGuids.sorted.end(),
+        newSortedFxGuids.begin(), newSortedFxGuids.end(), std::back_inserter(removedFxGuids), guidIsLess);
+    std::set_difference(newSortedFxGuids.begin(), newSortedFxGuids.end(),
+        oldFxGuids.sorted.begin(), oldFxGuids.sorted.end(), std::back_inserter(addedFxGuids), guidIsLess);
+    changes.addedOrRemoved = !removedFxGuids.empty() || !addedFxGuids.empty();
+    // Compare the order of FX which have been there before and are still there. The largest group of FX which kept
+    // their relative order (longest increasing subsequence of their old indexes) counts as not moved, all others as
+    // moved. So moving one FX reports exactly that FX.
+    std::vector<std::pair<GUID, int>> oldIndexByGuid;
+    oldIndexByGuid.reserve(oldFxGuids.ordered.size());
+    for (int i = 0; i < (int) oldFxGuids.ordered.size(); i++) {
+      oldIndexByGuid.emplace_back(oldFxGuids.ordered[i], i);
+    }
+    std::sort(oldIndexByGuid.begin(), oldIndexByGuid.end(), [](const auto& lhs, const auto& rhs) {
+      return guidIsLess(lhs.first, rhs.first);
+    });
+    std::vector<std::pair<GUID, int>> addedFxs;
+    std::vector<std::pair<GUID, int>> keptFxs;
+    std::vector<int> oldIndexesOfKeptFxs;
+    for (int i = 0; i < (int) newFxGuids.size(); i++) {
+      const auto& guid = newFxGuids[i];
+      if (std::binary_search(addedFxGuids.begin(), addedFxGuids.end(), guid, guidIsLess)) {
+        addedFxs.emplace_back(guid, i);
+        continue;
       }
+      const auto old = std::lower_bound(oldIndexByGuid.begin(), oldIndexByGuid.end(), guid,
+          [](const auto& entry, const GUID& value) {
+            return guidIsLess(entry.first, value);
+          });
+      keptFxs.emplace_back(guid, i);
+      oldIndexesOfKeptFxs.push_back(old->second);
     }
-  }
-
-  void HelperControlSurface::addMissingFx(Track track,
-      std::set<string>& fxGuids,
-      bool isInputFx,
-      bool notifyListenersAboutChanges) {
+    const auto isNotMoved = markLongestIncreasingSubsequence(oldIndexesOfKeptFxs);
+    std::vector<std::pair<GUID, int>> movedFxs;
+    for (size_t i = 0; i < keptFxs.size(); i++) {
+      if (!isNotMoved[i]) {
+        movedFxs.push_back(keptFxs[i]);
+      }
+    }
+    changes.reordered = !movedFxs.empty();
+    // Update state before emitting because listeners might cause reentrant change detection. The swapped-out vectors
+    // are reused as buffers next time.
+    oldFxGuids.ordered.swap(newFxGuids);
+    oldFxGuids.sorted.swap(newSortedFxGuids);
+    // Emit
     const auto fxChain = isInputFx ? track.inputFxChain() : track.normalFxChain();
-    fxChain.fxs().subscribe(
-        [this, &fxGuids, notifyListenersAboutChanges](Fx fx) {
-          bool wasInserted = fxGuids.insert(fx.guid()).second;
-          if (wasInserted && notifyListenersAboutChanges) {
-            fxAddedSubject_.get_subscriber().on_next(fx);
-          }
-        },
-        util::getLoggingErrorHandler()
-    );
+    for (const auto& guid : removedFxGuids) {
+      const auto guidString = convertGuidToString(guid);
+      if (notifyListenersAboutChanges) {
+        fxRemovedSubject_.get_subscriber().on_next(fxChain.fxByGuid(guidString));
+      }
+      completeKeyedSubjects(guidString);
+    }
+    if (notifyListenersAboutChanges) {
+      for (const auto& pair : addedFxs) {
+        fxAddedSubject_.get_subscriber().on_next(fxChain.fxByGuidAndIndex(convertGuidToString(pair.first), pair.second));
+      }
+      for (const auto& pair : movedFxs) {
+        fxMovedSubject_.get_subscriber().on_next(fxChain.fxByGuidAndIndex(convertGuidToString(pair.first), pair.second));
+      }
+    }
+    return changes;
   }
 
-  std::set<string> HelperControlSurface::fxGuidsOnTrack(Track track, bool isInputFx) const {
-    const auto fxChain = isInputFx ? track.inputFxChain() : track.normalFxChain();
-    std::set<string> fxGuids;
-    fxChain.fxs().subscribe(
-        [&fxGuids](Fx fx) {
-          fxGuids.insert(fx.guid());
-        },
-        util::getLoggingErrorHandler()
-    );
-    return fxGuids;
+  void HelperControlSurface::readFxGuids(MediaTrack* mediaTrack, bool isInputFx, std::vector<GUID>& fxGuids) const {
+    const int fxCount = isInputFx ? reaper::TrackFX_GetRecCount(mediaTrack) : reaper::TrackFX_GetCount(mediaTrack);
+    fxGuids.clear();
+    const int queryIndexOffset = isInputFx ? 0x1000000 : 0;
+    for (int i = 0; i < fxCount; i++) {
+      const GUID* guid = reaper::TrackFX_GetFXGUID(mediaTrack, queryIndexOffset + i);
+      if (guid != nullptr) {
+        fxGuids.push_back(*guid);
+      }
+    }
   }
 
   rx::observable<Fx> HelperControlSurface::fxAdded() const {
@@ -777,8 +1028,8 @@ namespace reaplus {
     const auto mediaTrack = track.mediaTrack();
     if (fxChainPairByMediaTrack_.count(mediaTrack)) {
       const auto& fxChainPair = fxChainPairByMediaTrack_.at(mediaTrack);
-      const bool couldBeInputFx = fxIndex < fxChainPair.inputFxGuids.size();
-      const bool couldBeOutputFx = fxIndex < fxChainPair.outputFxGuids.size();
+      const bool couldBeInputFx = fxIndex < fxChainPair.inputFxGuids.ordered.size();
+      const bool couldBeOutputFx = fxIndex < fxChainPair.outputFxGuids.ordered.size();
       if (!couldBeInputFx && couldBeOutputFx) {
         return false;
       } else if (couldBeInputFx && !couldBeOutputFx) {
@@ -883,15 +1134,15 @@ namespace reaplus {
   }
 
   rx::observable<FxParameter> HelperControlSurface::fxParameterTouched() const {
-    return fxParameterTouchedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::FxParameterTouched, fxParameterTouchedSubject_.get_observable());
   }
 
   rx::observable<Track> HelperControlSurface::trackVolumeTouched() const {
-    return trackVolumeTouchedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackVolumeTouched, trackVolumeTouchedSubject_.get_observable());
   }
 
   rx::observable<Track> HelperControlSurface::trackPanTouched() const {
-    return trackPanTouchedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackPanTouched, trackPanTouchedSubject_.get_observable());
   }
 
   rx::observable<Track> HelperControlSurface::trackArmTouched() const {
@@ -900,28 +1151,150 @@ namespace reaplus {
   }
 
   rx::observable<TrackSend> HelperControlSurface::trackSendVolumeTouched() const {
-    return trackSendVolumeTouchedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::TrackSendVolumeTouched, trackSendVolumeTouchedSubject_.get_observable());
   }
   rxcpp::observable<bool> HelperControlSurface::mainThreadIdle() const {
     return mainThreadIdleSubject_.get_observable();
   }
 
-  bool HelperControlSurface::trackParameterIsAutomated(Track track, string parameterName) const {
-    if (track.isAvailable() && reaper::GetTrackEnvelopeByName(track.mediaTrack(), parameterName.c_str()) != nullptr) {
-      // There's at least one automation lane for this parameter
-      auto automationMode = track.effectiveAutomationMode();
-      switch (automationMode) {
-        case AutomationMode::Bypass:
-        case AutomationMode::TrimRead:
-        case AutomationMode::Write:
-          // Is not automated
-          return false;
-        default:
-          // Is automated
-          return true;
+  bool HelperControlSurface::trackParameterIsAutomated(MediaTrack* mediaTrack, TrackData& trackData,
+      TrackEnvelopeType envelopeType) const {
+    if (trackData.automationStateGeneration != automationStateGeneration_) {
+      updateAutomationState(mediaTrack, trackData);
+    }
+    const int envelopeFlag = 1 << static_cast<int>(envelopeType);
+    // Automated only if there's at least one automation lane for this parameter and the envelope is being read
+    return trackData.automationModeReadsEnvelopes && (trackData.envelopeFlags & envelopeFlag) != 0;
+  }
+
+  void HelperControlSurface::updateAutomationState(MediaTrack* mediaTrack, TrackData& trackData) const {
+    // Order must correspond to TrackEnvelopeType
+    static const std::array<const char*, 5> ENVELOPE_NAMES = {"Volume", "Pan", "Mute", "Send Volume", "Send Pan"};
+    trackData.envelopeFlags = 0;
+    for (int i = 0; i < (int) ENVELOPE_NAMES.size(); i++) {
+      if (reaper::GetTrackEnvelopeByName(mediaTrack, ENVELOPE_NAMES[i]) != nullptr) {
+        trackData.envelopeFlags |= 1 << i;
       }
-    } else {
-      return false;
     }
+    const auto automationOverride = static_cast<AutomationMode>(reaper::GetGlobalAutomationOverride());
+    const auto automationMode = automationOverride == AutomationMode::NoOverride
+                                ? static_cast<AutomationMode>(reaper::GetTrackAutomationMode(mediaTrack))
+                                : automationOverride;
+    switch (automationMode) {
+      case AutomationMode::Bypass:
+      case AutomationMode::TrimRead:
+      case AutomationMode::Write:
+        trackData.automationModeReadsEnvelopes = false;
+        break;
+      default:
+        trackData.automationModeReadsEnvelopes = true;
+        break;
+    }
+    trackData.automationStateGeneration = automationStateGeneration_;
+  }
+
+  void HelperControlSurface::invalidateAutomationStates() {
+    automationStateGeneration_++;
+  }
+
+  rxcpp::observable<FxParameter> HelperControlSurface::fxParameterValueChanged(const FxParameter& fxParameter) {
+    return listenerMask_.observe(EventKind::FxParameterValueChanged,
+        fxParameterValueChangedByKey_.observable(fxParameterKey(fxParameter)));
+  }
+
+  rxcpp::observable<FxParameter> HelperControlSurface::fxParameterTouched(const FxParameter& fxParameter) {
+    return listenerMask_.observe(EventKind::FxParameterTouched,
+        fxParameterTouchedByKey_.observable(fxParameterKey(fxParameter)));
+  }
+
+  rxcpp::observable<Track> HelperControlSurface::trackVolumeChanged(const Track& track) {
+    return listenerMask_.observe(EventKind::TrackVolumeChanged,
+        trackVolumeChangedByMediaTrack_.observable(track.mediaTrack()));
+  }
+
+  rxcpp::observable<Track> HelperControlSurface::trackVolumeTouched(const Track& track) {
+    return listenerMask_.observe(EventKind::TrackVolumeTouched,
+        trackVolumeTouchedByMediaTrack_.observable(track.mediaTrack()));
+  }
+
+  rxcpp::observable<Track> HelperControlSurface::trackPanChanged(const Track& track) {
+    return listenerMask_.observe(EventKind::TrackPanChanged,
+        trackPanChangedByMediaTrack_.observable(track.mediaTrack()));
+  }
+
+  rxcpp::observable<Track> HelperControlSurface::trackPanTouched(const Track& track) {
+    return listenerMask_.observe(EventKind::TrackPanTouched,
+        trackPanTouchedByMediaTrack_.observable(track.mediaTrack()));
+  }
+
+  rxcpp::observable<Track> HelperControlSurface::trackMuteChanged(const Track& track) {
+    return listenerMask_.observe(EventKind::TrackMuteChanged,
+        trackMuteChangedByMediaTrack_.observable(track.mediaTrack()));
+  }
+
+  rxcpp::observable<Track> HelperControlSurface::trackMuteTouched(const Track& track) {
+    return listenerMask_.observe(EventKind::TrackMuteTouched,
+        trackMuteTouchedByMediaTrack_.observable(track.mediaTrack()));
+  }
+
+  rxcpp::observable<Track> HelperControlSurface::trackSoloChanged(const Track& track) {
+    return listenerMask_.observe(EventKind::TrackSoloChanged,
+        trackSoloChangedByMediaTrack_.observable(track.mediaTrack()));
+  }
+
+  rxcpp::observable<Track> HelperControlSurface::trackArmChanged(const Track& track) {
+    return listenerMask_.observe(EventKind::TrackArmChanged,
+        trackArmChangedByMediaTrack_.observable(track.mediaTrack()));
+  }
+
+  rxcpp::observable<Track> HelperControlSurface::trackSelectedChanged(const Track& track) {
+    return listenerMask_.observe(EventKind::TrackSelectedChanged,
+        trackSelectedChangedByMediaTrack_.observable(track.mediaTrack()));
+  }
+
+  FxParameterKey HelperControlSurface::fxParameterKey(const FxParameter& fxParameter) {
+    const auto fx = fxParameter.fx();
+    if (fx.guid().empty()) {
+      throw std::logic_error("Keyed subscriptions are only supported for GUID-based FX");
+    }
+    return FxParameterKey{fx.track().mediaTrack(), fx.guid(), fxParameter.index()};
+  }
+
+  void HelperControlSurface::completeKeyedSubjects(MediaTrack* mediaTrack) {
+    const auto isTrackKey = [mediaTrack](MediaTrack* key) {
+      return key == mediaTrack;
+    };
+    const auto isFxParameterKey = [mediaTrack](const FxParameterKey& key) {
+      return key.mediaTrack == mediaTrack;
+    };
+    fxParameterValueChangedByKey_.completeIf(isFxParameterKey);
+    fxParameterTouchedByKey_.completeIf(isFxParameterKey);
+    trackVolumeChangedByMediaTrack_.completeIf(isTrackKey);
+    trackVolumeTouchedByMediaTrack_.completeIf(isTrackKey);
+    trackPanChangedByMediaTrack_.completeIf(isTrackKey);
+    trackPanTouchedByMediaTrack_.completeIf(isTrackKey);
+    trackMuteChangedByMediaTrack_.completeIf(isTrackKey);
+    trackMuteTouchedByMediaTrack_.completeIf(isTrackKey);
+    trackSoloChangedByMediaTrack_.completeIf(isTrackKey);
+    trackArmChangedByMediaTrack_.completeIf(isTrackKey);
+    trackSelectedChangedByMediaTrack_.completeIf(isTrackKey);
+  }
+
+  void HelperControlSurface::completeKeyedSubjects(const std::string& fxGuid) {
+    const auto isFxParameterKey = [&fxGuid](const FxParameterKey& key) {
+      return key.fxGuid == fxGuid;
+    };
+    fxParameterValueChangedByKey_.completeIf(isFxParameterKey);
+    fxParameterTouchedByKey_.completeIf(isFxParameterKey);
+  }
+
+  bool operator==(const FxParameterKey& lhs, const FxParameterKey& rhs) {
+    return lhs.mediaTrack == rhs.mediaTrack && lhs.paramIndex == rhs.paramIndex && lhs.fxGuid == rhs.fxGuid;
+  }
+
+  std::size_t FxParameterKeyHash::operator()(const FxParameterKey& key) const {
+    std::size_t hash = std::hash<std::string>()(key.fxGuid);
+    hash ^= std::hash<int>()(key.paramIndex) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
   }
 }
\ No newline at end of file
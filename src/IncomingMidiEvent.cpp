@@ -16,7 +16,41 @@ namespace reaplus {
     return frameOffset_;
   }
 
-  IncomingMidiEvent::IncomingMidiEvent(MidiInputDevice inputDevice, MidiMessage message, int frameOffset)
-      : inputDevice_(inputDevice), message_(std::move(message)), frameOffset_(frameOffset) {
+  uint64_t IncomingMidiEvent::sampleTime() const {
+    return sampleTime_;
+  }
+
+  double IncomingMidiEvent::time() const {
+    return time_;
+  }
+
+  const unsigned char* IncomingMidiEvent::sysExData() const {
+    return sysExData_;
+  }
+
+  size_t IncomingMidiEvent::sysExSize() const {
+    return sysExSize_;
+  }
+
+  IncomingMidiEvent IncomingMidiEvent::withOwnedSysExData() const {
+    if (sysExData_ == nullptr || ownedSysExData_ != nullptr) {
+      return *this;
+    }
+    auto copy = *this;
+    copy.ownedSysExData_ = std::make_shared<const std::vector<unsigned char>>(sysExData_, sysExData_ + sysExSize_);
+    copy.sysExData_ = copy.ownedSysExData_->data();
+    return copy;
+  }
+
+  IncomingMidiEvent::IncomingMidiEvent(MidiInputDevice inputDevice, MidiMessage message, int frameOffset,
+      uint64_t sampleTime, double time)
+      : inputDevice_(inputDevice), message_(std::move(message)), frameOffset_(frameOffset), sampleTime_(sampleTime),
+        time_(time) {
+  }
+
+  IncomingMidiEvent::IncomingMidiEvent(MidiInputDevice inputDevice, MidiMessage message, int frameOffset,
+      uint64_t sampleTime, double time, const unsigned char* sysExData, size_t sysExSize)
+      : inputDevice_(inputDevice), message_(std::move(message)), frameOffset_(frameOffset), sampleTime_(sampleTime),
+        time_(time), sysExData_(sysExData), sysExSize_(sysExSize) {
   }
 }
\ No newline at end of file
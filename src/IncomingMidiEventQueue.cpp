@@ -0,0 +1,99 @@
+#include <reaplus/IncomingMidiEventQueue.h>
+#include <algorithm>
+
+using helgoboss::MidiMessage;
+
+namespace reaplus {
+  RawIncomingMidiEvent RawIncomingMidiEvent::fromMidiEvent(int inputDeviceId, const MIDI_event_t& midiEvent,
+      const AudioBlockClock& clock) {
+    RawIncomingMidiEvent event{};
+    event.sampleTime = clock.sampleTimeOf(midiEvent.frame_offset);
+    event.time = clock.timeOf(midiEvent.frame_offset);
+    event.inputDeviceId = inputDeviceId;
+    event.frameOffset = midiEvent.frame_offset;
+    event.sysExSize = midiEvent.size > 3 ? (uint32_t) midiEvent.size : 0;
+    event.size = (unsigned char) std::max(0, std::min(midiEvent.size, 3));
+    std::copy(midiEvent.midi_message, midiEvent.midi_message + event.size, event.bytes);
+    return event;
+  }
+
+  IncomingMidiEvent RawIncomingMidiEvent::toIncomingMidiEvent(const unsigned char* sysExData) const {
+    const auto message = size == 0 ? MidiMessage::empty() : MidiMessage(bytes[0], bytes[1], bytes[2]);
+    if (sysExSize == 0 || sysExData == nullptr) {
+      return IncomingMidiEvent(MidiInputDevice(inputDeviceId), message, frameOffset, sampleTime, time);
+    }
+    return IncomingMidiEvent(MidiInputDevice(inputDeviceId), message, frameOffset, sampleTime, time, sysExData,
+        sysExSize).withOwnedSysExData();
+  }
+
+  IncomingMidiEventQueue::IncomingMidiEventQueue(size_t capacity, size_t sysExCapacity,
+      const MidiInputFilter& filter, const boost::optional<MidiAggregationConfig>& aggregation) :
+      filter_(filter.compile()),
+      buffer_(capacity),
+      sysExBuffer_(sysExCapacity),
+      aggregator_(aggregation ? std::make_unique<MidiEventAggregator>(*aggregation) : nullptr),
+      // Composite events replace raw ones, so they can't be more
+      compositeBuffer_(aggregation ? capacity : 1),
+      poppedSysExData_(sysExBuffer_.capacity()) {
+  }
+
+  bool IncomingMidiEventQueue::isAggregating() const {
+    return aggregator_ != nullptr;
+  }
+
+  void IncomingMidiEventQueue::push(const RawIncomingMidiEvent& event, const unsigned char* sysExData) {
+    if (aggregator_ && aggregator_->process(event, *this)) {
+      return;
+    }
+    if (event.sysExSize > 0) {
+      // Check for space in both buffers first, so that data never gets out of sync
+      if (sysExData == nullptr || buffer_.size() >= buffer_.capacity()
+          || !sysExBuffer_.tryPushAll(sysExData, event.sysExSize)) {
+        overflowCount_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    if (!buffer_.tryPush(event)) {
+      overflowCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  const CompiledMidiInputFilter& IncomingMidiEventQueue::filter() const {
+    return filter_;
+  }
+
+  void IncomingMidiEventQueue::flushExpiredCompositeEvents(double now) {
+    if (aggregator_) {
+      aggregator_->flushExpired(now, *this);
+    }
+  }
+
+  void IncomingMidiEventQueue::emit(const CompositeMidiEvent& event) {
+    if (!compositeBuffer_.tryPush(event)) {
+      overflowCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  bool IncomingMidiEventQueue::tryPopComposite(CompositeMidiEvent& event) {
+    return compositeBuffer_.tryPop(event);
+  }
+
+  bool IncomingMidiEventQueue::tryPop(RawIncomingMidiEvent& event, const unsigned char*& sysExData) {
+    if (!buffer_.tryPop(event)) {
+      return false;
+    }
+    sysExData = nullptr;
+    if (event.sysExSize > 0 && sysExBuffer_.tryPopAll(poppedSysExData_.data(), event.sysExSize)) {
+      sysExData = poppedSysExData_.data();
+    }
+    return true;
+  }
+
+  size_t IncomingMidiEventQueue::capacity() const {
+    return buffer_.capacity();
+  }
+
+  uint64_t IncomingMidiEventQueue::overflowCount() const {
+    return overflowCount_.load(std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,187 @@
+#include <reaplus/MainThreadProfiler.h>
+#include <algorithm>
+#include <sstream>
+#include <reaplus/util/log.h>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace {
+  // Recalibrating over a longer period makes the rate more precise
+  constexpr auto MIN_CALIBRATION_PERIOD = std::chrono::milliseconds(100);
+  constexpr size_t SUMMARY_ENTRY_COUNT = 10;
+
+  int histogramBucketIndexOf(microseconds time) {
+    int index = 0;
+    auto count = time.count();
+    while (count > 0 && index < reaplus::MainThreadProfiler::HISTOGRAM_BUCKET_COUNT - 1) {
+      count >>= 1;
+      index++;
+    }
+    return index;
+  }
+
+  void appendStatistics(std::ostringstream& out, const char* title,
+      const std::vector<reaplus::ProfiledTimeStatistics>& statistics) {
+    out << title << " (max / avg / calls):\n";
+    for (size_t i = 0; i < std::min(statistics.size(), SUMMARY_ENTRY_COUNT); i++) {
+      const auto& s = statistics[i];
+      out << "  " << s.name << ": " << s.maxTime.count() << " us / "
+          << (s.callCount == 0 ? 0 : s.totalTime.count() / (int64_t) s.callCount) << " us / " << s.callCount << "\n";
+    }
+  }
+}
+
+namespace reaplus {
+  MainThreadProfiler::MainThreadProfiler() {
+    // Rough initial calibration, refined in onMainLoopCycle()
+    calibrationStartTicks_ = readTicks();
+    calibrationStartTime_ = steady_clock::now();
+    auto now = calibrationStartTime_;
+    while (now - calibrationStartTime_ < microseconds(500)) {
+      now = steady_clock::now();
+    }
+    const auto elapsedMicros = (double) duration_cast<microseconds>(now - calibrationStartTime_).count();
+    ticksPerMicrosecond_ = std::max((readTicks() - calibrationStartTicks_) / elapsedMicros, 1.0);
+    lastDumpTime_ = now;
+  }
+
+  void MainThreadProfiler::setConfig(const MainThreadProfilerConfig& config) {
+    config_ = config;
+  }
+
+  const MainThreadProfilerConfig& MainThreadProfiler::config() const {
+    return config_;
+  }
+
+  void MainThreadProfiler::onMainLoopCycle() {
+    const auto now = steady_clock::now();
+    const auto elapsed = now - calibrationStartTime_;
+    if (elapsed >= MIN_CALIBRATION_PERIOD) {
+      const auto elapsedMicros = (double) duration_cast<microseconds>(elapsed).count();
+      ticksPerMicrosecond_ = std::max((readTicks() - calibrationStartTicks_) / elapsedMicros, 1.0);
+    }
+    if (config_.enabled && config_.dumpInterval.count() > 0 && now - lastDumpTime_ >= config_.dumpInterval) {
+      lastDumpTime_ = now;
+      util::log(summary());
+    }
+  }
+
+  void MainThreadProfiler::beginSection(const char* sectionName) {
+    if (activeSectionCount_ == activeSections_.size()) {
+      activeSections_.emplace_back();
+    }
+    auto& section = activeSections_[activeSectionCount_++];
+    section.name = sectionName;
+    section.subscriberTicks.clear();
+    section.startTicks = readTicks();
+  }
+
+  void MainThreadProfiler::endSection() {
+    if (activeSectionCount_ == 0) {
+      // Profiler has been reset while the section was active
+      return;
+    }
+    const auto& section = activeSections_[--activeSectionCount_];
+    const auto ticks = readTicks() - section.startTicks;
+    record(sections_[section.name], ticks);
+    const auto duration = toMicroseconds(ticks);
+    if (duration < config_.stallThreshold) {
+      return;
+    }
+    ProfiledStall stall{section.name, duration, steady_clock::now(), {}};
+    auto subscriberTicks = section.subscriberTicks;
+    std::sort(subscriberTicks.begin(), subscriberTicks.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.second > rhs.second;
+    });
+    for (size_t i = 0; i < std::min(subscriberTicks.size(), MAX_SUBSCRIBER_COUNT_PER_STALL); i++) {
+      stall.subscriberTimes.emplace_back(subscriberTicks[i].first, toMicroseconds(subscriberTicks[i].second));
+    }
+    if (recentStalls_.size() == MAX_RECENT_STALL_COUNT) {
+      recentStalls_.pop_front();
+    }
+    recentStalls_.push_back(std::move(stall));
+  }
+
+  void MainThreadProfiler::recordSubscriberCall(const char* subscriberName, uint64_t ticks) {
+    record(subscribers_[subscriberName], ticks);
+    // Attributed to all enclosing sections, so a stall of an outer section also shows subscribers of inner ones
+    for (size_t i = 0; i < activeSectionCount_; i++) {
+      auto& subscriberTicks = activeSections_[i].subscriberTicks;
+      const auto existing = std::find_if(subscriberTicks.begin(), subscriberTicks.end(), [subscriberName](auto& p) {
+        return p.first == subscriberName;
+      });
+      if (existing == subscriberTicks.end()) {
+        subscriberTicks.emplace_back(subscriberName, ticks);
+      } else {
+        existing->second += ticks;
+      }
+    }
+  }
+
+  void MainThreadProfiler::record(Accumulator& accumulator, uint64_t ticks) const {
+    accumulator.callCount++;
+    accumulator.totalTicks += ticks;
+    accumulator.maxTicks = std::max(accumulator.maxTicks, ticks);
+    accumulator.histogram[histogramBucketIndexOf(toMicroseconds(ticks))]++;
+  }
+
+  microseconds MainThreadProfiler::toMicroseconds(uint64_t ticks) const {
+    return microseconds((int64_t) (ticks / ticksPerMicrosecond_));
+  }
+
+  std::vector<ProfiledTimeStatistics> MainThreadProfiler::sectionStatistics() const {
+    return statistics(sections_);
+  }
+
+  std::vector<ProfiledTimeStatistics> MainThreadProfiler::subscriberStatistics() const {
+    return statistics(subscribers_);
+  }
+
+  std::vector<ProfiledStall> MainThreadProfiler::recentStalls() const {
+    return std::vector<ProfiledStall>(recentStalls_.begin(), recentStalls_.end());
+  }
+
+  std::string MainThreadProfiler::summary() const {
+    std::ostringstream out;
+    appendStatistics(out, "Main thread sections", sectionStatistics());
+    appendStatistics(out, "Subscribers", subscriberStatistics());
+    out << "Stalls (>= " << config_.stallThreshold.count() << " us): " << recentStalls_.size() << "\n";
+    for (const auto& stall : recentStalls_) {
+      out << "  " << stall.sectionName << ": " << stall.duration.count() << " us";
+      for (const auto& subscriberTime : stall.subscriberTimes) {
+        out << ", " << subscriberTime.first << " " << subscriberTime.second.count() << " us";
+      }
+      out << "\n";
+    }
+    return out.str();
+  }
+
+  void MainThreadProfiler::reset() {
+    sections_.clear();
+    subscribers_.clear();
+    recentStalls_.clear();
+    activeSectionCount_ = 0;
+  }
+
+  std::vector<ProfiledTimeStatistics> MainThreadProfiler::statistics(
+      const std::unordered_map<const char*, Accumulator>& accumulators) const {
+    std::vector<ProfiledTimeStatistics> result;
+    result.reserve(accumulators.size());
+    for (const auto& entry : accumulators) {
+      const auto& accumulator = entry.second;
+      result.push_back({
+          entry.first,
+          accumulator.callCount,
+          toMicroseconds(accumulator.totalTicks),
+          toMicroseconds(accumulator.maxTicks),
+          std::vector<uint64_t>(accumulator.histogram.begin(), accumulator.histogram.end())
+      });
+    }
+    std::sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.maxTime > rhs.maxTime;
+    });
+    return result;
+  }
+}
@@ -0,0 +1,126 @@
+#include <reaplus/MainThreadScheduler.h>
+#include <reaplus/util/Tracing.h>
+#include <algorithm>
+#include <utility>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+namespace {
+  // Weight of the newest sample in moving averages
+  const double SMOOTHING_FACTOR = 0.1;
+  // REAPER calls the control surface main loop about 30 times per second
+  const double INITIAL_TICK_PERIOD_IN_MICROS = 1000000.0 / 30;
+  // The last task of a tick always ends a bit after the deadline, that's not considered an overrun
+  const double OVERRUN_TOLERANCE = 0.1;
+
+  double smooth(double average, double sample) {
+    return average + SMOOTHING_FACTOR * (sample - average);
+  }
+
+  double toMicros(std::chrono::steady_clock::duration duration) {
+    return (double) duration_cast<microseconds>(duration).count();
+  }
+}
+
+namespace reaplus {
+  MainThreadScheduler::MainThreadScheduler() :
+      averageTickPeriodInMicros_(INITIAL_TICK_PERIOD_IN_MICROS),
+      currentBudget_(config_.maxBudget) {
+  }
+
+  void MainThreadScheduler::schedule(MainThreadTaskPriority priority, util::InplaceTask task) {
+    taskClasses_[(int) priority].queue.enqueue({std::move(task), Clock::now()});
+  }
+
+  void MainThreadScheduler::setExternalSource(MainThreadTaskPriority priority, std::function<bool()> source) {
+    taskClasses_[(int) priority].externalSource = std::move(source);
+  }
+
+  void MainThreadScheduler::setConfig(const MainThreadSchedulerConfig& config) {
+    config_ = config;
+  }
+
+  const MainThreadSchedulerConfig& MainThreadScheduler::config() const {
+    return config_;
+  }
+
+  void MainThreadScheduler::runTick(Clock::time_point tickStartTime) {
+    REAPLUS_TRACE_SPAN("MainThreadScheduler::runTick");
+    const auto startTime = Clock::now();
+    updateBudget(tickStartTime, startTime);
+    const auto deadline = startTime + currentBudget_;
+    // First give each class its guaranteed share, at least one task
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+      auto& taskClass = taskClasses_[p];
+      const auto shareEndTime = std::min(
+          Clock::now() + duration_cast<Clock::duration>(currentBudget_ * std::max(0.0, config_.budgetShares[p])),
+          deadline
+      );
+      if (!executeOne(taskClass)) {
+        continue;
+      }
+      while (Clock::now() < shareEndTime && executeOne(taskClass)) {
+      }
+    }
+    // Then distribute what's left in priority order
+    for (auto& taskClass : taskClasses_) {
+      while (Clock::now() < deadline && executeOne(taskClass)) {
+      }
+    }
+    tickCount_++;
+    if (Clock::now() - deadline > currentBudget_ * OVERRUN_TOLERANCE) {
+      overrunCount_++;
+    }
+  }
+
+  bool MainThreadScheduler::executeOne(TaskClass& taskClass) {
+    const bool hasExternalSource = (bool) taskClass.externalSource;
+    const bool preferExternalSource = hasExternalSource && taskClass.preferExternalSource;
+    taskClass.preferExternalSource = !taskClass.preferExternalSource;
+    if (preferExternalSource && taskClass.externalSource()) {
+      return true;
+    }
+    QueuedTask queuedTask;
+    if (taskClass.queue.try_dequeue(queuedTask)) {
+      const auto waitTime = Clock::now() - queuedTask.enqueueTime;
+      taskClass.averageWaitTimeInMicros = smooth(taskClass.averageWaitTimeInMicros, toMicros(waitTime));
+      taskClass.maxWaitTime = std::max(taskClass.maxWaitTime, waitTime);
+      taskClass.executedCount++;
+      queuedTask.task();
+      return true;
+    }
+    return hasExternalSource && !preferExternalSource && taskClass.externalSource();
+  }
+
+  void MainThreadScheduler::updateBudget(Clock::time_point tickStartTime, Clock::time_point now) {
+    if (tickCount_ > 0) {
+      averageTickPeriodInMicros_ = smooth(averageTickPeriodInMicros_, toMicros(tickStartTime - lastTickStartTime_));
+    }
+    lastTickStartTime_ = tickStartTime;
+    averageOverheadInMicros_ = smooth(averageOverheadInMicros_, toMicros(now - tickStartTime));
+    const auto budgetInMicros = config_.budgetFractionOfTick * averageTickPeriodInMicros_ - averageOverheadInMicros_;
+    const auto clampedBudgetInMicros = std::min(
+        std::max(budgetInMicros, (double) config_.minBudget.count()),
+        (double) config_.maxBudget.count()
+    );
+    currentBudget_ = duration_cast<Clock::duration>(microseconds((int64_t) clampedBudgetInMicros));
+  }
+
+  MainThreadSchedulerMetrics MainThreadScheduler::metrics() const {
+    MainThreadSchedulerMetrics metrics{};
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+      const auto& taskClass = taskClasses_[p];
+      auto& classMetrics = metrics.classes[p];
+      classMetrics.queueDepth = taskClass.queue.size_approx();
+      classMetrics.executedCount = taskClass.executedCount;
+      classMetrics.averageWaitTime = microseconds((int64_t) taskClass.averageWaitTimeInMicros);
+      classMetrics.maxWaitTime = duration_cast<microseconds>(taskClass.maxWaitTime);
+    }
+    metrics.tickCount = tickCount_;
+    metrics.overrunCount = overrunCount_;
+    metrics.currentBudget = duration_cast<microseconds>(currentBudget_);
+    metrics.averageTickPeriod = microseconds((int64_t) averageTickPeriodInMicros_);
+    return metrics;
+  }
+}
@@ -0,0 +1,287 @@
+#include <reaplus/MidiEventAggregator.h>
+#include <reaplus/IncomingMidiEventQueue.h>
+#include <utility>
+
+namespace {
+  const uint8_t CC_DATA_ENTRY_MSB = 6;
+  const uint8_t CC_DATA_ENTRY_LSB = 38;
+  const uint8_t CC_DATA_INCREMENT = 96;
+  const uint8_t CC_DATA_DECREMENT = 97;
+  const uint8_t CC_NRPN_LSB = 98;
+  const uint8_t CC_NRPN_MSB = 99;
+  const uint8_t CC_RPN_LSB = 100;
+  const uint8_t CC_RPN_MSB = 101;
+
+  uint16_t combine(int8_t msb, int8_t lsb) {
+    return (uint16_t) (((msb < 0 ? 0 : msb) << 7) | (lsb < 0 ? 0 : lsb));
+  }
+}
+
+namespace reaplus {
+  MidiEventAggregator::MidiEventAggregator(MidiAggregationConfig config) : config_(std::move(config)) {
+    deviceStateIndexes_.fill(-1);
+    if (config_.deviceIds.empty()) {
+      deviceStates_.resize(MAX_AGGREGATED_DEVICE_COUNT);
+    } else {
+      for (const int id : config_.deviceIds) {
+        if (id >= 0 && id < MAX_DEVICE_COUNT && deviceStateIndexes_[id] == -1) {
+          deviceStateIndexes_[id] = (int16_t) deviceStates_.size();
+          deviceStates_.emplace_back();
+          assignDeviceState(deviceStates_.back(), id);
+        }
+      }
+      usedDeviceStateCount_ = (int) deviceStates_.size();
+    }
+  }
+
+  MidiEventAggregator::DeviceState* MidiEventAggregator::findOrAssignDeviceState(int inputDeviceId) {
+    if (inputDeviceId < 0 || inputDeviceId >= MAX_DEVICE_COUNT) {
+      return nullptr;
+    }
+    const auto index = deviceStateIndexes_[inputDeviceId];
+    if (index != -1) {
+      return &deviceStates_[index];
+    }
+    if (!config_.deviceIds.empty() || usedDeviceStateCount_ == (int) deviceStates_.size()) {
+      return nullptr;
+    }
+    auto& deviceState = deviceStates_[usedDeviceStateCount_];
+    assignDeviceState(deviceState, inputDeviceId);
+    deviceStateIndexes_[inputDeviceId] = (int16_t) usedDeviceStateCount_;
+    usedDeviceStateCount_++;
+    return &deviceState;
+  }
+
+  void MidiEventAggregator::assignDeviceState(DeviceState& deviceState, int inputDeviceId) const {
+    deviceState.inputDeviceId = inputDeviceId;
+    deviceState.controllers14BitMask = 0;
+    for (const auto& pair : config_.controllerPairs14Bit) {
+      if ((pair.inputDeviceId == -1 || pair.inputDeviceId == inputDeviceId) && pair.msbControllerNumber < 32) {
+        deviceState.controllers14BitMask |= 1u << pair.msbControllerNumber;
+      }
+    }
+  }
+
+  bool MidiEventAggregator::process(const RawIncomingMidiEvent& event, Sink& sink) {
+    if (event.size < 3 || event.sysExSize > 0) {
+      return false;
+    }
+    const auto statusByte = event.bytes[0];
+    const bool isControlChange = (statusByte & 0xF0) == 0xB0;
+    const bool isPitchBendChange = (statusByte & 0xF0) == 0xE0;
+    if (!(isControlChange || (isPitchBendChange && config_.aggregatePitchBend))) {
+      return false;
+    }
+    const auto deviceState = findOrAssignDeviceState(event.inputDeviceId);
+    if (deviceState == nullptr) {
+      return false;
+    }
+    if (isPitchBendChange) {
+      CompositeMidiEvent compositeEvent{};
+      compositeEvent.sampleTime = event.sampleTime;
+      compositeEvent.time = event.time;
+      compositeEvent.inputDeviceId = event.inputDeviceId;
+      compositeEvent.type = CompositeMidiEvent::Type::PitchBendChange;
+      compositeEvent.channel = (uint8_t) (statusByte & 0x0F);
+      compositeEvent.is14Bit = true;
+      compositeEvent.value = combine(event.bytes[2] & 0x7F, event.bytes[1] & 0x7F);
+      sink.emit(compositeEvent);
+      return true;
+    }
+    return processControlChange(*deviceState, event, sink);
+  }
+
+  bool MidiEventAggregator::processControlChange(DeviceState& deviceState, const RawIncomingMidiEvent& event,
+      Sink& sink) {
+    if (config_.aggregateParameterNumbers && processParameterNumberControlChange(deviceState, event, sink)) {
+      return true;
+    }
+    return config_.aggregateControlChange14Bit && processControlChange14Bit(deviceState, event, sink);
+  }
+
+  bool MidiEventAggregator::processParameterNumberControlChange(DeviceState& deviceState,
+      const RawIncomingMidiEvent& event, Sink& sink) {
+    const auto channel = (uint8_t) (event.bytes[0] & 0x0F);
+    const auto controllerNumber = (uint8_t) (event.bytes[1] & 0x7F);
+    const auto controlValue = (int8_t) (event.bytes[2] & 0x7F);
+    auto& channelState = deviceState.channels[channel];
+    switch (controllerNumber) {
+      case CC_NRPN_MSB:
+      case CC_NRPN_LSB:
+      case CC_RPN_MSB:
+      case CC_RPN_LSB: {
+        // New parameter selected, so the data of the previous one is complete
+        flushPendingDataMsb(deviceState, channelState, channel, sink);
+        channelState.lastDataMsb = NONE;
+        channelState.lastDataLsb = NONE;
+        if (controllerNumber == CC_NRPN_MSB || controllerNumber == CC_NRPN_LSB) {
+          (controllerNumber == CC_NRPN_MSB ? channelState.nrpnMsb : channelState.nrpnLsb) = controlValue;
+          channelState.selectedParameterKind = SelectedParameterKind::Nrpn;
+        } else {
+          (controllerNumber == CC_RPN_MSB ? channelState.rpnMsb : channelState.rpnLsb) = controlValue;
+          // RPN 127/127 is the "null" parameter which deselects
+          channelState.selectedParameterKind = channelState.rpnMsb == 127 && channelState.rpnLsb == 127
+                                               ? SelectedParameterKind::None
+                                               : SelectedParameterKind::Rpn;
+        }
+        return true;
+      }
+      default:
+        break;
+    }
+    const bool parameterIsSelected =
+        (channelState.selectedParameterKind == SelectedParameterKind::Nrpn
+            && channelState.nrpnMsb != NONE && channelState.nrpnLsb != NONE)
+            || (channelState.selectedParameterKind == SelectedParameterKind::Rpn
+                && channelState.rpnMsb != NONE && channelState.rpnLsb != NONE);
+    if (!parameterIsSelected) {
+      return false;
+    }
+    switch (controllerNumber) {
+      case CC_DATA_ENTRY_MSB:
+        // Same parameter sent again without LSB
+        flushPendingDataMsb(deviceState, channelState, channel, sink);
+        channelState.pendingDataMsb.value = controlValue;
+        channelState.pendingDataMsb.sampleTime = event.sampleTime;
+        channelState.pendingDataMsb.time = event.time;
+        channelState.lastDataMsb = controlValue;
+        channelState.lastDataLsb = NONE;
+        deviceState.pendingChannelMask |= 1u << channel;
+        return true;
+      case CC_DATA_ENTRY_LSB:
+        // Fine adjustments are allowed to come without MSB
+        channelState.pendingDataMsb.value = NONE;
+        channelState.lastDataLsb = controlValue;
+        emitParameterValue(deviceState, channelState, channel, true, 0, event.sampleTime, event.time, sink);
+        return true;
+      case CC_DATA_INCREMENT:
+      case CC_DATA_DECREMENT:
+        flushPendingDataMsb(deviceState, channelState, channel, sink);
+        emitParameterValue(deviceState, channelState, channel, channelState.lastDataLsb != NONE,
+            (int8_t) (controllerNumber == CC_DATA_INCREMENT ? 1 : -1), event.sampleTime, event.time, sink);
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool MidiEventAggregator::processControlChange14Bit(DeviceState& deviceState, const RawIncomingMidiEvent& event,
+      Sink& sink) {
+    const auto channel = (uint8_t) (event.bytes[0] & 0x0F);
+    const auto controllerNumber = (uint8_t) (event.bytes[1] & 0x7F);
+    const auto controlValue = (int8_t) (event.bytes[2] & 0x7F);
+    auto& channelState = deviceState.channels[channel];
+    if (controllerNumber < 32) {
+      if ((deviceState.controllers14BitMask & (1u << controllerNumber)) == 0) {
+        return false;
+      }
+      flushPendingControllerMsb(deviceState, channel, controllerNumber, sink);
+      auto& pendingMsb = channelState.pendingControllerMsbs[controllerNumber];
+      pendingMsb.value = controlValue;
+      pendingMsb.sampleTime = event.sampleTime;
+      pendingMsb.time = event.time;
+      channelState.pendingControllerMask |= 1u << controllerNumber;
+      channelState.lastControllerMsbs[controllerNumber] = controlValue;
+      deviceState.pendingChannelMask |= 1u << channel;
+      return true;
+    }
+    if (controllerNumber >= 64) {
+      return false;
+    }
+    const auto msbControllerNumber = (uint8_t) (controllerNumber - 32);
+    const auto msb = channelState.lastControllerMsbs[msbControllerNumber];
+    if (msb == NONE) {
+      // LSB of a controller which never sent its MSB, could be a plain 7-bit controller
+      return false;
+    }
+    channelState.pendingControllerMsbs[msbControllerNumber].value = NONE;
+    channelState.pendingControllerMask &= ~(1u << msbControllerNumber);
+    CompositeMidiEvent compositeEvent{};
+    compositeEvent.sampleTime = event.sampleTime;
+    compositeEvent.time = event.time;
+    compositeEvent.inputDeviceId = event.inputDeviceId;
+    compositeEvent.type = CompositeMidiEvent::Type::ControlChange14Bit;
+    compositeEvent.channel = channel;
+    compositeEvent.is14Bit = true;
+    compositeEvent.number = msbControllerNumber;
+    compositeEvent.value = combine(msb, controlValue);
+    sink.emit(compositeEvent);
+    return true;
+  }
+
+  void MidiEventAggregator::flushExpired(double now, Sink& sink) {
+    for (int d = 0; d < usedDeviceStateCount_; d++) {
+      auto& deviceState = deviceStates_[d];
+      for (uint8_t channel = 0; deviceState.pendingChannelMask != 0 && channel < 16; channel++) {
+        if ((deviceState.pendingChannelMask & (1u << channel)) == 0) {
+          continue;
+        }
+        auto& channelState = deviceState.channels[channel];
+        for (uint8_t controllerNumber = 0; channelState.pendingControllerMask != 0 && controllerNumber < 32;
+             controllerNumber++) {
+          const auto& pendingMsb = channelState.pendingControllerMsbs[controllerNumber];
+          if (pendingMsb.value != NONE && now - pendingMsb.time >= config_.timeoutInSeconds) {
+            flushPendingControllerMsb(deviceState, channel, controllerNumber, sink);
+          }
+        }
+        const auto& pendingDataMsb = channelState.pendingDataMsb;
+        if (pendingDataMsb.value != NONE && now - pendingDataMsb.time >= config_.timeoutInSeconds) {
+          flushPendingDataMsb(deviceState, channelState, channel, sink);
+        }
+        if (channelState.pendingControllerMask == 0 && channelState.pendingDataMsb.value == NONE) {
+          deviceState.pendingChannelMask &= ~(1u << channel);
+        }
+      }
+    }
+  }
+
+  void MidiEventAggregator::flushPendingDataMsb(const DeviceState& deviceState, ChannelState& channelState,
+      uint8_t channel, Sink& sink) const {
+    auto& pendingDataMsb = channelState.pendingDataMsb;
+    if (pendingDataMsb.value == NONE) {
+      return;
+    }
+    pendingDataMsb.value = NONE;
+    emitParameterValue(deviceState, channelState, channel, false, 0, pendingDataMsb.sampleTime, pendingDataMsb.time,
+        sink);
+  }
+
+  void MidiEventAggregator::flushPendingControllerMsb(DeviceState& deviceState, uint8_t channel,
+      uint8_t controllerNumber, Sink& sink) const {
+    auto& channelState = deviceState.channels[channel];
+    auto& pendingMsb = channelState.pendingControllerMsbs[controllerNumber];
+    if (pendingMsb.value == NONE) {
+      return;
+    }
+    CompositeMidiEvent compositeEvent{};
+    compositeEvent.sampleTime = pendingMsb.sampleTime;
+    compositeEvent.time = pendingMsb.time;
+    compositeEvent.inputDeviceId = deviceState.inputDeviceId;
+    compositeEvent.type = CompositeMidiEvent::Type::ControlChange14Bit;
+    compositeEvent.channel = channel;
+    compositeEvent.is14Bit = false;
+    compositeEvent.number = controllerNumber;
+    compositeEvent.value = combine(pendingMsb.value, 0);
+    pendingMsb.value = NONE;
+    channelState.pendingControllerMask &= ~(1u << controllerNumber);
+    sink.emit(compositeEvent);
+  }
+
+  void MidiEventAggregator::emitParameterValue(const DeviceState& deviceState, const ChannelState& channelState,
+      uint8_t channel, bool is14Bit, int8_t delta, uint64_t sampleTime, double time, Sink& sink) const {
+    const bool isNrpn = channelState.selectedParameterKind == SelectedParameterKind::Nrpn;
+    CompositeMidiEvent compositeEvent{};
+    compositeEvent.sampleTime = sampleTime;
+    compositeEvent.time = time;
+    compositeEvent.inputDeviceId = deviceState.inputDeviceId;
+    compositeEvent.type = isNrpn ? CompositeMidiEvent::Type::Nrpn : CompositeMidiEvent::Type::Rpn;
+    compositeEvent.channel = channel;
+    compositeEvent.is14Bit = is14Bit;
+    compositeEvent.delta = delta;
+    compositeEvent.number = isNrpn
+                            ? combine(channelState.nrpnMsb, channelState.nrpnLsb)
+                            : combine(channelState.rpnMsb, channelState.rpnLsb);
+    compositeEvent.value = combine(channelState.lastDataMsb, is14Bit ? channelState.lastDataLsb : (int8_t) 0);
+    sink.emit(compositeEvent);
+  }
+}
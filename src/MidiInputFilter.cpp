@@ -0,0 +1,33 @@
+#include <reaplus/MidiInputFilter.h>
+
+namespace reaplus {
+  CompiledMidiInputFilter MidiInputFilter::compile() const {
+    CompiledMidiInputFilter compiled;
+    if (deviceIds.empty()) {
+      compiled.acceptedDevices_.set();
+    } else {
+      for (const int id : deviceIds) {
+        if (id >= 0 && id < MAX_DEVICE_COUNT) {
+          compiled.acceptedDevices_.set(id);
+        }
+      }
+    }
+    for (int statusByte = 0x80; statusByte <= 0xFF; statusByte++) {
+      if (statusByte < 0xF0) {
+        const int typeIndex = (statusByte >> 4) - 8;
+        const int channel = statusByte & 0x0F;
+        const bool accepted = (messageTypeMask & (1u << typeIndex)) != 0 && (channelMask & (1u << channel)) != 0;
+        compiled.acceptedStatusBytes_.set(statusByte, accepted);
+      } else {
+        const int typeIndex = 7 + (statusByte & 0x0F);
+        compiled.acceptedStatusBytes_.set(statusByte, (messageTypeMask & (1u << typeIndex)) != 0);
+      }
+    }
+    for (int controllerNumber = minControllerNumber; controllerNumber <= maxControllerNumber; controllerNumber++) {
+      if (controllerNumber >= 0 && controllerNumber < 128) {
+        compiled.acceptedControllerNumbers_.set(controllerNumber);
+      }
+    }
+    return compiled;
+  }
+}
@@ -1,6 +1,9 @@
 #include <reaplus/MidiOutputDevice.h>
 #include <reaplus/utility.h>
 #include <reaper_plugin_functions.h>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
 
 using helgoboss::MidiMessage;
 
@@ -36,6 +39,21 @@ namespace reaplus {
     }
   }
 
+  void MidiOutputDevice::send(const unsigned char* data, size_t size, int frameOffset) const {
+    if (size > MAX_MESSAGE_SIZE) {
+      throw std::logic_error("MIDI message too long");
+    }
+    if (auto midiOutput = load()) {
+      // MIDI_event_t is variable-length: midi_message continues beyond its declared 4 bytes
+      alignas(MIDI_event_t) unsigned char buffer[offsetof(MIDI_event_t, midi_message) + MAX_MESSAGE_SIZE];
+      auto event = reinterpret_cast<MIDI_event_t*>(buffer);
+      event->frame_offset = frameOffset;
+      event->size = (int) size;
+      std::memcpy(event->midi_message, data, size);
+      midiOutput->SendMsg(event, frameOffset);
+    }
+  }
+
   bool operator==(const MidiOutputDevice& lhs, const MidiOutputDevice& rhs) {
     return lhs.id_ == rhs.id_;
   }
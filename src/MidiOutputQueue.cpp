@@ -0,0 +1,174 @@
+#include <reaplus/MidiOutputQueue.h>
+#include <reaper_plugin_functions.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+using helgoboss::MidiMessage;
+
+namespace reaplus {
+  MidiOutputByteBudget::MidiOutputByteBudget(double maxBytesPerSecond) : maxBytesPerSecond_(maxBytesPerSecond) {
+  }
+
+  double MidiOutputByteBudget::maxBytesPerSecond() const {
+    return maxBytesPerSecond_;
+  }
+
+  void MidiOutputByteBudget::refill(uint64_t audioBlockIndex, double blockDurationInSeconds) {
+    if (audioBlockIndex == lastRefilledAudioBlock_) {
+      return;
+    }
+    lastRefilledAudioBlock_ = audioBlockIndex;
+    const double blockBudget = maxBytesPerSecond_ * blockDurationInSeconds;
+    // Allow accumulating enough budget for the largest message even if blocks are very short
+    const double maxBudget = std::max(blockBudget, (double) QueuedMidiOutputMessage::MAX_SIZE);
+    availableBytes_ = std::min(availableBytes_ + blockBudget, maxBudget);
+  }
+
+  bool MidiOutputByteBudget::tryConsume(size_t byteCount) {
+    if (byteCount > availableBytes_) {
+      return false;
+    }
+    availableBytes_ -= byteCount;
+    return true;
+  }
+
+  MidiOutputQueue::Producer::Producer(moodycamel::ConcurrentQueue<QueuedMidiOutputMessage>& queue) : token_(queue) {
+  }
+
+  MidiOutputQueue::MidiOutputQueue(int deviceId, size_t capacity, std::shared_ptr<MidiOutputByteBudget> byteBudget) :
+      deviceId_(deviceId),
+      byteBudget_(std::move(byteBudget)),
+      queue_(capacity),
+      capacity_(capacity) {
+  }
+
+  int MidiOutputQueue::deviceId() const {
+    return deviceId_;
+  }
+
+  const std::shared_ptr<MidiOutputByteBudget>& MidiOutputQueue::byteBudget() const {
+    return byteBudget_;
+  }
+
+  MidiOutputQueue::Producer MidiOutputQueue::createProducer() {
+    return Producer(queue_);
+  }
+
+  bool MidiOutputQueue::send(const MidiMessage& message, int frameOffset) {
+    return enqueue(nullptr, createQueuedMessage(message, frameOffset));
+  }
+
+  bool MidiOutputQueue::send(const unsigned char* data, size_t size, int frameOffset) {
+    return enqueue(nullptr, createQueuedMessage(data, size, frameOffset));
+  }
+
+  bool MidiOutputQueue::send(Producer& producer, const MidiMessage& message, int frameOffset) {
+    return enqueue(&producer, createQueuedMessage(message, frameOffset));
+  }
+
+  bool MidiOutputQueue::send(Producer& producer, const unsigned char* data, size_t size, int frameOffset) {
+    return enqueue(&producer, createQueuedMessage(data, size, frameOffset));
+  }
+
+  QueuedMidiOutputMessage MidiOutputQueue::createQueuedMessage(const MidiMessage& message, int frameOffset) {
+    QueuedMidiOutputMessage queuedMessage;
+    queuedMessage.frameOffset = frameOffset;
+    queuedMessage.size = 3;
+    queuedMessage.bytes[0] = message.getStatusByte();
+    queuedMessage.bytes[1] = message.getDataByte1();
+    queuedMessage.bytes[2] = message.getDataByte2();
+    return queuedMessage;
+  }
+
+  QueuedMidiOutputMessage MidiOutputQueue::createQueuedMessage(const unsigned char* data, size_t size,
+      int frameOffset) {
+    if (size > QueuedMidiOutputMessage::MAX_SIZE) {
+      throw std::logic_error("MIDI message too long for output queue");
+    }
+    QueuedMidiOutputMessage queuedMessage;
+    queuedMessage.frameOffset = frameOffset;
+    queuedMessage.size = (uint32_t) size;
+    std::memcpy(queuedMessage.bytes, data, size);
+    return queuedMessage;
+  }
+
+  bool MidiOutputQueue::enqueue(Producer* producer, const QueuedMidiOutputMessage& message) {
+    if (approximateSize_.fetch_add(1, std::memory_order_relaxed) >= capacity_) {
+      approximateSize_.fetch_sub(1, std::memory_order_relaxed);
+      overflowCount_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    // try_enqueue() only takes blocks which were preallocated for the capacity. Those can run out before the capacity
+    // is reached because each producer holds on to its partially filled blocks.
+    const auto isEnqueued = producer == nullptr
+                            ? queue_.try_enqueue(message)
+                            : queue_.try_enqueue(producer->token_, message);
+    if (!isEnqueued) {
+      approximateSize_.fetch_sub(1, std::memory_order_relaxed);
+      overflowCount_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  void MidiOutputQueue::flush(uint64_t audioBlockIndex, double blockDurationInSeconds,
+      uint64_t midiOutputGeneration) {
+    if (midiOutputGeneration != midiOutputGeneration_) {
+      midiOutput_ = reaper::GetMidiOutput(deviceId_);
+      midiOutputGeneration_ = midiOutputGeneration;
+    }
+    if (byteBudget_) {
+      byteBudget_->refill(audioBlockIndex, blockDurationInSeconds);
+    }
+    while (true) {
+      if (!hasDeferredMessage_) {
+        if (!queue_.try_dequeue(deferredMessage_)) {
+          return;
+        }
+        hasDeferredMessage_ = true;
+      }
+      if (byteBudget_ && !byteBudget_->tryConsume(deferredMessage_.size)) {
+        // Target position is gone anyway, so send as early as possible in one of the next blocks
+        deferredMessage_.frameOffset = 0;
+        return;
+      }
+      sendNow(deferredMessage_);
+      hasDeferredMessage_ = false;
+      approximateSize_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  void MidiOutputQueue::sendNow(const QueuedMidiOutputMessage& message) const {
+    // Device not open. Messages are dropped, just like with MidiOutputDevice::send().
+    if (midiOutput_ == nullptr || message.size == 0) {
+      return;
+    }
+    if (message.size <= 3) {
+      midiOutput_->Send(message.bytes[0], message.bytes[1], message.bytes[2], message.frameOffset);
+      return;
+    }
+    // MIDI_event_t is variable-length: midi_message continues beyond its declared 4 bytes
+    alignas(MIDI_event_t) unsigned char buffer[
+        offsetof(MIDI_event_t, midi_message) + QueuedMidiOutputMessage::MAX_SIZE];
+    auto event = reinterpret_cast<MIDI_event_t*>(buffer);
+    event->frame_offset = message.frameOffset;
+    event->size = (int) message.size;
+    std::memcpy(event->midi_message, message.bytes, message.size);
+    midiOutput_->SendMsg(event, message.frameOffset);
+  }
+
+  size_t MidiOutputQueue::size() const {
+    return approximateSize_.load(std::memory_order_relaxed);
+  }
+
+  size_t MidiOutputQueue::capacity() const {
+    return capacity_;
+  }
+
+  uint64_t MidiOutputQueue::overflowCount() const {
+    return overflowCount_.load(std::memory_order_relaxed);
+  }
+}
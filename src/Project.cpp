@@ -3,6 +3,7 @@
 #include <reaplus/Section.h>
 #include <reaplus/Action.h>
 #include <reaplus/utility.h>
+#include <reaplus/util/ApiCallAccounting.h>
 #include <reaper_plugin_functions.h>
 #include <reaplus/UndoBlock.h>
 
@@ -53,6 +54,7 @@ namespace reaplus {
   }
 
   boost::optional<std::string> Project::filePath() const {
+    REAPLUS_API_CALL_SCOPE("Project::filePath");
     auto p = toString(5000, [this](char* buffer, int maxSize) {
       reaper::EnumProjects(index(), buffer, maxSize);
     });
@@ -11,7 +11,10 @@
 #include <reaplus/MidiInputDevice.h>
 #include <reaplus/IncomingMidiEvent.h>
 #include <reaplus/MidiOutputDevice.h>
+#include <reaplus/util/ApiCallAccounting.h>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 #include <reaper_plugin_functions.h>
 #include <boost/range/counting_range.hpp>
 #include <boost/range/adaptor/transformed.hpp>
@@ -392,6 +395,30 @@ namespace reaplus {
       assertTrue(*eventTrack == track, "Track event wrong");
     });
 
+    testWithUntil("Set track volume with keyed subscription", [](auto testIsOver) {
+      // Given
+      auto track = firstTrack();
+      auto otherTrack = secondTrack();
+
+      // When
+      optional<Track> eventTrack;
+      int count = 0;
+      int otherCount = 0;
+      Reaper::instance().trackVolumeChanged(track).take_until(testIsOver).subscribe([&](Track t) {
+        count++;
+        eventTrack = t;
+      });
+      Reaper::instance().trackVolumeChanged(otherTrack).take_until(testIsOver).subscribe([&](Track t) {
+        otherCount++;
+      });
+      track.setVolume(0.5);
+
+      // Then
+      assertTrue(count == 1, "Event count wrong");
+      assertTrue(otherCount == 0, "Event count of other track wrong");
+      assertTrue(*eventTrack == track, "Track event wrong");
+    });
+
     // DONE-rust
     test("Query track selection state", [] {
       // Given
@@ -953,6 +980,33 @@ namespace reaplus {
       assertTrue(*eventAction == action, "Action event wrong");
     });
 
+    testWithUntil("Replay event journal", [](auto testIsOver) {
+      // Given
+      auto action = Reaper::instance().mainSection().actionByCommandId(1582);
+      const auto filePath = (Reaper::instance().getResourceDir() / "reaplus-test-journal.bin").string();
+      Reaper::instance().startEventJournal(1024);
+      reaper::Main_OnCommandEx(action.commandId(), 0, nullptr);
+      Reaper::instance().stopEventJournal();
+      const auto dumpedCount = Reaper::instance().dumpEventJournal(filePath);
+
+      // When
+      optional<Action> eventAction;
+      int count = 0;
+      Reaper::instance().actionInvoked().take_until(testIsOver).subscribe([&](Action a) {
+        if (a == action) {
+          count++;
+          eventAction = a;
+        }
+      });
+      const auto replayedCount = Reaper::instance().replayEventJournal(filePath);
+
+      // Then
+      assertTrue(dumpedCount >= 1, "Dumped record count wrong");
+      assertTrue(replayedCount >= 1, "Replayed record count wrong");
+      assertTrue(count == 1, "Event count wrong");
+      assertTrue(*eventAction == action, "Action event wrong");
+    });
+
     // DONE-rust
     testWithUntil("Unmute track", [](auto testIsOver) {
       // Given
@@ -1436,6 +1490,55 @@ namespace reaplus {
         assertTrue(!eventTrack.is_initialized(), "Track event wrong, maybe an improvement");
       });
 
+      testWithUntil("Detect single FX move", [getFxChain](auto testIsOver) {
+        // Given
+        auto fxChain = getFxChain();
+        auto synthFx = *fxChain.fxByIndex(0);
+        auto midiFx = *fxChain.fxByIndex(1);
+
+        // When
+        int reorderedCount = 0;
+        Reaper::instance().fxReordered().take_until(testIsOver).subscribe([&](Track t) {
+          reorderedCount++;
+        });
+        std::vector<Fx> movedFxs;
+        Reaper::instance().fxMoved().take_until(testIsOver).subscribe([&](Fx f) {
+          movedFxs.push_back(f);
+        });
+        // The previous programmatic move has not been detected yet. Opening an FX window triggers detection.
+        synthFx.showInFloatingWindow();
+        reaper::TrackFX_Show(synthFx.track().mediaTrack(), synthFx.queryIndex(), 2);
+
+        // Then
+        assertTrue(reorderedCount == 1, "Reordered event count wrong");
+        assertTrue(movedFxs.size() == 1, "Only the moved FX should be reported");
+        assertTrue(movedFxs[0] == synthFx, "Moved FX wrong");
+        assertTrue(movedFxs[0].index() == 0, "Moved FX index wrong");
+        assertTrue(midiFx.index() == 1);
+      });
+
+      testWithUntil("Don't report unchanged FX order as move", [getFxChain](auto testIsOver) {
+        // Given
+        auto fxChain = getFxChain();
+        auto synthFx = *fxChain.fxByIndex(0);
+
+        // When
+        int reorderedCount = 0;
+        Reaper::instance().fxReordered().take_until(testIsOver).subscribe([&](Track t) {
+          reorderedCount++;
+        });
+        int movedCount = 0;
+        Reaper::instance().fxMoved().take_until(testIsOver).subscribe([&](Fx f) {
+          movedCount++;
+        });
+        synthFx.showInFloatingWindow();
+        reaper::TrackFX_Show(synthFx.track().mediaTrack(), synthFx.queryIndex(), 2);
+
+        // Then
+        assertTrue(reorderedCount == 0, "Reordered event although order didn't change");
+        assertTrue(movedCount == 0, "Moved event although order didn't change");
+      });
+
       testWithUntil("Remove FX", [getFxChain](auto testIsOver) {
         // Given
         auto fxChain = getFxChain();
@@ -1776,6 +1879,77 @@ namespace reaplus {
       return observable;
     });
 
+    testAndWait("Receive stuffed MIDI messages in main thread", [] {
+      // Given
+      const auto msg = MidiMessage::noteOn(0, 65, 100);
+      // When
+      const auto observable = Reaper::instance().incomingMidiEventsInMainThread().map([](IncomingMidiEvent evt) {
+        return evt.message().getType() == MidiMessageType::NoteOn
+            && evt.message().getKeyNumber() == 65
+            && evt.inputDevice().id() == 62
+            && evt.sampleTime() <= Reaper::instance().sampleCounter()
+            && Reaper::instance().currentThreadIsMainThread();
+      });
+      Reaper::instance().stuffMidiMessage(StuffMidiMessageTarget::VirtualMidiKeyboard, msg);
+      return observable;
+    });
+
+    testAndWait("Receive aggregated pitch bend in main thread", [] {
+      // Given
+      const auto msg = MidiMessage(0xE0, 0x00, 0x40);
+      // When
+      const auto observable = Reaper::instance().compositeMidiEventsInMainThread().map([](CompositeMidiEvent evt) {
+        return evt.type == CompositeMidiEvent::Type::PitchBendChange
+            && evt.value == 8192
+            && evt.is14Bit
+            && evt.inputDeviceId == 62
+            && Reaper::instance().currentThreadIsMainThread();
+      });
+      Reaper::instance().stuffMidiMessage(StuffMidiMessageTarget::VirtualMidiKeyboard, msg);
+      return observable;
+    });
+
+    testAndWait("Execute job in background", [] {
+      // Given
+      const auto mainThreadId = std::this_thread::get_id();
+      rxcpp::subjects::subject<bool> resultReceived;
+      // When
+      Reaper::instance().executeInBackground(
+          [mainThreadId](const BackgroundJobContext&) {
+            return std::this_thread::get_id() != mainThreadId;
+          },
+          [resultReceived](bool ranInWorkerThread, BackgroundJobTiming timing) {
+            resultReceived.get_subscriber().on_next(
+                ranInWorkerThread
+                    && timing.executionTime.count() >= 0
+                    && Reaper::instance().currentThreadIsMainThread()
+            );
+          }
+      );
+      return resultReceived.get_observable();
+    });
+
+    test("Account REAPER API calls", [] {
+      // Given
+      const auto track = firstTrack();
+      util::installApiCallAccounting();
+      // When
+      uint64_t callCount;
+      {
+        const util::ApiCallScope scope("ReaPlusIntegrationTest");
+        track.index();
+        callCount = scope.totalCount();
+      }
+      util::uninstallApiCallAccounting();
+      // Then
+      assertTrue(callCount > 0, "API calls not counted");
+      const auto reports = util::apiCallScopeReports();
+      const auto indexReport = std::find_if(reports.begin(), reports.end(), [](const util::ApiCallScopeReport& r) {
+        return r.scopeName == "Track::index";
+      });
+      assertTrue(indexReport != reports.end() && indexReport->totalApiCallCount > 0, "Track::index not reported");
+    });
+
     // DONE-rust
     testWithUntil("Use undoable", [](auto testIsOver) {
       // Given
@@ -11,8 +11,15 @@
 #include <reaplus/IncomingMidiEvent.h>
 #include <reaplus/HelperControlSurface.h>
 #include <reaplus/util/log.h>
+#include <reaplus/util/Tracing.h>
 #include <reaper_plugin_functions.h>
 #include <utility>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <random>
 
 using rxcpp::subscriber;
 using boost::none;
@@ -25,6 +32,94 @@ using rxcpp::observable;
 using boost::optional;
 using helgoboss::MidiMessage;
 
+namespace {
+  // Used by StuffMIDIMessage
+  const int VIRTUAL_MIDI_KEYBOARD_DEVICE_ID = 62;
+  // Written into undo points instead of the state of extensions in Deduplicate mode
+  const char* const UNDO_SNAPSHOT_TOKEN = "REAPLUS_UNDO_SNAPSHOT";
+  // Replayed MIDI events which can wait for the audio thread at once
+  const size_t REPLAYED_MIDI_EVENT_CAPACITY = 4096;
+
+  // Records the lines an extension writes and serves them back, newline-separated
+  class BufferedProjectStateContext : public ProjectStateContext {
+  private:
+    std::string buffer_;
+    size_t readPosition_ = 0;
+    int tempFlag_ = 0;
+
+  public:
+    BufferedProjectStateContext() = default;
+
+    explicit BufferedProjectStateContext(std::string buffer) : buffer_(std::move(buffer)) {
+    }
+
+    void AddLine(const char* fmt, ...) override {
+      char line[4096];
+      va_list args;
+      va_start(args, fmt);
+      const auto length = vsnprintf(line, sizeof(line), fmt, args);
+      va_end(args);
+      if (length < 0) {
+        return;
+      }
+      if ((size_t) length < sizeof(line)) {
+        buffer_.append(line, (size_t) length);
+      } else {
+        // Rare, so format again into a large enough buffer
+        std::string longLine((size_t) length + 1, '\0');
+        va_start(args, fmt);
+        vsnprintf(&longLine[0], longLine.size(), fmt, args);
+        va_end(args);
+        buffer_.append(longLine.data(), (size_t) length);
+      }
+      buffer_.push_back('\n');
+    }
+
+    int GetLine(char* buf, int buflen) override {
+      if (readPosition_ >= buffer_.size() || buflen <= 0) {
+        return -1;
+      }
+      auto lineEnd = buffer_.find('\n', readPosition_);
+      if (lineEnd == std::string::npos) {
+        lineEnd = buffer_.size();
+      }
+      const auto length = std::min(lineEnd - readPosition_, (size_t) buflen - 1);
+      std::copy_n(buffer_.data() + readPosition_, length, buf);
+      buf[length] = '\0';
+      readPosition_ = lineEnd + 1;
+      return 0;
+    }
+
+    INT64 GetOutputSize() override {
+      return (INT64) buffer_.size();
+    }
+
+    int GetTempFlag() override {
+      return tempFlag_;
+    }
+
+    void SetTempFlag(int flag) override {
+      tempFlag_ = flag;
+    }
+
+    std::string takeBuffer() {
+      return std::move(buffer_);
+    }
+  };
+
+  void writeLines(ProjectStateContext* ctx, const std::string& lines) {
+    size_t lineStart = 0;
+    while (lineStart < lines.size()) {
+      auto lineEnd = lines.find('\n', lineStart);
+      if (lineEnd == std::string::npos) {
+        lineEnd = lines.size();
+      }
+      ctx->AddLine("%.*s", (int) (lineEnd - lineStart), lines.data() + lineStart);
+      lineStart = lineEnd + 1;
+    }
+  }
+}
+
 namespace reaplus {
   std::unique_ptr<Reaper> Reaper::INSTANCE = nullptr;
 
@@ -69,9 +164,16 @@ namespace reaplus {
     }
   }
 
-  void Reaper::staticHookPostCommand(int commandId, int) {
-    auto action = Reaper::instance().mainSection().actionByCommandId(commandId);
-    instance().actionInvokedSubject_.get_subscriber().on_next(action);
+  void Reaper::staticHookPostCommand(int commandId, int flag) {
+    if (auto journal = Reaper::instance().activeEventJournal()) {
+      journal->record(EventJournalRecordKind::HookPostCommand, nullptr, commandId, flag);
+    }
+    auto& reaper = Reaper::instance();
+    if (!reaper.listenerMask_.hasListeners(EventKind::ActionInvoked)) {
+      return;
+    }
+    auto action = reaper.mainSection().actionByCommandId(commandId);
+    reaper.actionInvokedSubject_.get_subscriber().on_next(action);
   }
 
   bool Reaper::Command::reportsOnOffState() const {
@@ -97,12 +199,14 @@ namespace reaplus {
   }
 
   rxcpp::observable<Action> Reaper::actionInvoked() const {
-    return actionInvokedSubject_.get_observable();
+    return listenerMask_.observe(EventKind::ActionInvoked, actionInvokedSubject_.get_observable());
   }
 
   Reaper::Reaper() {
     // DONE-rust
     idOfMainThread_ = std::this_thread::get_id();
+    sessionId_ = (uint64_t(std::random_device()()) << 32u) | std::random_device()();
+    REAPLUS_TRACE_THREAD_NAME("Main");
     // TODO-rust
     projectConfigExtension_.ProcessExtensionLine = &processExtensionLine;
     // TODO-rust
@@ -119,11 +223,17 @@ namespace reaplus {
     reaper::plugin_register("hookpostcommand", (void*) &staticHookPostCommand);
     // DONE-rust
     audioHook_.OnAudioBuffer = &processAudioBuffer;
+    refreshOpenMidiDevices();
     // DONE-rust
     reaper::Audio_RegHardwareHook(true, &audioHook_);
   }
 
   Reaper::~Reaper() {
+    // The logging thread might still write to the REAPER console sink, which needs this instance
+    util::stopAsyncLogging();
+    // Running jobs might still deliver results through the control surface, so stop them first
+    workerPool_.reset();
+    projectClosedSubscription_.unsubscribe();
     // TODO-rust
     HelperControlSurface::destroyInstance();
     // DONE-rust
@@ -372,51 +482,313 @@ namespace reaplus {
     return incomingMidiEventsSubject_.get_observable();
   }
 
+  rxcpp::observable<IncomingMidiEvent> Reaper::incomingMidiEventsInMainThread(const MidiInputFilter& filter) {
+    return rxcpp::observable<>::create<IncomingMidiEvent>([this, filter](subscriber<IncomingMidiEvent> s) {
+      // The queue is removed in the main loop as soon as the subscriber has unsubscribed
+      auto queue = createIncomingMidiEventQueue(1024, 16384, filter);
+      const auto subscription = s.get_subscription();
+      mainThreadIncomingMidiEventConsumers_.push_back({std::move(queue), subscription, [s](IncomingMidiEventQueue& q) {
+        q.drain([&s](const RawIncomingMidiEvent& event, const unsigned char* sysExData) {
+          if (s.is_subscribed()) {
+            s.on_next(event.toIncomingMidiEvent(sysExData));
+          }
+        });
+      }});
+    });
+  }
+
+  rxcpp::observable<CompositeMidiEvent> Reaper::compositeMidiEventsInMainThread(
+      const MidiAggregationConfig& aggregation, const MidiInputFilter& filter) {
+    return rxcpp::observable<>::create<CompositeMidiEvent>([this, aggregation, filter](
+        subscriber<CompositeMidiEvent> s) {
+      // No SysEx needed
+      auto queue = createIncomingMidiEventQueue(1024, 1, filter, aggregation);
+      const auto subscription = s.get_subscription();
+      mainThreadIncomingMidiEventConsumers_.push_back({std::move(queue), subscription, [s](IncomingMidiEventQueue& q) {
+        // Raw events must be drained as well, otherwise the queue runs full
+        q.drain([](const RawIncomingMidiEvent&, const unsigned char*) {});
+        q.drainComposite([&s](const CompositeMidiEvent& event) {
+          if (s.is_subscribed()) {
+            s.on_next(event);
+          }
+        });
+      }});
+    });
+  }
+
+  std::shared_ptr<IncomingMidiEventQueue> Reaper::createIncomingMidiEventQueue(size_t capacity,
+      size_t sysExCapacity, const MidiInputFilter& filter, const boost::optional<MidiAggregationConfig>& aggregation) {
+    auto queue = std::make_shared<IncomingMidiEventQueue>(capacity, sysExCapacity, filter, aggregation);
+    const auto currentQueues = incomingMidiEventQueues_.current();
+    auto queues = currentQueues == nullptr
+                  ? std::make_unique<IncomingMidiEventQueueList>()
+                  : std::make_unique<IncomingMidiEventQueueList>(*currentQueues);
+    queues->push_back(queue);
+    incomingMidiEventQueues_.publish(std::move(queues), audioBlockCount_);
+    return queue;
+  }
+
+  void Reaper::removeIncomingMidiEventQueue(const std::shared_ptr<IncomingMidiEventQueue>& queue) {
+    const auto currentQueues = incomingMidiEventQueues_.current();
+    if (currentQueues == nullptr) {
+      return;
+    }
+    auto queues = std::make_unique<IncomingMidiEventQueueList>(*currentQueues);
+    queues->erase(std::remove(queues->begin(), queues->end(), queue), queues->end());
+    incomingMidiEventQueues_.publish(std::move(queues), audioBlockCount_);
+  }
+
+  std::shared_ptr<MidiOutputQueue> Reaper::createMidiOutputQueue(const MidiOutputDevice& device, size_t capacity,
+      double maxBytesPerSecond) {
+    const auto currentQueues = midiOutputQueues_.current();
+    // The rate limit applies to the device, so all of its queues draw from the same budget
+    std::shared_ptr<MidiOutputByteBudget> byteBudget;
+    bool deviceHasQueue = false;
+    if (currentQueues != nullptr) {
+      for (const auto& existingQueue : *currentQueues) {
+        if (existingQueue->deviceId() == device.id()) {
+          deviceHasQueue = true;
+          byteBudget = existingQueue->byteBudget();
+          break;
+        }
+      }
+    }
+    if (deviceHasQueue) {
+      if ((byteBudget ? byteBudget->maxBytesPerSecond() : 0) != maxBytesPerSecond) {
+        throw std::logic_error("all MIDI output queues of a device must have the same rate limit");
+      }
+    } else if (maxBytesPerSecond > 0) {
+      byteBudget = std::make_shared<MidiOutputByteBudget>(maxBytesPerSecond);
+    }
+    auto queue = std::make_shared<MidiOutputQueue>(device.id(), capacity, byteBudget);
+    auto queues = currentQueues == nullptr
+                  ? std::make_unique<MidiOutputQueueList>()
+                  : std::make_unique<MidiOutputQueueList>(*currentQueues);
+    queues->push_back(queue);
+    midiOutputQueues_.publish(std::move(queues), audioBlockCount_);
+    return queue;
+  }
+
+  void Reaper::removeMidiOutputQueue(const std::shared_ptr<MidiOutputQueue>& queue) {
+    const auto currentQueues = midiOutputQueues_.current();
+    if (currentQueues == nullptr) {
+      return;
+    }
+    auto queues = std::make_unique<MidiOutputQueueList>(*currentQueues);
+    queues->erase(std::remove(queues->begin(), queues->end(), queue), queues->end());
+    midiOutputQueues_.publish(std::move(queues), audioBlockCount_);
+  }
+
+  void Reaper::refreshOpenMidiDevices() {
+    midiOutputGeneration_++;
+    midiOutputQueues_.freeRetiredValues(audioBlockCount_);
+    auto deviceIds = std::make_unique<std::vector<int>>();
+    const int maxCount = reaper::GetMaxMidiInputs();
+    for (int i = 0; i < maxCount; i++) {
+      // The virtual MIDI keyboard doesn't necessarily report itself as connected
+      if (i == VIRTUAL_MIDI_KEYBOARD_DEVICE_ID || midiInputDeviceById(i).isConnected()) {
+        deviceIds->push_back(i);
+      }
+    }
+    const auto currentDeviceIds = openMidiInputDeviceIds_.current();
+    if (currentDeviceIds != nullptr && *currentDeviceIds == *deviceIds) {
+      openMidiInputDeviceIds_.freeRetiredValues(audioBlockCount_);
+      return;
+    }
+    openMidiInputDeviceIds_.publish(std::move(deviceIds), audioBlockCount_);
+  }
+
+  void Reaper::processIncomingMidiEventsInMainThread() {
+    incomingMidiEventQueues_.freeRetiredValues(audioBlockCount_);
+    if (mainThreadIncomingMidiEventConsumers_.empty()) {
+      return;
+    }
+    // Nobody interested anymore, so stop filling the queues
+    auto& consumers = mainThreadIncomingMidiEventConsumers_;
+    for (auto it = consumers.begin(); it != consumers.end();) {
+      if (it->subscription.is_subscribed()) {
+        it++;
+      } else {
+        removeIncomingMidiEventQueue(it->queue);
+        it = consumers.erase(it);
+      }
+    }
+    // Iterate over a copy because subscribers might subscribe again while being notified
+    const auto consumersSnapshot = consumers;
+    for (const auto& consumer : consumersSnapshot) {
+      consumer.drain(*consumer.queue);
+    }
+  }
+
   void Reaper::init() {
+    util::startAsyncLogging((getResourceDir() / "reaplus.log").string());
     HelperControlSurface::init();
+    projectClosedSubscription_ = projectClosed().subscribe([this](const Project& project) {
+      forgetUndoSnapshots(project.reaProject());
+    });
   }
 
   uint64_t Reaper::sampleCounter() const {
-    return sampleCounter_;
+    const auto clock = audioBlockClock_.load();
+    return clock.blockStartSample + clock.blockLength;
+  }
+
+  AudioBlockClock Reaper::audioBlockClock() const {
+    return audioBlockClock_.load();
   }
 
-  void Reaper::processAudioBuffer(bool isPost, int len, double, struct audio_hook_register_t*) {
+  void Reaper::setAudioBlockTimingEnabled(bool enabled) {
+    audioBlockTimingEnabled_ = enabled;
+  }
+
+  util::BlockTimeStatistics Reaper::audioBlockTimeStatistics() const {
+    return audioBlockTimeHistogram_.statistics();
+  }
+
+  void Reaper::resetAudioBlockTimeStatistics() {
+    audioBlockTimeHistogram_.reset();
+  }
+
+  void Reaper::processAudioBuffer(bool isPost, int len, double srate, struct audio_hook_register_t*) {
+    // Creates the trace buffer of the audio thread outside of the real-time scope
+    REAPLUS_TRACE_THREAD_NAME("Audio");
+    const util::RealTimeScope realTimeScope;
     try {
       if (!isPost) {
+        REAPLUS_TRACE_SPAN("Reaper::processAudioBuffer");
         auto& reaper = Reaper::instance();
+        const bool isTimingEnabled = reaper.audioBlockTimingEnabled_.load(std::memory_order_relaxed);
+        const auto startTime = isTimingEnabled
+                               ? std::chrono::steady_clock::now()
+                               : std::chrono::steady_clock::time_point();
+        // Advance and publish block clock
+        auto clock = reaper.audioThreadBlockClock_;
+        clock.blockStartSample += clock.blockLength;
+        clock.blockStartTime += clock.sampleRate > 0 ? clock.blockLength / clock.sampleRate : 0;
+        clock.sampleRate = srate;
+        clock.blockLength = len;
+        reaper.audioThreadBlockClock_ = clock;
+        reaper.audioBlockClock_.store(clock);
         // Make use of audioThreadCoordination for rxcpp possible
         // TODO-rust
         reaper.audioThreadRunLoop_.dispatch();
         // For each open MIDI device
         auto& subject = reaper.incomingMidiEventsSubject_;
-        for (int i = 0; subject.has_observers() && i < reaper::GetMaxMidiInputs(); i++) {
+        const auto journal = reaper.activeEventJournal();
+        const auto queues = reaper.incomingMidiEventQueues_.load();
+        const bool hasQueues = queues != nullptr && !queues->empty();
+        const auto deviceIds = reaper.openMidiInputDeviceIds_.load();
+        const int deviceCount = deviceIds == nullptr ? 0 : (int) deviceIds->size();
+        for (int d = 0; (journal || hasQueues || subject.has_observers()) && d < deviceCount; d++) {
+          const int i = (*deviceIds)[d];
           // Read MIDI messages
           const auto midiInput = reaper::GetMidiInput(i);
           if (midiInput != nullptr) {
             const auto midiEvents = midiInput->GetReadBuf();
             MIDI_event_t* midiEvent;
             int l = 0;
-            while (subject.has_observers() && (midiEvent = midiEvents->EnumItems(&l))) {
-              // Send MIDI message
-              auto& msg = midiEvent->midi_message;
-              if (msg[0] != 254) {
+            while ((journal || hasQueues || subject.has_observers()) && (midiEvent = midiEvents->EnumItems(&l))) {
+              if (midiEvent->midi_message[0] != 254) {
                 // No active sensing, good to go
-                subject.get_subscriber().on_next(IncomingMidiEvent(
-                    MidiInputDevice(i),
-                    createMidiMessageFromEvent(*midiEvent),
-                    midiEvent->frame_offset
-                ));
+                reaper.dispatchIncomingMidiEvent(i, *midiEvent, clock, journal, hasQueues ? queues : nullptr);
               }
             }
           }
         }
-        reaper.sampleCounter_ += len;
+        reaper.dispatchReplayedMidiEvents(clock, hasQueues ? queues : nullptr);
+        if (hasQueues) {
+          const auto blockEndTime = clock.blockStartTime + (clock.sampleRate > 0 ? len / clock.sampleRate : 0);
+          for (const auto& queue : *queues) {
+            queue->flushExpiredCompositeEvents(blockEndTime);
+          }
+        }
+        // Send queued MIDI messages
+        const auto outputQueues = reaper.midiOutputQueues_.load();
+        if (outputQueues != nullptr && !outputQueues->empty()) {
+          const auto blockDuration = srate > 0 ? len / srate : 0;
+          const auto midiOutputGeneration = reaper.midiOutputGeneration_.load(std::memory_order_relaxed);
+          const auto audioBlockIndex = reaper.audioBlockCount_.load(std::memory_order_relaxed);
+          // Rotating the start keeps queues which share a device budget from starving each other
+          const auto queueCount = outputQueues->size();
+          for (size_t q = 0; q < queueCount; q++) {
+            const auto& queue = (*outputQueues)[(audioBlockIndex + q) % queueCount];
+            queue->flush(audioBlockIndex, blockDuration, midiOutputGeneration);
+          }
+        }
+        // Queue lists retired before this point are not used by the audio thread anymore
+        reaper.audioBlockCount_++;
+        if (isTimingEnabled && srate > 0) {
+          const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+          reaper.audioBlockTimeHistogram_.record(elapsed.count(), len / srate);
+        }
       }
     } catch (...) {
       util::logException();
     }
   }
 
+  void Reaper::dispatchIncomingMidiEvent(int inputDeviceId, const MIDI_event_t& midiEvent,
+      const AudioBlockClock& clock, EventJournal* journal, const IncomingMidiEventQueueList* queues) {
+    if (journal) {
+      journal->recordIncomingMidiEvent(inputDeviceId, midiEvent);
+    }
+    if (queues) {
+      const auto rawEvent = RawIncomingMidiEvent::fromMidiEvent(inputDeviceId, midiEvent, clock);
+      for (const auto& queue : *queues) {
+        if (queue->filter().accepts(inputDeviceId, midiEvent)) {
+          queue->push(rawEvent, midiEvent.midi_message);
+        }
+      }
+    }
+    if (incomingMidiEventsSubject_.has_observers()) {
+      // Subjects only lock on the first emission after their observer list has changed. That can't be told apart from
+      // here, so there's no RT check which would fire for every event. Real-time consumers should use
+      // IncomingMidiEventQueue instead.
+      // SysEx data is not copied. It stays valid during this block.
+      const bool isSysEx = midiEvent.size > 3;
+      incomingMidiEventsSubject_.get_subscriber().on_next(IncomingMidiEvent(
+          MidiInputDevice(inputDeviceId),
+          createMidiMessageFromEvent(midiEvent),
+          midiEvent.frame_offset,
+          clock.sampleTimeOf(midiEvent.frame_offset),
+          clock.timeOf(midiEvent.frame_offset),
+          isSysEx ? midiEvent.midi_message : nullptr,
+          isSysEx ? (size_t) midiEvent.size : 0
+      ));
+    }
+  }
+
+  void Reaper::dispatchReplayedMidiEvents(const AudioBlockClock& clock, const IncomingMidiEventQueueList* queues) {
+    const auto replayedMidiInput = audioThreadReplayedMidiInput_.load(std::memory_order_acquire);
+    if (replayedMidiInput == nullptr) {
+      return;
+    }
+    // Frame offsets are in 1/1024000 seconds. Recorded ones might not fit into this block.
+    const int maxFrameOffset = clock.sampleRate > 0 ? (int) (clock.blockLength / clock.sampleRate * 1024000) - 1 : 0;
+    // Drained even if nobody listens, so that the queue doesn't fill up with stale events
+    replayedMidiInput->queue.drain([&](const RawIncomingMidiEvent& rawEvent, const unsigned char* sysExData) {
+      if (rawEvent.sysExSize > 0 && sysExData == nullptr) {
+        return;
+      }
+      auto& midiEvent = *reinterpret_cast<MIDI_event_t*>(replayedMidiInput->eventBuffer.data());
+      midiEvent.frame_offset = std::max(0, std::min(rawEvent.frameOffset, maxFrameOffset));
+      if (rawEvent.sysExSize > 0) {
+        midiEvent.size = (int) rawEvent.sysExSize;
+        std::copy(sysExData, sysExData + rawEvent.sysExSize, midiEvent.midi_message);
+      } else {
+        midiEvent.size = rawEvent.size;
+        std::copy(rawEvent.bytes, rawEvent.bytes + 3, midiEvent.midi_message);
+      }
+      // Replayed events are not recorded again
+      dispatchIncomingMidiEvent(rawEvent.inputDeviceId, midiEvent, clock, nullptr, queues);
+    });
+  }
+
+  Reaper::ReplayedMidiInput::ReplayedMidiInput() :
+      queue(REPLAYED_MIDI_EVENT_CAPACITY, EventJournal::MAX_SYSEX_SIZE * 4),
+      eventBuffer(sizeof(MIDI_event_t) + EventJournal::MAX_SYSEX_SIZE) {
+  }
+
   MidiMessage Reaper::createMidiMessageFromEvent(const MIDI_event_t& event) {
     if (event.size == 0) {
       return MidiMessage::empty();
@@ -428,34 +800,186 @@ namespace reaplus {
     );
   }
 
-  void Reaper::registerProjectConfigExtension(ProjectConfigExtension extension) {
+  size_t Reaper::registerProjectConfigExtension(ProjectConfigExtension extension) {
+    const auto index = projectConfigExtensions_.size();
+    for (const auto& token : extension.tokens) {
+      if (projectConfigExtensionIndexByToken_.count(token) > 0) {
+        throw std::logic_error("project config extension token " + token + " is already registered");
+      }
+    }
+    for (const auto& token : extension.tokens) {
+      projectConfigExtensionIndexByToken_.emplace(token, index);
+    }
+    if (extension.tokens.empty()) {
+      catchAllProjectConfigExtensionIndexes_.push_back(index);
+    }
     projectConfigExtensions_.emplace_back(std::move(extension));
+    projectConfigExtensionCaches_.emplace_back();
+    return index;
+  }
+
+  void Reaper::markProjectConfigExtensionDirty(size_t extensionId) {
+    auto& cache = projectConfigExtensionCaches_.at(extensionId);
+    cache.outputByProject.clear();
+    cache.currentUndoSnapshotIdByProject.clear();
   }
 
   bool Reaper::processExtensionLine(const char* line,
       ProjectStateContext* ctx,
       bool isUndo,
       struct project_config_extension_t* reg) {
+    REAPLUS_TRACE_SPAN("Reaper::processExtensionLine");
     auto& reaper = Reaper::instance();
-    for (ProjectConfigExtension& extension : reaper.projectConfigExtensions_) {
-      if (extension.processExtensionLine(line, ctx, isUndo, reg)) {
+    // Route by first token
+    const char* tokenStart = line;
+    while (*tokenStart == ' ' || *tokenStart == '\t') {
+      tokenStart++;
+    }
+    const char* tokenEnd = tokenStart;
+    while (*tokenEnd != '\0' && *tokenEnd != ' ' && *tokenEnd != '\t' && *tokenEnd != '\r' && *tokenEnd != '\n') {
+      tokenEnd++;
+    }
+    reaper.tokenBuffer_.assign(tokenStart, tokenEnd);
+    if (reaper.tokenBuffer_ == UNDO_SNAPSHOT_TOKEN) {
+      restoreUndoSnapshot(tokenEnd, isUndo, reg);
+      return true;
+    }
+    const auto owner = reaper.projectConfigExtensionIndexByToken_.find(reaper.tokenBuffer_);
+    if (owner != reaper.projectConfigExtensionIndexByToken_.end()) {
+      auto& extension = reaper.projectConfigExtensions_[owner->second];
+      if (*tokenStart == '<' && extension.processBlockLine) {
+        streamBlock(extension, ctx, isUndo);
+        return true;
+      }
+      return extension.processExtensionLine && extension.processExtensionLine(line, ctx, isUndo, reg);
+    }
+    for (const auto index : reaper.catchAllProjectConfigExtensionIndexes_) {
+      auto& extension = reaper.projectConfigExtensions_[index];
+      if (extension.processExtensionLine && extension.processExtensionLine(line, ctx, isUndo, reg)) {
         return true;
       }
     }
     return false;
   }
 
+  void Reaper::streamBlock(ProjectConfigExtension& extension, ProjectStateContext* ctx, bool isUndo) {
+    // Opening line has already been consumed
+    int depth = 1;
+    char line[4096];
+    while (ctx->GetLine(line, sizeof(line)) == 0) {
+      const char* content = line;
+      while (*content == ' ' || *content == '\t') {
+        content++;
+      }
+      if (*content == '<') {
+        depth++;
+      } else if (*content == '>') {
+        depth--;
+        if (depth == 0) {
+          return;
+        }
+      }
+      extension.processBlockLine(line, isUndo);
+    }
+  }
+
+  void Reaper::restoreUndoSnapshot(const char* line, bool isUndo, struct project_config_extension_t* reg) {
+    auto& reaper = Reaper::instance();
+    unsigned long long sessionId;
+    size_t extensionId;
+    unsigned long long snapshotId;
+    if (sscanf(line, " %llx %zu %llu", &sessionId, &extensionId, &snapshotId) != 3
+        || extensionId >= reaper.projectConfigExtensions_.size()) {
+      return;
+    }
+    const std::string* content = nullptr;
+    if (sessionId == reaper.sessionId_) {
+      auto& stores = reaper.projectConfigExtensionCaches_[extensionId].undoSnapshotsByProject;
+      const auto store = stores.find(reaper::GetCurrentProjectInLoadSave());
+      if (store != stores.end()) {
+        content = store->second.find(snapshotId);
+      }
+    }
+    if (content == nullptr) {
+      util::log("Project config extension state of this undo point is not available anymore");
+      return;
+    }
+    auto& extension = reaper.projectConfigExtensions_[extensionId];
+    BufferedProjectStateContext snapshotCtx(*content);
+    char snapshotLine[4096];
+    while (snapshotCtx.GetLine(snapshotLine, sizeof(snapshotLine)) == 0) {
+      if (snapshotLine[0] == '<' && extension.processBlockLine) {
+        streamBlock(extension, &snapshotCtx, isUndo);
+      } else if (extension.processExtensionLine) {
+        extension.processExtensionLine(snapshotLine, &snapshotCtx, isUndo, reg);
+      }
+    }
+  }
+
+  void Reaper::forgetUndoSnapshots(ReaProject* project) {
+    for (auto& cache : projectConfigExtensionCaches_) {
+      cache.undoSnapshotsByProject.erase(project);
+      cache.currentUndoSnapshotIdByProject.erase(project);
+    }
+  }
+
   void Reaper::beginLoadProjectState(bool isUndo, struct project_config_extension_t* reg) {
     auto& reaper = Reaper::instance();
+    // Loaded state replaces the state which the cached output was made from
+    for (auto& cache : reaper.projectConfigExtensionCaches_) {
+      cache.outputByProject.clear();
+      cache.currentUndoSnapshotIdByProject.clear();
+    }
+    if (!isUndo) {
+      // Loading a project starts a new undo history
+      reaper.forgetUndoSnapshots(reaper::GetCurrentProjectInLoadSave());
+    }
     for (ProjectConfigExtension& extension : reaper.projectConfigExtensions_) {
-      extension.beginLoadProjectState(isUndo, reg);
+      if (extension.beginLoadProjectState) {
+        extension.beginLoadProjectState(isUndo, reg);
+      }
     }
   }
 
   void Reaper::saveExtensionConfig(ProjectStateContext* ctx, bool isUndo, struct project_config_extension_t* reg) {
+    REAPLUS_TRACE_SPAN("Reaper::saveExtensionConfig");
     auto& reaper = Reaper::instance();
-    for (ProjectConfigExtension& extension : reaper.projectConfigExtensions_) {
-      extension.saveExtensionConfig(ctx, isUndo, reg);
+    const auto project = reaper::GetCurrentProjectInLoadSave();
+    for (size_t i = 0; i < reaper.projectConfigExtensions_.size(); i++) {
+      auto& extension = reaper.projectConfigExtensions_[i];
+      auto& cache = reaper.projectConfigExtensionCaches_[i];
+      if (!extension.saveExtensionConfig || (isUndo && extension.undoMode == ProjectConfigUndoMode::Skip)) {
+        continue;
+      }
+      if (!extension.tracksDirtiness) {
+        extension.saveExtensionConfig(ctx, isUndo, reg);
+        continue;
+      }
+      if (isUndo && extension.undoMode == ProjectConfigUndoMode::Deduplicate) {
+        auto& store = cache.undoSnapshotsByProject[project];
+        const auto currentSnapshot = cache.currentUndoSnapshotIdByProject.find(project);
+        uint64_t snapshotId;
+        if (currentSnapshot != cache.currentUndoSnapshotIdByProject.end() && store.contains(currentSnapshot->second)) {
+          // Not dirty, so neither generating nor comparing the state is necessary
+          snapshotId = currentSnapshot->second;
+        } else {
+          BufferedProjectStateContext recordingCtx;
+          extension.saveExtensionConfig(&recordingCtx, isUndo, reg);
+          snapshotId = store.add(recordingCtx.takeBuffer());
+          cache.currentUndoSnapshotIdByProject[project] = snapshotId;
+        }
+        ctx->AddLine("%s %llx %zu %llu", UNDO_SNAPSHOT_TOKEN, (unsigned long long) reaper.sessionId_, i,
+            (unsigned long long) snapshotId);
+        continue;
+      }
+      const auto cacheKey = std::make_pair(project, isUndo);
+      auto cachedOutput = cache.outputByProject.find(cacheKey);
+      if (cachedOutput == cache.outputByProject.end()) {
+        BufferedProjectStateContext recordingCtx;
+        extension.saveExtensionConfig(&recordingCtx, isUndo, reg);
+        cachedOutput = cache.outputByProject.emplace(cacheKey, recordingCtx.takeBuffer()).first;
+      }
+      writeLines(ctx, cachedOutput->second);
     }
   }
 
@@ -563,6 +1087,10 @@ namespace reaplus {
     return HelperControlSurface::instance().fxReordered();
   }
 
+  rxcpp::observable<Fx> Reaper::fxMoved() const {
+    return HelperControlSurface::instance().fxMoved();
+  }
+
   rxcpp::observable<Track> Reaper::trackInputMonitoringChanged() const {
     return HelperControlSurface::instance().trackInputMonitoringChanged();
   }
@@ -623,11 +1151,169 @@ namespace reaplus {
     return HelperControlSurface::instance().mainThreadIdle();
   }
 
+  rxcpp::observable<FxParameter> Reaper::fxParameterValueChanged(const FxParameter& fxParameter) const {
+    return HelperControlSurface::instance().fxParameterValueChanged(fxParameter);
+  }
+
+  rxcpp::observable<FxParameter> Reaper::fxParameterTouched(const FxParameter& fxParameter) const {
+    return HelperControlSurface::instance().fxParameterTouched(fxParameter);
+  }
+
+  rxcpp::observable<Track> Reaper::trackVolumeChanged(const Track& track) const {
+    return HelperControlSurface::instance().trackVolumeChanged(track);
+  }
+
+  rxcpp::observable<Track> Reaper::trackVolumeTouched(const Track& track) const {
+    return HelperControlSurface::instance().trackVolumeTouched(track);
+  }
+
+  rxcpp::observable<Track> Reaper::trackPanChanged(const Track& track) const {
+    return HelperControlSurface::instance().trackPanChanged(track);
+  }
+
+  rxcpp::observable<Track> Reaper::trackPanTouched(const Track& track) const {
+    return HelperControlSurface::instance().trackPanTouched(track);
+  }
+
+  rxcpp::observable<Track> Reaper::trackMuteChanged(const Track& track) const {
+    return HelperControlSurface::instance().trackMuteChanged(track);
+  }
+
+  rxcpp::observable<Track> Reaper::trackMuteTouched(const Track& track) const {
+    return HelperControlSurface::instance().trackMuteTouched(track);
+  }
+
+  rxcpp::observable<Track> Reaper::trackSoloChanged(const Track& track) const {
+    return HelperControlSurface::instance().trackSoloChanged(track);
+  }
+
+  rxcpp::observable<Track> Reaper::trackArmChanged(const Track& track) const {
+    return HelperControlSurface::instance().trackArmChanged(track);
+  }
+
+  rxcpp::observable<Track> Reaper::trackSelectedChanged(const Track& track) const {
+    return HelperControlSurface::instance().trackSelectedChanged(track);
+  }
+
+  void Reaper::startEventJournal(size_t capacity) {
+    if (eventJournals_.empty() || eventJournals_.back()->capacity() < capacity) {
+      // The previous journal is kept alive because the audio thread might still be writing into it
+      eventJournals_.push_back(std::make_unique<EventJournal>(capacity));
+    } else {
+      eventJournals_.back()->restart();
+    }
+    activeEventJournal_.store(eventJournals_.back().get());
+  }
+
+  void Reaper::stopEventJournal() {
+    activeEventJournal_.store(nullptr);
+  }
+
+  EventJournal* Reaper::activeEventJournal() const {
+    return activeEventJournal_.load(std::memory_order_relaxed);
+  }
+
+  size_t Reaper::dumpEventJournal(const std::string& filePath) const {
+    if (eventJournals_.empty()) {
+      throw std::logic_error("event journal has never been started");
+    }
+    return eventJournals_.back()->dump(filePath);
+  }
+
+  size_t Reaper::replayEventJournal(const std::string& filePath) {
+    const auto records = EventJournal::load(filePath);
+    // Don't record the replayed events, not even if replaying fails midway
+    struct ActiveEventJournalRestorer {
+      std::atomic<EventJournal*>& activeEventJournal;
+      EventJournal* const journal;
+
+      ~ActiveEventJournalRestorer() {
+        activeEventJournal.store(journal);
+      }
+    } activeEventJournalRestorer{activeEventJournal_, activeEventJournal_.exchange(nullptr)};
+    if (!replayedMidiInput_) {
+      replayedMidiInput_ = std::make_unique<ReplayedMidiInput>();
+      audioThreadReplayedMidiInput_.store(replayedMidiInput_.get(), std::memory_order_release);
+    }
+    auto& midiQueue = replayedMidiInput_->queue;
+    const auto replayMidiEvent = [&midiQueue](const EventJournalRecord& record, const unsigned char* sysExData) {
+      RawIncomingMidiEvent rawEvent{};
+      rawEvent.inputDeviceId = record.int1;
+      rawEvent.frameOffset = record.int2;
+      rawEvent.sysExSize = sysExData == nullptr ? 0 : record.flags;
+      rawEvent.size = (unsigned char) std::min((int) record.flags, 3);
+      rawEvent.bytes[0] = (unsigned char) (record.data & 0xff);
+      rawEvent.bytes[1] = (unsigned char) ((record.data >> 8) & 0xff);
+      rawEvent.bytes[2] = (unsigned char) ((record.data >> 16) & 0xff);
+      const auto overflowCountBefore = midiQueue.overflowCount();
+      midiQueue.push(rawEvent, sysExData);
+      return midiQueue.overflowCount() == overflowCountBefore;
+    };
+    // SysEx message whose payload records are still being collected. Records of other kinds can come in between.
+    boost::optional<EventJournalRecord> pendingSysExRecord;
+    std::vector<unsigned char> pendingSysExData;
+    size_t pendingSysExByteCount = 0;
+    size_t replayedCount = 0;
+    for (const auto& record : records) {
+      switch (record.kind) {
+        case EventJournalRecordKind::HookPostCommand:
+          staticHookPostCommand(record.int1, record.int2);
+          replayedCount++;
+          break;
+        case EventJournalRecordKind::IncomingMidiEvent:
+          if (record.flags > EventJournal::MAX_SYSEX_SIZE) {
+            break;
+          }
+          if (record.flags > 3) {
+            // Incomplete SysEx messages (e.g. payload overwritten in the ring buffer) are dropped
+            pendingSysExRecord = record;
+            pendingSysExData.assign(record.flags, 0);
+            pendingSysExByteCount = 0;
+          } else if (record.flags > 0 && replayMidiEvent(record, nullptr)) {
+            replayedCount++;
+          }
+          break;
+        case EventJournalRecordKind::IncomingSysExData:
+          if (!pendingSysExRecord || record.int1 != pendingSysExRecord->int1
+              || (size_t) record.int2 != pendingSysExByteCount) {
+            break;
+          }
+          pendingSysExByteCount += EventJournal::copySysExData(record, pendingSysExData.data(),
+              pendingSysExData.size());
+          if (pendingSysExByteCount == pendingSysExData.size()) {
+            if (replayMidiEvent(*pendingSysExRecord, pendingSysExData.data())) {
+              replayedCount++;
+            }
+            pendingSysExRecord = boost::none;
+          }
+          break;
+        default:
+          if (EventJournal::replayControlSurfaceRecord(record, HelperControlSurface::instance())) {
+            replayedCount++;
+          }
+          break;
+      }
+    }
+    return replayedCount;
+  }
+
   rxcpp::composite_subscription Reaper::executeLaterInMainThread(std::function<void(void)> command) {
     return HelperControlSurface::instance().enqueueCommand(std::move(command));
   }
-  void Reaper::executeLaterInMainThreadFast(std::function<void(void)> command) {
-    HelperControlSurface::instance().enqueueCommandFast(std::move(command));
+  void Reaper::executeLaterInMainThreadFast(util::InplaceTask command, MainThreadTaskPriority priority) {
+    HelperControlSurface::instance().enqueueCommandFast(std::move(command), priority);
+  }
+
+  void Reaper::setMainThreadSchedulerConfig(const MainThreadSchedulerConfig& config) {
+    HelperControlSurface::instance().mainThreadScheduler().setConfig(config);
+  }
+
+  MainThreadSchedulerMetrics Reaper::mainThreadSchedulerMetrics() const {
+    return HelperControlSurface::instance().mainThreadScheduler().metrics();
+  }
+
+  MainThreadProfiler& Reaper::mainThreadProfiler() {
+    return HelperControlSurface::instance().mainThreadProfiler();
   }
 
   rxcpp::composite_subscription Reaper::executeWhenInMainThread(std::function<void(void)> command) {
@@ -651,6 +1337,13 @@ namespace reaplus {
     return idOfMainThread_;
   }
 
+  WorkerPool& Reaper::workerPool() {
+    if (!workerPool_) {
+      workerPool_ = std::make_unique<WorkerPool>();
+    }
+    return *workerPool_;
+  }
+
   bool Reaper::currentThreadIsMainThread() const {
     return std::this_thread::get_id() == idOfMainThread_;
   }
@@ -8,6 +8,8 @@
 #include <reaplus/Project.h>
 #include <reaplus/Reaper.h>
 #include <reaplus/FxChain.h>
+#include <reaplus/util/Tracing.h>
+#include <reaplus/util/ApiCallAccounting.h>
 
 #include <reaper_plugin_functions.h>
 
@@ -52,6 +54,7 @@ namespace reaplus {
   }
 
   int Track::index() const {
+    REAPLUS_API_CALL_SCOPE("Track::index");
     loadAndCheckIfNecessaryOrComplain();
     auto ipTrackNumber = (int) (size_t) reaper::GetSetMediaTrackInfo(mediaTrack(), "IP_TRACKNUMBER", nullptr);
     if (ipTrackNumber == 0) {
@@ -68,6 +71,7 @@ namespace reaplus {
   }
 
   string Track::name() const {
+    REAPLUS_API_CALL_SCOPE("Track::name");
     loadAndCheckIfNecessaryOrComplain();
     if (isMasterTrack()) {
       return "<Master track>";
@@ -358,6 +362,8 @@ namespace reaplus {
   }
 
   bool Track::loadByGuid() const {
+    REAPLUS_TRACE_SPAN("Track::loadByGuid");
+    REAPLUS_API_CALL_SCOPE("Track::loadByGuid");
     if (reaProject_ == nullptr) {
       throw std::logic_error("For loading per GUID, a project must be given");
     }
@@ -480,6 +486,7 @@ namespace reaplus {
   }
 
   Chunk Track::chunk(int maxChunkSize, bool undoIsOptional) const {
+    REAPLUS_TRACE_SPAN("Track::chunk");
     const auto chunkString = reaplus::toSharedString(maxChunkSize, [this, undoIsOptional](char* buffer, int maxSize) {
       reaper::GetTrackStateChunk(mediaTrack(), buffer, maxSize, undoIsOptional);
     });
@@ -0,0 +1,155 @@
+#include <reaplus/WorkerPool.h>
+#include <algorithm>
+#include <reaplus/util/log.h>
+#include <reaplus/util/Tracing.h>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+namespace {
+  // Pool and worker index of the current thread if it's a worker thread
+  thread_local const reaplus::WorkerPool* CURRENT_POOL = nullptr;
+  thread_local size_t CURRENT_WORKER_INDEX = 0;
+}
+
+namespace reaplus {
+  BackgroundJobContext::BackgroundJobContext(rxcpp::composite_subscription cancellation, Clock::time_point submitTime,
+      Clock::time_point startTime) : cancellation_(std::move(cancellation)), submitTime_(submitTime),
+      startTime_(startTime) {
+  }
+
+  bool BackgroundJobContext::isCancelled() const {
+    return !cancellation_.is_subscribed();
+  }
+
+  BackgroundJobTiming BackgroundJobContext::timing() const {
+    return {
+        duration_cast<microseconds>(startTime_ - submitTime_),
+        duration_cast<microseconds>(Clock::now() - startTime_)
+    };
+  }
+
+  size_t WorkerPool::defaultThreadCount() {
+    const auto hardwareThreadCount = (size_t) std::thread::hardware_concurrency();
+    return std::clamp<size_t>(hardwareThreadCount > 0 ? hardwareThreadCount - 1 : 1, 1, 4);
+  }
+
+  WorkerPool::WorkerPool(size_t threadCount) {
+    threadCount = std::max<size_t>(threadCount, 1);
+    workers_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+      workers_.push_back(std::make_unique<Worker>());
+    }
+    // Start threads only after all workers exist because they steal from each other
+    for (size_t i = 0; i < threadCount; i++) {
+      workers_[i]->thread = std::thread([this, i] {
+        runWorker(i);
+      });
+    }
+  }
+
+  WorkerPool::~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex_);
+      isStopping_ = true;
+    }
+    wakeUpCondition_.notify_all();
+    for (auto& worker : workers_) {
+      worker->thread.join();
+    }
+    // Drop the jobs which haven't started
+    for (auto& worker : workers_) {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      pendingJobCount_ -= worker->jobs.size();
+      worker->jobs.clear();
+    }
+  }
+
+  void WorkerPool::submit(Job job, rxcpp::composite_subscription cancellation) {
+    const auto workerIndex = CURRENT_POOL == this
+        ? CURRENT_WORKER_INDEX
+        : nextWorkerIndex_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    auto& worker = *workers_[workerIndex];
+    {
+      // Incrementing under the sleep mutex prevents lost wake-ups. Incrementing before the job is published keeps
+      // the count from dropping below zero when a worker takes the job right away.
+      std::lock_guard<std::mutex> lock(sleepMutex_);
+      pendingJobCount_++;
+    }
+    try {
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.jobs.push_back({std::move(job), std::move(cancellation), Clock::now()});
+    } catch (...) {
+      pendingJobCount_--;
+      throw;
+    }
+    wakeUpCondition_.notify_one();
+  }
+
+  WorkerPoolMetrics WorkerPool::metrics() const {
+    return {
+        workers_.size(),
+        pendingJobCount_.load(),
+        executedJobCount_.load(),
+        skippedJobCount_.load(),
+        stolenJobCount_.load()
+    };
+  }
+
+  void WorkerPool::runWorker(size_t workerIndex) {
+    CURRENT_POOL = this;
+    CURRENT_WORKER_INDEX = workerIndex;
+    REAPLUS_TRACE_THREAD_NAME("Worker");
+    // Checked before each job, so that stopping doesn't wait for the whole backlog
+    while (!isStopping_) {
+      QueuedJob job;
+      if (tryTakeJob(workerIndex, job)) {
+        execute(job);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleepMutex_);
+      wakeUpCondition_.wait(lock, [this] {
+        return isStopping_ || pendingJobCount_ > 0;
+      });
+    }
+  }
+
+  bool WorkerPool::tryTakeJob(size_t workerIndex, QueuedJob& job) {
+    // Own queue first (oldest job), then steal from the others (newest job, which is least likely to be taken by
+    // the owner soon)
+    const auto workerCount = workers_.size();
+    for (size_t offset = 0; offset < workerCount; offset++) {
+      const auto isOwnQueue = offset == 0;
+      auto& worker = *workers_[(workerIndex + offset) % workerCount];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      if (worker.jobs.empty()) {
+        continue;
+      }
+      if (isOwnQueue) {
+        job = std::move(worker.jobs.front());
+        worker.jobs.pop_front();
+      } else {
+        job = std::move(worker.jobs.back());
+        worker.jobs.pop_back();
+        stolenJobCount_.fetch_add(1, std::memory_order_relaxed);
+      }
+      pendingJobCount_--;
+      return true;
+    }
+    return false;
+  }
+
+  void WorkerPool::execute(QueuedJob& job) {
+    if (!job.cancellation.is_subscribed()) {
+      skippedJobCount_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    const BackgroundJobContext context(job.cancellation, job.submitTime, Clock::now());
+    try {
+      job.job(context);
+    } catch (...) {
+      util::logException();
+    }
+    executedJobCount_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,389 @@
+#include <reaplus/util/ApiCallAccounting.h>
+#include <reaplus/util/log.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+#include <reaper_plugin.h>
+#include <reaper_plugin_functions.h>
+
+using reaplus::util::ApiCallCount;
+using reaplus::util::MAX_ACCOUNTED_API_COUNT;
+
+// REAPER API functions used by ReaPlus
+#define REAPLUS_ACCOUNTED_APIS(X) \
+    X(Audio_RegHardwareHook) \
+    X(CSurf_OnInputMonitorChangeEx) \
+    X(CSurf_OnPanChangeEx) \
+    X(CSurf_OnPlayRateChange) \
+    X(CSurf_OnRecArmChangeEx) \
+    X(CSurf_OnSendPanChange) \
+    X(CSurf_OnSendVolumeChange) \
+    X(CSurf_OnVolumeChangeEx) \
+    X(CSurf_SetSurfaceMute) \
+    X(CSurf_SetSurfacePan) \
+    X(CSurf_SetSurfaceSolo) \
+    X(CSurf_SetSurfaceVolume) \
+    X(CSurf_TrackFromID) \
+    X(CSurf_TrackToID) \
+    X(ClearConsole) \
+    X(CountSelectedTracks2) \
+    X(CountTracks) \
+    X(CreateTrackSend) \
+    X(DB2SLIDER) \
+    X(DeleteTrack) \
+    X(EnumProjects) \
+    X(GetAppVersion) \
+    X(GetCurrentProjectInLoadSave) \
+    X(GetExePath) \
+    X(GetFocusedFX) \
+    X(GetGlobalAutomationOverride) \
+    X(GetLastTouchedFX) \
+    X(GetMIDIInputName) \
+    X(GetMIDIOutputName) \
+    X(GetMainHwnd) \
+    X(GetMasterTrack) \
+    X(GetMaxMidiInputs) \
+    X(GetMaxMidiOutputs) \
+    X(GetMediaTrackInfo_Value) \
+    X(GetMidiInput) \
+    X(GetMidiOutput) \
+    X(GetResourcePath) \
+    X(GetSelectedTrack2) \
+    X(GetSetMediaTrackInfo) \
+    X(GetSetTrackSendInfo) \
+    X(GetToggleCommandState2) \
+    X(GetTrack) \
+    X(GetTrackAutomationMode) \
+    X(GetTrackEnvelopeByName) \
+    X(GetTrackNumSends) \
+    X(GetTrackSendName) \
+    X(GetTrackSendUIVolPan) \
+    X(GetTrackStateChunk) \
+    X(GetTrackUIVolPan) \
+    X(InsertTrackAtIndex) \
+    X(KBD_OnMainActionEx) \
+    X(Main_OnCommandEx) \
+    X(MarkProjectDirty) \
+    X(Master_GetPlayRate) \
+    X(Master_GetTempo) \
+    X(Master_NormalizePlayRate) \
+    X(NamedCommandLookup) \
+    X(ReverseNamedCommandLookup) \
+    X(SLIDER2DB) \
+    X(SectionFromUniqueID) \
+    X(SetCurrentBPM) \
+    X(SetMediaTrackInfo_Value) \
+    X(SetMixerScroll) \
+    X(SetOnlyTrackSelected) \
+    X(SetTrackSelected) \
+    X(SetTrackStateChunk) \
+    X(ShowConsoleMsg) \
+    X(ShowMessageBox) \
+    X(StuffMIDIMessage) \
+    X(TrackFX_AddByName) \
+    X(TrackFX_FormatParamValueNormalized) \
+    X(TrackFX_GetCount) \
+    X(TrackFX_GetEnabled) \
+    X(TrackFX_GetFXGUID) \
+    X(TrackFX_GetFXName) \
+    X(TrackFX_GetFloatingWindow) \
+    X(TrackFX_GetFormattedParamValue) \
+    X(TrackFX_GetInstrument) \
+    X(TrackFX_GetNumParams) \
+    X(TrackFX_GetOpen) \
+    X(TrackFX_GetParamEx) \
+    X(TrackFX_GetParamName) \
+    X(TrackFX_GetParamNormalized) \
+    X(TrackFX_GetParameterStepSizes) \
+    X(TrackFX_GetPreset) \
+    X(TrackFX_GetPresetIndex) \
+    X(TrackFX_GetRecCount) \
+    X(TrackFX_NavigatePresets) \
+    X(TrackFX_SetEnabled) \
+    X(TrackFX_SetParamNormalized) \
+    X(TrackFX_SetPresetByIndex) \
+    X(TrackFX_Show) \
+    X(TrackList_UpdateAllExternalSurfaces) \
+    X(Undo_BeginBlock2) \
+    X(Undo_CanRedo2) \
+    X(Undo_CanUndo2) \
+    X(Undo_DoRedo2) \
+    X(Undo_DoUndo2) \
+    X(Undo_EndBlock2) \
+    X(ValidatePtr2) \
+    X(genGuid) \
+    X(guidToString) \
+    X(kbd_RunCommandThroughHooks) \
+    X(kbd_getTextFromCmd) \
+    X(mkpanstr) \
+    X(parsepanstr) \
+    X(plugin_register)
+
+namespace {
+  // Forwards to the original function pointer after counting. One instantiation per API function pointer.
+  template<auto& FunctionPointer, typename Pointer = std::remove_reference_t<decltype(FunctionPointer)>>
+  struct Trampoline;
+
+  template<auto& FunctionPointer, typename R, typename... Args>
+  struct Trampoline<FunctionPointer, R (*)(Args...)> {
+    // Published before the trampoline is installed and never reset, so calls which are still in flight while
+    // uninstalling can complete
+    static inline std::atomic<void*> original{nullptr};
+    static inline std::atomic<int> apiIndex{0};
+
+    static R invoke(Args... args) {
+      reaplus::util::recordApiCall(apiIndex.load(std::memory_order_relaxed));
+      return reinterpret_cast<R (*)(Args...)>(original.load(std::memory_order_acquire))(args...);
+    }
+  };
+
+  struct AccountedApi {
+    const char* name;
+    void** functionPointer;
+    void* trampoline;
+    std::atomic<void*>* original;
+    std::atomic<int>* apiIndex;
+  };
+
+  template<auto& FunctionPointer>
+  AccountedApi accountedApi(const char* name) {
+    using T = Trampoline<FunctionPointer>;
+    return {
+        name,
+        reinterpret_cast<void**>(&FunctionPointer),
+        reinterpret_cast<void*>(&T::invoke),
+        &T::original,
+        &T::apiIndex
+    };
+  }
+
+#define REAPLUS_ACCOUNTED_API(name) accountedApi<reaper::name>(#name),
+  const AccountedApi ACCOUNTED_APIS[] = {
+      REAPLUS_ACCOUNTED_APIS(REAPLUS_ACCOUNTED_API)
+  };
+#undef REAPLUS_ACCOUNTED_API
+
+  constexpr int ACCOUNTED_API_COUNT = sizeof(ACCOUNTED_APIS) / sizeof(AccountedApi);
+  static_assert(ACCOUNTED_API_COUNT <= MAX_ACCOUNTED_API_COUNT, "Increase MAX_ACCOUNTED_API_COUNT");
+
+  std::atomic<bool> IS_INSTALLED{false};
+  std::atomic<uint64_t> BUDGET_VIOLATION_COUNT{0};
+  // Fixed size, so counting doesn't allocate (the audio thread calls some accounted functions, too)
+  thread_local uint64_t THREAD_COUNTS[MAX_ACCOUNTED_API_COUNT];
+  thread_local reaplus::util::ApiCallScope* CURRENT_SCOPE = nullptr;
+
+  struct ScopeAccumulator {
+    uint64_t invocationCount = 0;
+    std::array<uint64_t, MAX_ACCOUNTED_API_COUNT> counts{};
+  };
+
+  std::mutex SCOPE_REPORTS_MUTEX;
+  // Keyed by the address of the (static) scope name
+  std::unordered_map<const char*, ScopeAccumulator> SCOPE_ACCUMULATORS;
+
+  template<typename Count>
+  std::vector<ApiCallCount> toApiCallCounts(const Count* counts) {
+    std::vector<ApiCallCount> result;
+    for (int i = 0; i < ACCOUNTED_API_COUNT; i++) {
+      if (counts[i] > 0) {
+        result.push_back({ACCOUNTED_APIS[i].name, counts[i]});
+      }
+    }
+    std::sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.count > rhs.count;
+    });
+    return result;
+  }
+
+  // The function pointers are plain globals which other threads (e.g. the audio thread) might call through while
+  // they are swapped, so each one is replaced with a single atomic store
+  void storeFunctionPointer(void** functionPointer, void* value) {
+    static_assert(sizeof(std::atomic<void*>) == sizeof(void*) && std::atomic<void*>::is_always_lock_free,
+        "Function pointers can't be swapped atomically");
+    reinterpret_cast<std::atomic<void*>*>(functionPointer)->store(value, std::memory_order_release);
+  }
+
+  std::string formatApiCallCounts(const std::vector<ApiCallCount>& counts) {
+    std::ostringstream out;
+    for (size_t i = 0; i < counts.size(); i++) {
+      out << (i == 0 ? "" : ", ") << counts[i].apiName << " " << counts[i].count;
+    }
+    return out.str();
+  }
+}
+
+namespace reaplus::util {
+  void installApiCallAccounting() {
+    if (IS_INSTALLED) {
+      return;
+    }
+    for (int i = 0; i < ACCOUNTED_API_COUNT; i++) {
+      const auto& api = ACCOUNTED_APIS[i];
+      // Not all functions exist in older REAPER versions
+      if (*api.functionPointer == nullptr) {
+        continue;
+      }
+      api.original->store(*api.functionPointer, std::memory_order_release);
+      api.apiIndex->store(i, std::memory_order_relaxed);
+      storeFunctionPointer(api.functionPointer, api.trampoline);
+    }
+    IS_INSTALLED = true;
+  }
+
+  void uninstallApiCallAccounting() {
+    if (!IS_INSTALLED) {
+      return;
+    }
+    IS_INSTALLED = false;
+    for (const auto& api : ACCOUNTED_APIS) {
+      if (*api.functionPointer == api.trampoline) {
+        storeFunctionPointer(api.functionPointer, api.original->load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+  bool isApiCallAccountingInstalled() {
+    return IS_INSTALLED;
+  }
+
+  void recordApiCall(int apiIndex) {
+    THREAD_COUNTS[apiIndex]++;
+    if (CURRENT_SCOPE != nullptr) {
+      CURRENT_SCOPE->counts_[apiIndex]++;
+    }
+  }
+
+  std::vector<ApiCallCount> threadApiCallCounts() {
+    return toApiCallCounts(THREAD_COUNTS);
+  }
+
+  void resetThreadApiCallCounts() {
+    std::fill(std::begin(THREAD_COUNTS), std::end(THREAD_COUNTS), 0);
+  }
+
+  std::vector<ApiCallScopeReport> apiCallScopeReports() {
+    std::vector<ApiCallScopeReport> reports;
+    {
+      std::lock_guard<std::mutex> lock(SCOPE_REPORTS_MUTEX);
+      for (const auto& entry : SCOPE_ACCUMULATORS) {
+        const auto& accumulator = entry.second;
+        auto apiCallCounts = toApiCallCounts(accumulator.counts.data());
+        uint64_t totalCount = 0;
+        for (const auto& c : apiCallCounts) {
+          totalCount += c.count;
+        }
+        reports.push_back({entry.first, accumulator.invocationCount, totalCount, std::move(apiCallCounts)});
+      }
+    }
+    std::sort(reports.begin(), reports.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.totalApiCallCount * rhs.invocationCount > rhs.totalApiCallCount * lhs.invocationCount;
+    });
+    return reports;
+  }
+
+  std::string formatApiCallScopeReports() {
+    std::ostringstream out;
+    out << "REAPER API calls per ReaPlus method (avg calls / invocations: calls by API):\n";
+    for (const auto& report : apiCallScopeReports()) {
+      const auto average = report.invocationCount == 0 ? 0.0
+                                                       : (double) report.totalApiCallCount / report.invocationCount;
+      out << "  " << report.scopeName << ": " << average << " / " << report.invocationCount << ": "
+          << formatApiCallCounts(report.apiCallCounts) << "\n";
+    }
+    return out.str();
+  }
+
+  void resetApiCallScopeReports() {
+    std::lock_guard<std::mutex> lock(SCOPE_REPORTS_MUTEX);
+    SCOPE_ACCUMULATORS.clear();
+  }
+
+  uint64_t apiCallBudgetViolationCount() {
+    return BUDGET_VIOLATION_COUNT;
+  }
+
+  ApiCallScope::ApiCallScope(const char* name) : name_(name), isActive_(IS_INSTALLED) {
+    if (!isActive_) {
+      return;
+    }
+    counts_.fill(0);
+    parent_ = CURRENT_SCOPE;
+    CURRENT_SCOPE = this;
+  }
+
+  ApiCallScope::~ApiCallScope() {
+    if (!isActive_) {
+      return;
+    }
+    CURRENT_SCOPE = parent_;
+    if (parent_ != nullptr) {
+      for (int i = 0; i < ACCOUNTED_API_COUNT; i++) {
+        parent_->counts_[i] += counts_[i];
+      }
+    }
+    std::lock_guard<std::mutex> lock(SCOPE_REPORTS_MUTEX);
+    auto& accumulator = SCOPE_ACCUMULATORS[name_];
+    accumulator.invocationCount++;
+    for (int i = 0; i < ACCOUNTED_API_COUNT; i++) {
+      accumulator.counts[i] += counts_[i];
+    }
+  }
+
+  const char* ApiCallScope::name() const {
+    return name_;
+  }
+
+  uint64_t ApiCallScope::totalCount() const {
+    if (!isActive_) {
+      return 0;
+    }
+    uint64_t total = 0;
+    for (int i = 0; i < ACCOUNTED_API_COUNT; i++) {
+      total += counts_[i];
+    }
+    return total;
+  }
+
+  uint64_t ApiCallScope::count(const std::string& apiName) const {
+    if (!isActive_) {
+      return 0;
+    }
+    for (int i = 0; i < ACCOUNTED_API_COUNT; i++) {
+      if (apiName == ACCOUNTED_APIS[i].name) {
+        return counts_[i];
+      }
+    }
+    return 0;
+  }
+
+  std::vector<ApiCallCount> ApiCallScope::counts() const {
+    if (!isActive_) {
+      return {};
+    }
+    return toApiCallCounts(counts_.data());
+  }
+
+  ApiCallBudget::ApiCallBudget(const char* name, uint64_t maxCallCount) : ApiCallScope(name),
+      maxCallCount_(maxCallCount) {
+  }
+
+  ApiCallBudget::~ApiCallBudget() {
+    try {
+      if (isExceeded()) {
+        BUDGET_VIOLATION_COUNT++;
+        log("REAPER API call budget of " + std::string(name()) + " exceeded: " + std::to_string(totalCount())
+            + " calls instead of at most " + std::to_string(maxCallCount_)
+            + " (" + formatApiCallCounts(counts()) + ")");
+      }
+    } catch (...) {
+      logException();
+    }
+  }
+
+  bool ApiCallBudget::isExceeded() const {
+    return totalCount() > maxCallCount_;
+  }
+}
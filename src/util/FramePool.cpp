@@ -0,0 +1,77 @@
+#include <reaplus/util/FramePool.h>
+#include <new>
+
+namespace reaplus::util {
+  FramePool& FramePool::instance() {
+    static FramePool INSTANCE;
+    return INSTANCE;
+  }
+
+  FramePool::~FramePool() {
+    for (auto& sizeClass : sizeClasses_) {
+      auto block = sizeClass.head;
+      while (block != nullptr) {
+        const auto next = block->next;
+        ::operator delete(block);
+        block = next;
+      }
+    }
+  }
+
+  void* FramePool::allocate(size_t size) {
+    const auto index = sizeClassIndexOf(size);
+    if (index == SIZE_CLASS_COUNT) {
+      return ::operator new(size);
+    }
+    auto& sizeClass = sizeClasses_[index];
+    {
+      std::lock_guard<std::mutex> lock(sizeClass.mutex);
+      if (const auto block = sizeClass.head) {
+        sizeClass.head = block->next;
+        sizeClass.cachedBlockCount--;
+        return block;
+      }
+    }
+    return ::operator new(blockSizeOf(index));
+  }
+
+  void FramePool::deallocate(void* block, size_t size) noexcept {
+    if (block == nullptr) {
+      return;
+    }
+    const auto index = sizeClassIndexOf(size);
+    if (index < SIZE_CLASS_COUNT) {
+      auto& sizeClass = sizeClasses_[index];
+      std::lock_guard<std::mutex> lock(sizeClass.mutex);
+      if (sizeClass.cachedBlockCount < MAX_CACHED_BLOCK_COUNT_PER_CLASS) {
+        const auto freeBlock = static_cast<FreeBlock*>(block);
+        freeBlock->next = sizeClass.head;
+        sizeClass.head = freeBlock;
+        sizeClass.cachedBlockCount++;
+        return;
+      }
+    }
+    ::operator delete(block);
+  }
+
+  size_t FramePool::cachedBlockCount() {
+    size_t count = 0;
+    for (auto& sizeClass : sizeClasses_) {
+      std::lock_guard<std::mutex> lock(sizeClass.mutex);
+      count += sizeClass.cachedBlockCount;
+    }
+    return count;
+  }
+
+  size_t FramePool::sizeClassIndexOf(size_t size) {
+    size_t index = 0;
+    while (index < SIZE_CLASS_COUNT && blockSizeOf(index) < size) {
+      index++;
+    }
+    return index;
+  }
+
+  size_t FramePool::blockSizeOf(size_t sizeClassIndex) {
+    return MIN_BLOCK_SIZE << sizeClassIndex;
+  }
+}
@@ -0,0 +1,260 @@
+#include <reaplus/util/RealTimeSafety.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using reaplus::util::RealTimeSafetyMode;
+using reaplus::util::RealTimeViolationKind;
+
+namespace {
+  constexpr int KIND_COUNT = 4;
+  constexpr int MAX_CALL_SITE_COUNT_PER_KIND = 64;
+
+  struct CallSiteEntry {
+    std::atomic<uintptr_t> callSite{0};
+    std::atomic<bool> isCodeAddress{false};
+    std::atomic<uint64_t> count{0};
+  };
+
+  // Fixed tables, so that recording neither allocates nor locks
+  CallSiteEntry CALL_SITE_ENTRIES[KIND_COUNT][MAX_CALL_SITE_COUNT_PER_KIND];
+  std::atomic<uint64_t> UNTRACKED_CALL_SITE_COUNTS[KIND_COUNT];
+
+#ifdef REAPLUS_RT_SAFETY_CHECKS
+  std::atomic<RealTimeSafetyMode> MODE{RealTimeSafetyMode::Count};
+#else
+  std::atomic<RealTimeSafetyMode> MODE{RealTimeSafetyMode::Off};
+#endif
+
+  thread_local int REAL_TIME_SCOPE_DEPTH = 0;
+  // Prevents recursion, e.g. if the trap handler allocates
+  thread_local bool IS_RECORDING = false;
+
+  void trap() {
+#ifdef _MSC_VER
+    __debugbreak();
+#else
+    __builtin_trap();
+#endif
+  }
+
+  void record(RealTimeViolationKind kind, uintptr_t callSite, bool isCodeAddress) {
+    if (REAL_TIME_SCOPE_DEPTH == 0 || IS_RECORDING) {
+      return;
+    }
+    const auto mode = MODE.load(std::memory_order_relaxed);
+    if (mode == RealTimeSafetyMode::Off) {
+      return;
+    }
+    if (mode == RealTimeSafetyMode::Trap) {
+      trap();
+    }
+    IS_RECORDING = true;
+    const auto kindIndex = (int) kind;
+    auto& entries = CALL_SITE_ENTRIES[kindIndex];
+    const auto hash = (callSite >> 3u) * 2654435761u;
+    bool recorded = false;
+    for (int i = 0; i < MAX_CALL_SITE_COUNT_PER_KIND && !recorded; i++) {
+      auto& entry = entries[(hash + i) % MAX_CALL_SITE_COUNT_PER_KIND];
+      auto existingCallSite = entry.callSite.load(std::memory_order_acquire);
+      if (existingCallSite == 0
+          && entry.callSite.compare_exchange_strong(existingCallSite, callSite, std::memory_order_acq_rel)) {
+        entry.isCodeAddress.store(isCodeAddress, std::memory_order_relaxed);
+        existingCallSite = callSite;
+      }
+      if (existingCallSite == callSite) {
+        entry.count.fetch_add(1, std::memory_order_release);
+        recorded = true;
+      }
+    }
+    if (!recorded) {
+      UNTRACKED_CALL_SITE_COUNTS[kindIndex].fetch_add(1, std::memory_order_relaxed);
+    }
+    IS_RECORDING = false;
+  }
+
+  std::string formatCodeAddress(uintptr_t address) {
+    char buffer[2 + 2 * sizeof(uintptr_t) + 1];
+    std::snprintf(buffer, sizeof(buffer), "0x%llx", (unsigned long long) address);
+    return buffer;
+  }
+}
+
+namespace reaplus::util {
+  RealTimeScope::RealTimeScope() {
+    REAL_TIME_SCOPE_DEPTH++;
+  }
+
+  RealTimeScope::~RealTimeScope() {
+    REAL_TIME_SCOPE_DEPTH--;
+  }
+
+  bool isInRealTimeScope() {
+    return REAL_TIME_SCOPE_DEPTH > 0;
+  }
+
+  void setRealTimeSafetyMode(RealTimeSafetyMode mode) {
+    MODE.store(mode, std::memory_order_relaxed);
+  }
+
+  RealTimeSafetyMode realTimeSafetyMode() {
+    return MODE.load(std::memory_order_relaxed);
+  }
+
+  void checkRealTimeSafety(RealTimeViolationKind kind, const char* callSite) {
+    record(kind, reinterpret_cast<uintptr_t>(callSite), false);
+  }
+
+  void checkRealTimeSafety(RealTimeViolationKind kind, const void* codeAddress) {
+    record(kind, reinterpret_cast<uintptr_t>(codeAddress), true);
+  }
+
+  std::vector<RealTimeViolation> realTimeViolations() {
+    std::vector<RealTimeViolation> violations;
+    for (int k = 0; k < KIND_COUNT; k++) {
+      const auto kind = (RealTimeViolationKind) k;
+      for (const auto& entry : CALL_SITE_ENTRIES[k]) {
+        const auto callSite = entry.callSite.load(std::memory_order_acquire);
+        const auto count = entry.count.load(std::memory_order_acquire);
+        // Count is zero if the entry has been claimed but not filled yet
+        if (callSite == 0 || count == 0) {
+          continue;
+        }
+        violations.push_back({
+            kind,
+            entry.isCodeAddress.load(std::memory_order_relaxed)
+            ? formatCodeAddress(callSite)
+            : std::string(reinterpret_cast<const char*>(callSite)),
+            count
+        });
+      }
+      const auto untrackedCount = UNTRACKED_CALL_SITE_COUNTS[k].load(std::memory_order_relaxed);
+      if (untrackedCount > 0) {
+        violations.push_back({kind, "", untrackedCount});
+      }
+    }
+    std::sort(violations.begin(), violations.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.count > rhs.count;
+    });
+    return violations;
+  }
+
+  void resetRealTimeViolations() {
+    for (int k = 0; k < KIND_COUNT; k++) {
+      for (auto& entry : CALL_SITE_ENTRIES[k]) {
+        entry.count.store(0, std::memory_order_relaxed);
+      }
+      UNTRACKED_CALL_SITE_COUNTS[k].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  std::string toString(RealTimeViolationKind kind) {
+    switch (kind) {
+      case RealTimeViolationKind::Allocation:
+        return "allocation";
+      case RealTimeViolationKind::Deallocation:
+        return "deallocation";
+      case RealTimeViolationKind::MutexLock:
+        return "mutex lock";
+      case RealTimeViolationKind::Logging:
+        return "logging";
+    }
+    return "";
+  }
+
+  BlockTimeHistogram::BlockTimeHistogram() {
+    reset();
+  }
+
+  void BlockTimeHistogram::record(double elapsedSeconds, double deadlineSeconds) {
+    if (deadlineSeconds <= 0) {
+      return;
+    }
+    const auto load = elapsedSeconds / deadlineSeconds;
+    const auto bucketIndex = load >= 1 ? BUCKET_COUNT - 1 : std::min((int) (load / BUCKET_WIDTH), BUCKET_COUNT - 2);
+    buckets_[bucketIndex].fetch_add(1, std::memory_order_relaxed);
+    const auto loadInPermille = (uint64_t) (load * 1000);
+    auto maxLoadInPermille = maxLoadInPermille_.load(std::memory_order_relaxed);
+    while (loadInPermille > maxLoadInPermille
+        && !maxLoadInPermille_.compare_exchange_weak(maxLoadInPermille, loadInPermille, std::memory_order_relaxed)) {
+    }
+  }
+
+  BlockTimeStatistics BlockTimeHistogram::statistics() const {
+    BlockTimeStatistics statistics{};
+    statistics.bucketWidth = BUCKET_WIDTH;
+    statistics.buckets.reserve(BUCKET_COUNT);
+    for (const auto& bucket : buckets_) {
+      const auto count = bucket.load(std::memory_order_relaxed);
+      statistics.buckets.push_back(count);
+      statistics.blockCount += count;
+    }
+    statistics.deadlineMissCount = statistics.buckets.back();
+    statistics.maxLoad = maxLoadInPermille_.load(std::memory_order_relaxed) / 1000.0;
+    return statistics;
+  }
+
+  void BlockTimeHistogram::reset() {
+    for (auto& bucket : buckets_) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    maxLoadInPermille_.store(0, std::memory_order_relaxed);
+  }
+}
+
+#ifdef REAPLUS_RT_SAFETY_CHECKS
+#ifdef _MSC_VER
+#define REAPLUS_RT_RETURN_ADDRESS() _ReturnAddress()
+#else
+#define REAPLUS_RT_RETURN_ADDRESS() __builtin_return_address(0)
+#endif
+
+// Replaced global allocation functions. Only the common forms are covered. malloc() itself can't be hooked portably.
+void* operator new(std::size_t size) {
+  reaplus::util::checkRealTimeSafety(RealTimeViolationKind::Allocation, REAPLUS_RT_RETURN_ADDRESS());
+  if (auto p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  reaplus::util::checkRealTimeSafety(RealTimeViolationKind::Allocation, REAPLUS_RT_RETURN_ADDRESS());
+  if (auto p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  if (p != nullptr) {
+    reaplus::util::checkRealTimeSafety(RealTimeViolationKind::Deallocation, REAPLUS_RT_RETURN_ADDRESS());
+  }
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  if (p != nullptr) {
+    reaplus::util::checkRealTimeSafety(RealTimeViolationKind::Deallocation, REAPLUS_RT_RETURN_ADDRESS());
+  }
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  if (p != nullptr) {
+    reaplus::util::checkRealTimeSafety(RealTimeViolationKind::Deallocation, REAPLUS_RT_RETURN_ADDRESS());
+  }
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  if (p != nullptr) {
+    reaplus::util::checkRealTimeSafety(RealTimeViolationKind::Deallocation, REAPLUS_RT_RETURN_ADDRESS());
+  }
+  std::free(p);
+}
+#endif
@@ -0,0 +1,184 @@
+#include <reaplus/util/Tracing.h>
+#include <reaplus/util/SpscRingBuffer.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using reaplus::util::SpscRingBuffer;
+using reaplus::util::TraceEvent;
+
+namespace {
+  // 768 KB per thread
+  constexpr size_t EVENT_CAPACITY_PER_THREAD = 32768;
+
+  struct ThreadTraceBuffer {
+    // Producer is the owning thread, consumer is whoever flushes (under the registry mutex)
+    SpscRingBuffer<TraceEvent> events;
+    // Changed under the registry mutex when the buffer is taken over by another thread
+    uint32_t threadIndex;
+    std::atomic<const char*> threadName{nullptr};
+    // Cleared when the owning thread exits
+    std::atomic<bool> isOwned{true};
+
+    explicit ThreadTraceBuffer(uint32_t threadIndex) : events(EVENT_CAPACITY_PER_THREAD), threadIndex(threadIndex) {
+    }
+  };
+
+  struct TraceBufferRegistry {
+    std::mutex mutex;
+    // Buffers are only removed or taken over after their thread has exited, so threads can keep a plain pointer to
+    // theirs
+    std::vector<std::unique_ptr<ThreadTraceBuffer>> buffers;
+    uint32_t nextThreadIndex = 1;
+    std::atomic<uint64_t> droppedEventCount{0};
+  };
+
+  TraceBufferRegistry& registry() {
+    static TraceBufferRegistry REGISTRY;
+    return REGISTRY;
+  }
+
+  // Gives the buffer of the current thread free when the thread exits
+  struct CurrentBufferOwner {
+    ThreadTraceBuffer* buffer = nullptr;
+
+    ~CurrentBufferOwner() {
+      if (buffer != nullptr) {
+        buffer->isOwned.store(false, std::memory_order_release);
+      }
+    }
+  };
+
+  thread_local CurrentBufferOwner CURRENT_BUFFER_OWNER;
+
+  // Takes over the buffer of an exited thread if it has no unflushed events (which would be attributed to the wrong
+  // thread), so that threads which come and go don't pile up buffers. Buffers with unflushed events are freed by the
+  // next flush. Must be called with the registry mutex held.
+  ThreadTraceBuffer* takeOverExitedBuffer(TraceBufferRegistry& r) {
+    for (const auto& buffer : r.buffers) {
+      if (buffer->isOwned.load(std::memory_order_acquire) || !buffer->events.empty()) {
+        continue;
+      }
+      buffer->threadIndex = r.nextThreadIndex++;
+      buffer->threadName = nullptr;
+      buffer->isOwned = true;
+      return buffer.get();
+    }
+    return nullptr;
+  }
+
+  ThreadTraceBuffer& currentBuffer() {
+    auto& owner = CURRENT_BUFFER_OWNER;
+    if (owner.buffer == nullptr) {
+      auto& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      owner.buffer = takeOverExitedBuffer(r);
+      if (owner.buffer == nullptr) {
+        r.buffers.push_back(std::make_unique<ThreadTraceBuffer>(r.nextThreadIndex++));
+        owner.buffer = r.buffers.back().get();
+      }
+    }
+    return *owner.buffer;
+  }
+
+  uint64_t nanosSinceEpoch() {
+    static const auto EPOCH = std::chrono::steady_clock::now();
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - EPOCH
+    ).count();
+  }
+
+  void writeJsonString(std::ostream& out, const char* value) {
+    out << '"';
+    for (auto c = value; *c != '\0'; c++) {
+      if (*c == '"' || *c == '\\') {
+        out << '\\' << *c;
+      } else if ((unsigned char) *c >= 0x20) {
+        out << *c;
+      }
+    }
+    out << '"';
+  }
+
+  void writeMicros(std::ostream& out, uint64_t nanos) {
+    out << nanos / 1000 << '.';
+    const auto fraction = nanos % 1000;
+    out << (char) ('0' + fraction / 100) << (char) ('0' + fraction / 10 % 10) << (char) ('0' + fraction % 10);
+  }
+}
+
+namespace reaplus::util {
+  TraceSpan::TraceSpan(const char* name) : name_(name), startInNanos_(nanosSinceEpoch()) {
+  }
+
+  TraceSpan::~TraceSpan() {
+    const TraceEvent event{name_, startInNanos_, nanosSinceEpoch() - startInNanos_};
+    if (!currentBuffer().events.tryPush(event)) {
+      registry().droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void setTraceThreadName(const char* name) {
+    auto& buffer = currentBuffer();
+    if (buffer.threadName.load(std::memory_order_relaxed) != name) {
+      buffer.threadName = name;
+    }
+  }
+
+  size_t flushTraceToChromeJson(const std::string& filePath) {
+    std::ofstream file(filePath, std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("couldn't open trace file for writing");
+    }
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    size_t eventCount = 0;
+    bool isFirst = true;
+    const auto beginEvent = [&file, &isFirst] {
+      file << (isFirst ? "\n" : ",\n");
+      isFirst = false;
+    };
+    file << "{\"traceEvents\":[";
+    for (const auto& buffer : r.buffers) {
+      if (const auto threadName = buffer->threadName.load()) {
+        beginEvent();
+        file << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->threadIndex << R"(,"args":{"name":)";
+        writeJsonString(file, threadName);
+        file << "}}";
+      }
+      TraceEvent event{};
+      while (buffer->events.tryPop(event)) {
+        beginEvent();
+        file << R"({"name":)";
+        writeJsonString(file, event.name);
+        file << R"(,"cat":"reaplus","ph":"X","ts":)";
+        writeMicros(file, event.startInNanos);
+        file << R"(,"dur":)";
+        writeMicros(file, event.durationInNanos);
+        file << R"(,"pid":1,"tid":)" << buffer->threadIndex << "}";
+        eventCount++;
+      }
+    }
+    // Buffers of exited threads have just been drained and are not needed anymore
+    r.buffers.erase(
+        std::remove_if(r.buffers.begin(), r.buffers.end(), [](const std::unique_ptr<ThreadTraceBuffer>& buffer) {
+          return !buffer->isOwned.load(std::memory_order_acquire);
+        }),
+        r.buffers.end()
+    );
+    file << "\n]}\n";
+    if (!file) {
+      throw std::runtime_error("couldn't write trace file");
+    }
+    return eventCount;
+  }
+
+  uint64_t droppedTraceEventCount() {
+    return registry().droppedEventCount.load(std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,70 @@
+#include <reaplus/util/UndoSnapshotStore.h>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+namespace reaplus::util {
+  UndoSnapshotStore::UndoSnapshotStore(size_t maxSnapshotCount, size_t maxTotalSize) :
+      maxSnapshotCount_(maxSnapshotCount), maxTotalSize_(maxTotalSize) {
+  }
+
+  uint64_t UndoSnapshotStore::add(std::string content) {
+    const auto contentHash = std::hash<std::string>()(content);
+    const auto candidates = snapshotByContentHash_.equal_range(contentHash);
+    for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+      if (candidate->second->content == content) {
+        touch(candidate->second);
+        return candidate->second->id;
+      }
+    }
+    const auto id = nextId_++;
+    totalSize_ += content.size();
+    snapshots_.push_front(Snapshot{id, contentHash, std::move(content)});
+    snapshotById_.emplace(id, snapshots_.begin());
+    snapshotByContentHash_.emplace(contentHash, snapshots_.begin());
+    evictExcessSnapshots();
+    return id;
+  }
+
+  const std::string* UndoSnapshotStore::find(uint64_t id) {
+    const auto snapshot = snapshotById_.find(id);
+    if (snapshot == snapshotById_.end()) {
+      return nullptr;
+    }
+    touch(snapshot->second);
+    return &snapshot->second->content;
+  }
+
+  bool UndoSnapshotStore::contains(uint64_t id) const {
+    return snapshotById_.count(id) > 0;
+  }
+
+  size_t UndoSnapshotStore::snapshotCount() const {
+    return snapshots_.size();
+  }
+
+  size_t UndoSnapshotStore::totalSize() const {
+    return totalSize_;
+  }
+
+  void UndoSnapshotStore::touch(std::list<Snapshot>::iterator snapshot) {
+    // Iterators stay valid when splicing
+    snapshots_.splice(snapshots_.begin(), snapshots_, snapshot);
+  }
+
+  void UndoSnapshotStore::evictExcessSnapshots() {
+    while (snapshots_.size() > 1 && (snapshots_.size() > maxSnapshotCount_ || totalSize_ > maxTotalSize_)) {
+      const auto oldest = std::prev(snapshots_.end());
+      const auto candidates = snapshotByContentHash_.equal_range(oldest->contentHash);
+      for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+        if (candidate->second == oldest) {
+          snapshotByContentHash_.erase(candidate);
+          break;
+        }
+      }
+      snapshotById_.erase(oldest->id);
+      totalSize_ -= oldest->content.size();
+      snapshots_.erase(oldest);
+    }
+  }
+}
@@ -1,10 +1,29 @@
 #include <reaplus/util/log.h>
 #include <boost/exception/diagnostic_information.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <concurrentqueue/blockingconcurrentqueue.h>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_sinks.h>
 #include <spdlog/sinks/msvc_sink.h>
+#include <spdlog/sinks/rotating_file_sink.h>
 #include <reaplus/util/ReaperConsoleLogSink.h>
+#include <reaplus/util/RealTimeSafety.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define REAPLUS_LOG_CALL_SITE() reinterpret_cast<uintptr_t>(_ReturnAddress())
+#else
+#define REAPLUS_LOG_CALL_SITE() reinterpret_cast<uintptr_t>(__builtin_return_address(0))
+#endif
 
 using std::vector;
 using std::shared_ptr;
@@ -18,12 +37,252 @@ using std::make_shared;
 
 namespace {
   std::once_flag ONCE_FLAG;
+
+  constexpr int CALL_SITE_TABLE_SIZE = 256;
+  constexpr uint32_t MAX_MESSAGE_COUNT_PER_CALL_SITE_AND_WINDOW = 10;
+  constexpr int64_t RATE_LIMIT_WINDOW_IN_MILLIS = 1000;
+  constexpr size_t LOG_QUEUE_CAPACITY = 1024;
+  // Longer messages are truncated in real-time threads and allocated elsewhere
+  constexpr size_t MAX_LOG_MESSAGE_LENGTH = 512;
+  const char* const TRUNCATION_MARKER = "...";
+  // Key of errors which come through getLoggingErrorHandler()
+  const char* const SHARED_ERROR_HANDLER_SITE = "getLoggingErrorHandler()";
+  constexpr size_t MAX_LOG_FILE_SIZE = 5 * 1024 * 1024;
+  constexpr size_t MAX_LOG_FILE_COUNT = 3;
+
+  struct CallSiteState {
+    std::atomic<uintptr_t> callSite{0};
+    std::atomic<int64_t> windowStartInMillis{0};
+    std::atomic<uint32_t> messageCountInWindow{0};
+    // Suppressed since the last message which got through
+    std::atomic<uint64_t> suppressedCount{0};
+  };
+
+  // Fixed table, so that rate limiting neither allocates nor locks
+  CallSiteState CALL_SITE_STATES[CALL_SITE_TABLE_SIZE];
+  std::atomic<uint64_t> SUPPRESSED_COUNT{0};
+  std::atomic<uint64_t> DROPPED_COUNT{0};
+
+  // Short messages are copied into the preallocated queue blocks instead of being allocated. Longer ones go to
+  // longText if allocating is allowed and are truncated otherwise.
+  struct LogRecord {
+    spdlog::level::level_enum level = spdlog::level::off;
+    // Marks the record which wakes up the logging thread for stopping
+    bool isStopRequest = false;
+    // False in real-time threads
+    bool mayAllocate = false;
+    size_t length = 0;
+    char text[MAX_LOG_MESSAGE_LENGTH];
+    // Only used if the message doesn't fit into text, so records of short messages don't allocate
+    std::string longText;
+
+    spdlog::string_view_t message() const {
+      if (!longText.empty()) {
+        return spdlog::string_view_t(longText.data(), longText.size());
+      }
+      return spdlog::string_view_t(text, length);
+    }
+
+    void append(const char* data, size_t size) {
+      if (!longText.empty() || (mayAllocate && length + size > MAX_LOG_MESSAGE_LENGTH)) {
+        if (longText.empty()) {
+          longText.assign(text, length);
+        }
+        longText.append(data, size);
+        return;
+      }
+      const auto count = std::min(size, MAX_LOG_MESSAGE_LENGTH - length);
+      std::memcpy(text + length, data, count);
+      length += count;
+      if (count < size) {
+        const auto markerLength = std::strlen(TRUNCATION_MARKER);
+        std::memcpy(text + MAX_LOG_MESSAGE_LENGTH - markerLength, TRUNCATION_MARKER, markerLength);
+      }
+    }
+
+    void append(const char* data) {
+      append(data, std::strlen(data));
+    }
+  };
+
+  // Never destroyed before the logging thread has been joined, so producers don't need to synchronize with stopping
+  struct AsyncLogging {
+    moodycamel::BlockingConcurrentQueue<LogRecord> queue{LOG_QUEUE_CAPACITY};
+    std::thread thread;
+    std::atomic<bool> isRunning{false};
+    // Producers which saw isRunning and haven't finished enqueuing yet
+    std::atomic<int> enqueuingProducerCount{0};
+    // Serializes writing to the single-threaded sinks while the logging thread isn't running. Held by
+    // stopAsyncLogging() while it writes the remaining records.
+    std::mutex synchronousWriteMutex;
+    bool fileSinkAdded = false;
+  };
+
+  AsyncLogging& asyncLogging() {
+    static AsyncLogging ASYNC_LOGGING;
+    return ASYNC_LOGGING;
+  }
+
+  int64_t millisSinceEpoch() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+  }
+
+  // Returns null if the table is full, in which case the call site is not rate-limited
+  CallSiteState* callSiteStateOf(uintptr_t callSite) {
+    const auto hash = (callSite >> 3u) * 2654435761u;
+    for (int i = 0; i < CALL_SITE_TABLE_SIZE; i++) {
+      auto& state = CALL_SITE_STATES[(hash + i) % CALL_SITE_TABLE_SIZE];
+      auto existingCallSite = state.callSite.load(std::memory_order_acquire);
+      if (existingCallSite == 0
+          && state.callSite.compare_exchange_strong(existingCallSite, callSite, std::memory_order_acq_rel)) {
+        return &state;
+      }
+      if (existingCallSite == callSite) {
+        return &state;
+      }
+    }
+    return nullptr;
+  }
+
+  // Returns false if the call site has exceeded its rate limit. Otherwise suppressedCount is set to the number of
+  // messages which were suppressed since the last admitted one.
+  bool admit(uintptr_t callSite, uint64_t& suppressedCount) {
+    suppressedCount = 0;
+    const auto state = callSiteStateOf(callSite);
+    if (state == nullptr) {
+      return true;
+    }
+    const auto now = millisSinceEpoch();
+    auto windowStart = state->windowStartInMillis.load(std::memory_order_relaxed);
+    if (now - windowStart >= RATE_LIMIT_WINDOW_IN_MILLIS
+        && state->windowStartInMillis.compare_exchange_strong(windowStart, now, std::memory_order_relaxed)) {
+      state->messageCountInWindow.store(0, std::memory_order_relaxed);
+    }
+    const auto previousMessageCount = state->messageCountInWindow.fetch_add(1, std::memory_order_relaxed);
+    if (previousMessageCount >= MAX_MESSAGE_COUNT_PER_CALL_SITE_AND_WINDOW) {
+      state->suppressedCount.fetch_add(1, std::memory_order_relaxed);
+      SUPPRESSED_COUNT.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    suppressedCount = state->suppressedCount.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  void write(const LogRecord& record) {
+    reaplus::util::getMainLogger().log(record.level, record.message());
+  }
+
+  // Reports suppressed messages of call sites which have been quiet for a whole window, so that they don't wait for
+  // the next admitted message
+  void reportQuietSuppressedMessages() {
+    const auto now = millisSinceEpoch();
+    for (auto& state : CALL_SITE_STATES) {
+      if (state.suppressedCount.load(std::memory_order_relaxed) == 0
+          || now - state.windowStartInMillis.load(std::memory_order_relaxed) < RATE_LIMIT_WINDOW_IN_MILLIS) {
+        continue;
+      }
+      const auto suppressedCount = state.suppressedCount.exchange(0, std::memory_order_relaxed);
+      if (suppressedCount > 0) {
+        reaplus::util::getMainLogger().warn("{} similar messages were suppressed", suppressedCount);
+      }
+    }
+  }
+
+  void runLoggingThread(AsyncLogging& logging) {
+    LogRecord record;
+    while (true) {
+      try {
+        if (logging.queue.wait_dequeue_timed(record, std::chrono::milliseconds(RATE_LIMIT_WINDOW_IN_MILLIS))) {
+          if (record.isStopRequest) {
+            while (logging.queue.try_dequeue(record)) {
+              if (!record.isStopRequest) {
+                write(record);
+              }
+            }
+            reaplus::util::getMainLogger().flush();
+            return;
+          }
+          write(record);
+          if (logging.queue.size_approx() > 0) {
+            continue;
+          }
+        }
+        reportQuietSuppressedMessages();
+        reaplus::util::getMainLogger().flush();
+      } catch (...) {
+        // Nowhere to report this
+      }
+    }
+  }
+
+  // Doesn't allocate unless the message text does, so it's safe in real-time threads as long as messages are rare
+  // (moodycamel allocates once for each new producer thread)
+  template<typename WriteText>
+  void submit(uintptr_t callSite, spdlog::level::level_enum level, WriteText&& writeText) {
+    uint64_t suppressedCount;
+    if (!admit(callSite, suppressedCount)) {
+      return;
+    }
+    LogRecord record;
+    record.level = level;
+    record.mayAllocate = !reaplus::util::isInRealTimeScope();
+    writeText(record);
+    if (suppressedCount > 0) {
+      char note[64];
+      const auto noteLength = std::snprintf(note, sizeof(note), "\n(%llu similar messages were suppressed before)",
+          (unsigned long long) suppressedCount);
+      record.append(note, (size_t) std::max(noteLength, 0));
+    }
+    auto& logging = asyncLogging();
+    // Announcing the enqueue before checking isRunning lets stopAsyncLogging() wait for producers which saw it set
+    logging.enqueuingProducerCount.fetch_add(1);
+    if (logging.isRunning.load()) {
+      if (!logging.queue.try_enqueue(std::move(record))) {
+        DROPPED_COUNT.fetch_add(1, std::memory_order_relaxed);
+      }
+      logging.enqueuingProducerCount.fetch_sub(1);
+      return;
+    }
+    logging.enqueuingProducerCount.fetch_sub(1);
+    std::lock_guard<std::mutex> lock(logging.synchronousWriteMutex);
+    write(record);
+  }
+
+  // Must be called while handling an exception
+  void submitCurrentException(uintptr_t callSite) {
+    submit(callSite, spdlog::level::err, [](LogRecord& record) {
+      if (!reaplus::util::isInRealTimeScope()) {
+        // Richer, but allocates
+        const auto text = boost::current_exception_diagnostic_information();
+        record.append(text.data(), text.size());
+        return;
+      }
+      try {
+        throw;
+      } catch (const std::exception& e) {
+        record.append(e.what());
+      } catch (...) {
+        record.append("unknown exception");
+      }
+    });
+  }
+
+  void submitException(uintptr_t callSite, const std::exception_ptr& exception) {
+    try {
+      if (exception) {
+        std::rethrow_exception(exception);
+      }
+    } catch (...) {
+      submitCurrentException(callSite);
+    }
+  }
 }
 
 namespace reaplus::util {
   spdlog::sinks_init_list& getDefaultLogSinks() {
     // Create sinks
-    // TODO Log to file in user home instead of to console
     static auto consoleSink = make_shared<stdout_sink_st>();
     static auto reaperSink = make_shared<ReaperConsoleLogSink>();
 #if defined(_WIN32) && defined(HELGOBOSS_DEBUG)
@@ -51,22 +310,86 @@ namespace reaplus::util {
   }
 
   void log(const std::string& msg) {
-    // TODO Async logging: https://github.com/gabime/spdlog/wiki/6.-Asynchronous-logging
     // TODO Create per-service loggers https://github.com/gabime/spdlog/issues/630
-    getMainLogger().info(msg);
+    REAPLUS_RT_CHECK(Logging);
+    submit(REAPLUS_LOG_CALL_SITE(), spdlog::level::info, [&msg](LogRecord& record) {
+      record.append(msg.data(), msg.size());
+    });
   }
 
   void logException() {
-    getMainLogger().error(boost::current_exception_diagnostic_information());
+    REAPLUS_RT_CHECK(Logging);
+    // The diagnostic information is only built if the message is not suppressed
+    submitCurrentException(REAPLUS_LOG_CALL_SITE());
+  }
+
+  void logException(const char* site) {
+    REAPLUS_RT_CHECK(Logging);
+    submitCurrentException(reinterpret_cast<uintptr_t>(site));
+  }
+
+  void startAsyncLogging(const std::string& logFilePath) {
+    auto& logging = asyncLogging();
+    if (logging.isRunning) {
+      return;
+    }
+    // Sinks are only touched while no logging thread is running
+    if (!logFilePath.empty() && !logging.fileSinkAdded) {
+      try {
+        getMainLogger().sinks().push_back(
+            make_shared<spdlog::sinks::rotating_file_sink_st>(logFilePath, MAX_LOG_FILE_SIZE, MAX_LOG_FILE_COUNT)
+        );
+        logging.fileSinkAdded = true;
+      } catch (...) {
+        logException();
+      }
+    }
+    logging.thread = std::thread([&logging] {
+      runLoggingThread(logging);
+    });
+    logging.isRunning.store(true, std::memory_order_release);
+  }
+
+  void stopAsyncLogging() {
+    auto& logging = asyncLogging();
+    if (!logging.isRunning) {
+      return;
+    }
+    LogRecord stopRequest;
+    stopRequest.isStopRequest = true;
+    logging.queue.enqueue(stopRequest);
+    logging.thread.join();
+    // Producers which find isRunning cleared wait for the lock, so they don't write to the sinks while the records
+    // which were enqueued after the stop request are written
+    std::lock_guard<std::mutex> lock(logging.synchronousWriteMutex);
+    logging.isRunning.store(false);
+    while (logging.enqueuingProducerCount.load() > 0) {
+      std::this_thread::yield();
+    }
+    LogRecord record;
+    while (logging.queue.try_dequeue(record)) {
+      write(record);
+    }
+    getMainLogger().flush();
+  }
+
+  LogStatistics logStatistics() {
+    return {SUPPRESSED_COUNT.load(), DROPPED_COUNT.load()};
   }
 
   std::function<void(std::exception_ptr)>& getLoggingErrorHandler() {
     static std::function<void(std::exception_ptr)> loggingErrorHandler = [](auto ep) {
-      util::logException();
+      submitException(reinterpret_cast<uintptr_t>(SHARED_ERROR_HANDLER_SITE), ep);
     };
     return loggingErrorHandler;
   }
 
+  std::function<void(std::exception_ptr)> makeLoggingErrorHandler(const char* site) {
+    return [site](std::exception_ptr ep) {
+      submitException(reinterpret_cast<uintptr_t>(site), ep);
+    };
+  }
+
   std::function<void(std::exception_ptr)>& getRethrowErrorHandler() {
     static std::function<void(std::exception_ptr)> rethrowErrorHandler = [](auto ep) {
       if (ep) {
@@ -75,4 +398,4 @@ namespace reaplus::util {
     };
     return rethrowErrorHandler;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,119 @@
+#include <catch.hpp>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <reaplus/Coroutines.h>
+
+// Coroutines.h is empty if the compiler doesn't support coroutines
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+using reaplus::MainThreadTask;
+using reaplus::after;
+using reaplus::nextValue;
+using namespace std::chrono_literals;
+
+namespace {
+  // Sets the given flag when the coroutine frame it lives in is destroyed
+  struct DestructionFlag {
+    bool& isDestroyed;
+
+    ~DestructionFlag() {
+      isDestroyed = true;
+    }
+  };
+
+  MainThreadTask collectTwoValues(rxcpp::observable<int> values, std::vector<int>& receivedValues) {
+    receivedValues.push_back(co_await nextValue(values));
+    receivedValues.push_back(co_await nextValue(values));
+  }
+
+  MainThreadTask continueWithNextValue(rxcpp::observable<int> values, bool& isDestroyed, bool& hasContinued) {
+    DestructionFlag destructionFlag{isDestroyed};
+    co_await nextValue(values);
+    hasContinued = true;
+  }
+
+  MainThreadTask continueAfter(std::chrono::milliseconds delay, rxcpp::observe_on_one_worker coordination,
+      bool& isDestroyed, bool& hasContinued) {
+    DestructionFlag destructionFlag{isDestroyed};
+    co_await after(delay, coordination);
+    hasContinued = true;
+  }
+
+  // Dispatches the run loop until the given condition holds or the timeout has passed
+  template<typename Condition>
+  void dispatchUntil(rxcpp::schedulers::run_loop& runLoop, Condition&& condition,
+      std::chrono::milliseconds timeout = 1s) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!condition() && std::chrono::steady_clock::now() < deadline) {
+      while (!runLoop.empty() && runLoop.peek().when <= runLoop.now()) {
+        runLoop.dispatch();
+      }
+      std::this_thread::sleep_for(1ms);
+    }
+  }
+}
+
+TEST_CASE("nextValue() resumes the coroutine with each emitted value") {
+  rxcpp::subjects::subject<int> subject;
+  std::vector<int> receivedValues;
+  const auto task = collectTwoValues(subject.get_observable(), receivedValues);
+  REQUIRE(!task.isDone());
+  subject.get_subscriber().on_next(1);
+  REQUIRE(receivedValues == std::vector<int>{1});
+  REQUIRE(!task.isDone());
+  subject.get_subscriber().on_next(2);
+  REQUIRE(receivedValues == std::vector<int>{1, 2});
+  REQUIRE(task.isDone());
+  // Values after the coroutine finished go nowhere
+  subject.get_subscriber().on_next(3);
+  REQUIRE(receivedValues.size() == 2);
+}
+
+TEST_CASE("cancel() destroys a coroutine which waits for the next value") {
+  rxcpp::subjects::subject<int> subject;
+  bool isDestroyed = false;
+  bool hasContinued = false;
+  auto task = continueWithNextValue(subject.get_observable(), isDestroyed, hasContinued);
+  REQUIRE(subject.has_observers());
+  task.cancel();
+  REQUIRE(isDestroyed);
+  REQUIRE(task.isDone());
+  subject.get_subscriber().on_next(1);
+  REQUIRE(!hasContinued);
+  // Cancelling again is harmless
+  task.cancel();
+}
+
+TEST_CASE("after() resumes the coroutine once the delay has passed") {
+  rxcpp::schedulers::run_loop runLoop;
+  const auto coordination = rxcpp::observe_on_run_loop(runLoop);
+  bool isDestroyed = false;
+  bool hasContinued = false;
+  const auto startTime = std::chrono::steady_clock::now();
+  const auto task = continueAfter(20ms, coordination, isDestroyed, hasContinued);
+  REQUIRE(!hasContinued);
+  dispatchUntil(runLoop, [&] {
+    return hasContinued;
+  });
+  REQUIRE(hasContinued);
+  REQUIRE(std::chrono::steady_clock::now() - startTime >= 20ms);
+  REQUIRE(isDestroyed);
+  REQUIRE(task.isDone());
+}
+
+TEST_CASE("cancel() stops a coroutine which waits for a delay") {
+  rxcpp::schedulers::run_loop runLoop;
+  const auto coordination = rxcpp::observe_on_run_loop(runLoop);
+  bool isDestroyed = false;
+  bool hasContinued = false;
+  auto task = continueAfter(10ms, coordination, isDestroyed, hasContinued);
+  task.cancel();
+  REQUIRE(isDestroyed);
+  dispatchUntil(runLoop, [] {
+    return false;
+  }, 50ms);
+  REQUIRE(!hasContinued);
+}
+
+#endif
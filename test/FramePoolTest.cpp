@@ -0,0 +1,56 @@
+#include <catch.hpp>
+#include <memory>
+#include <vector>
+#include <reaplus/util/FramePool.h>
+
+using reaplus::util::FramePool;
+using reaplus::util::FramePoolAllocator;
+
+TEST_CASE("FramePool reuses freed blocks of the same size class") {
+  FramePool pool;
+  const auto block = pool.allocate(100);
+  pool.deallocate(block, 100);
+  REQUIRE(pool.cachedBlockCount() == 1);
+  // 120 bytes fall into the same 128-byte class
+  const auto reusedBlock = pool.allocate(120);
+  REQUIRE(reusedBlock == block);
+  REQUIRE(pool.cachedBlockCount() == 0);
+  // Different size class
+  const auto largerBlock = pool.allocate(200);
+  REQUIRE(largerBlock != block);
+  pool.deallocate(reusedBlock, 120);
+  pool.deallocate(largerBlock, 200);
+  REQUIRE(pool.cachedBlockCount() == 2);
+}
+
+TEST_CASE("FramePool doesn't cache blocks larger than the largest size class") {
+  FramePool pool;
+  const auto block = pool.allocate(4096);
+  pool.deallocate(block, 4096);
+  REQUIRE(pool.cachedBlockCount() == 0);
+}
+
+TEST_CASE("FramePool caches a limited number of blocks per size class") {
+  FramePool pool;
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < FramePool::MAX_CACHED_BLOCK_COUNT_PER_CLASS + 10; i++) {
+    blocks.push_back(pool.allocate(64));
+  }
+  for (const auto block : blocks) {
+    pool.deallocate(block, 64);
+  }
+  REQUIRE(pool.cachedBlockCount() == FramePool::MAX_CACHED_BLOCK_COUNT_PER_CLASS);
+}
+
+TEST_CASE("FramePoolAllocator serves shared state from the pool") {
+  auto& pool = FramePool::instance();
+  auto value = std::allocate_shared<int>(FramePoolAllocator<int>(), 42);
+  REQUIRE(*value == 42);
+  const auto cachedBlockCountBefore = pool.cachedBlockCount();
+  value.reset();
+  REQUIRE(pool.cachedBlockCount() == cachedBlockCountBefore + 1);
+  // The next allocation of the same size class takes the block out of the cache again
+  auto otherValue = std::allocate_shared<int>(FramePoolAllocator<int>(), 7);
+  REQUIRE(pool.cachedBlockCount() == cachedBlockCountBefore);
+  REQUIRE(*otherValue == 7);
+}
@@ -0,0 +1,48 @@
+#include <catch.hpp>
+#include <array>
+#include <functional>
+#include <concurrentqueue/concurrentqueue.h>
+#include <reaplus/util/InplaceTask.h>
+
+using reaplus::util::InplaceTask;
+
+namespace {
+  // Typical capture of a command passed from the audio thread: a few values and a pointer
+  struct Payload {
+    void* target;
+    double values[4];
+    int id;
+  };
+}
+
+TEST_CASE("Fast command queue") {
+  const Payload payload{nullptr, {1, 2, 3, 4}, 5};
+  double sum = 0;
+  moodycamel::ConcurrentQueue<std::function<void(void)>> functionQueue(1000);
+  std::array<std::function<void(void)>, 100> functionBuffer;
+  moodycamel::ConcurrentQueue<InplaceTask> taskQueue(1000);
+  std::array<InplaceTask, 100> taskBuffer;
+
+  BENCHMARK("std::function") {
+    for (int i = 0; i < 100; i++) {
+      functionQueue.enqueue([payload, &sum] { sum += payload.values[0]; });
+    }
+    const auto count = functionQueue.try_dequeue_bulk(functionBuffer.begin(), functionBuffer.size());
+    for (size_t i = 0; i < count; i++) {
+      functionBuffer[i]();
+    }
+    return count;
+  };
+
+  BENCHMARK("InplaceTask") {
+    for (int i = 0; i < 100; i++) {
+      taskQueue.enqueue([payload, &sum] { sum += payload.values[0]; });
+    }
+    const auto count = taskQueue.try_dequeue_bulk(taskBuffer.begin(), taskBuffer.size());
+    for (size_t i = 0; i < count; i++) {
+      taskBuffer[i]();
+      taskBuffer[i].reset();
+    }
+    return count;
+  };
+}
@@ -0,0 +1,17 @@
+#include <catch.hpp>
+#include <memory>
+#include <reaplus/util/InplaceTask.h>
+
+using reaplus::util::InplaceTask;
+
+TEST_CASE("InplaceTask invokes and releases its callable") {
+  auto counter = std::make_shared<int>(0);
+  InplaceTask task = [counter] { (*counter)++; };
+  InplaceTask moved = std::move(task);
+  REQUIRE(!task);
+  moved();
+  REQUIRE(*counter == 1);
+  REQUIRE(counter.use_count() == 2);
+  moved.reset();
+  REQUIRE(counter.use_count() == 1);
+}
@@ -0,0 +1,22 @@
+#include <catch.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <reaplus/util/log.h>
+
+TEST_CASE("log() keeps messages which are longer than a preallocated log record") {
+  const auto logFilePath = std::filesystem::temp_directory_path() / "reaplus-log-test.log";
+  std::filesystem::remove(logFilePath);
+  std::string message = "begin";
+  for (int i = 0; message.size() < 2000; i++) {
+    message += " " + std::to_string(i);
+  }
+  message += " end";
+  reaplus::util::startAsyncLogging(logFilePath.string());
+  reaplus::util::log(message);
+  reaplus::util::stopAsyncLogging();
+  std::ifstream logFile(logFilePath);
+  const std::string logFileContent(std::istreambuf_iterator<char>(logFile), {});
+  REQUIRE(logFileContent.find(message) != std::string::npos);
+}
@@ -0,0 +1,91 @@
+#include <catch.hpp>
+#include <chrono>
+#include <reaplus/MainThreadScheduler.h>
+
+using reaplus::MainThreadScheduler;
+using reaplus::MainThreadSchedulerConfig;
+using reaplus::MainThreadTaskPriority;
+using namespace std::chrono_literals;
+
+namespace {
+  // Busy-waits instead of sleeping, so that tasks take as long as intended
+  void busyWait(std::chrono::microseconds duration) {
+    const auto endTime = MainThreadScheduler::Clock::now() + duration;
+    while (MainThreadScheduler::Clock::now() < endTime) {
+    }
+  }
+
+  // Fixes the budget of each tick to the given duration
+  void setFixedBudget(MainThreadScheduler& scheduler, std::chrono::microseconds budget) {
+    MainThreadSchedulerConfig config;
+    config.minBudget = budget;
+    config.maxBudget = budget;
+    scheduler.setConfig(config);
+  }
+
+  void scheduleTasks(MainThreadScheduler& scheduler, MainThreadTaskPriority priority, int count,
+      std::chrono::microseconds taskDuration) {
+    for (int i = 0; i < count; i++) {
+      scheduler.schedule(priority, [taskDuration] {
+        busyWait(taskDuration);
+      });
+    }
+  }
+
+  uint64_t executedCount(const MainThreadScheduler& scheduler, MainThreadTaskPriority priority) {
+    return scheduler.metrics().classes[(int) priority].executedCount;
+  }
+}
+
+TEST_CASE("MainThreadScheduler splits the budget between priority classes according to their shares") {
+  MainThreadScheduler scheduler;
+  // Default shares are 50%, 30% and 20%
+  setFixedBudget(scheduler, 40ms);
+  scheduleTasks(scheduler, MainThreadTaskPriority::Feedback, 100, 1ms);
+  scheduleTasks(scheduler, MainThreadTaskPriority::Ui, 100, 1ms);
+  scheduleTasks(scheduler, MainThreadTaskPriority::Background, 100, 1ms);
+  scheduler.runTick(MainThreadScheduler::Clock::now());
+  const auto feedbackCount = executedCount(scheduler, MainThreadTaskPriority::Feedback);
+  const auto uiCount = executedCount(scheduler, MainThreadTaskPriority::Ui);
+  const auto backgroundCount = executedCount(scheduler, MainThreadTaskPriority::Background);
+  // Ideally 20, 12 and 8. Preemption can only make it fewer.
+  REQUIRE(feedbackCount <= 21);
+  REQUIRE(uiCount <= 13);
+  REQUIRE(backgroundCount <= 9);
+  REQUIRE(feedbackCount > uiCount);
+  REQUIRE(uiCount > backgroundCount);
+  REQUIRE(backgroundCount >= 1);
+}
+
+TEST_CASE("MainThreadScheduler runs at least one task of each class with pending work per tick") {
+  MainThreadScheduler scheduler;
+  setFixedBudget(scheduler, 2ms);
+  // A single feedback task uses up the whole budget
+  scheduleTasks(scheduler, MainThreadTaskPriority::Feedback, 2, 5ms);
+  scheduleTasks(scheduler, MainThreadTaskPriority::Ui, 2, 1ms);
+  scheduleTasks(scheduler, MainThreadTaskPriority::Background, 2, 1ms);
+  scheduler.runTick(MainThreadScheduler::Clock::now());
+  REQUIRE(executedCount(scheduler, MainThreadTaskPriority::Feedback) == 1);
+  REQUIRE(executedCount(scheduler, MainThreadTaskPriority::Ui) == 1);
+  REQUIRE(executedCount(scheduler, MainThreadTaskPriority::Background) == 1);
+  REQUIRE(scheduler.metrics().overrunCount == 1);
+}
+
+TEST_CASE("MainThreadScheduler carries tasks which didn't fit into the budget over to the next tick") {
+  MainThreadScheduler scheduler;
+  setFixedBudget(scheduler, 5ms);
+  const int taskCount = 50;
+  scheduleTasks(scheduler, MainThreadTaskPriority::Background, taskCount, 1ms);
+  scheduler.runTick(MainThreadScheduler::Clock::now());
+  const auto countAfterFirstTick = executedCount(scheduler, MainThreadTaskPriority::Background);
+  REQUIRE(countAfterFirstTick >= 1);
+  REQUIRE(countAfterFirstTick <= 6);
+  REQUIRE(scheduler.metrics().classes[(int) MainThreadTaskPriority::Background].queueDepth
+      == taskCount - countAfterFirstTick);
+  scheduler.runTick(MainThreadScheduler::Clock::now());
+  REQUIRE(executedCount(scheduler, MainThreadTaskPriority::Background) > countAfterFirstTick);
+  for (int i = 0; i < taskCount && executedCount(scheduler, MainThreadTaskPriority::Background) < taskCount; i++) {
+    scheduler.runTick(MainThreadScheduler::Clock::now());
+  }
+  REQUIRE(executedCount(scheduler, MainThreadTaskPriority::Background) == taskCount);
+}
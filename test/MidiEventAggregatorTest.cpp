@@ -0,0 +1,135 @@
+#include <catch.hpp>
+#include <vector>
+#include <reaplus/IncomingMidiEventQueue.h>
+#include <reaplus/MidiEventAggregator.h>
+
+using reaplus::CompositeMidiEvent;
+using reaplus::MidiAggregationConfig;
+using reaplus::MidiEventAggregator;
+using reaplus::RawIncomingMidiEvent;
+
+namespace {
+  const int DEVICE_ID = 3;
+
+  class CollectingSink : public MidiEventAggregator::Sink {
+  public:
+    std::vector<CompositeMidiEvent> events;
+
+    void emit(const CompositeMidiEvent& event) override {
+      events.push_back(event);
+    }
+  };
+
+  RawIncomingMidiEvent controlChange(uint8_t channel, uint8_t controllerNumber, uint8_t value, double time = 0) {
+    RawIncomingMidiEvent event{};
+    event.time = time;
+    event.inputDeviceId = DEVICE_ID;
+    event.size = 3;
+    event.bytes[0] = (unsigned char) (0xB0 | channel);
+    event.bytes[1] = controllerNumber;
+    event.bytes[2] = value;
+    return event;
+  }
+
+  MidiAggregationConfig configWith14BitController(uint8_t msbControllerNumber) {
+    MidiAggregationConfig config;
+    config.controllerPairs14Bit.push_back({DEVICE_ID, msbControllerNumber});
+    return config;
+  }
+}
+
+TEST_CASE("MidiEventAggregator combines declared 14-bit controller pairs") {
+  MidiEventAggregator aggregator(configWith14BitController(2));
+  CollectingSink sink;
+  REQUIRE(aggregator.process(controlChange(0, 2, 0x10), sink));
+  REQUIRE(sink.events.empty());
+  REQUIRE(aggregator.process(controlChange(0, 34, 0x05), sink));
+  REQUIRE(sink.events.size() == 1);
+  const auto& event = sink.events[0];
+  REQUIRE(event.type == CompositeMidiEvent::Type::ControlChange14Bit);
+  REQUIRE(event.is14Bit);
+  REQUIRE(event.number == 2);
+  REQUIRE(event.value == ((0x10 << 7) | 0x05));
+  // Nothing left pending
+  aggregator.flushExpired(1.0, sink);
+  REQUIRE(sink.events.size() == 1);
+}
+
+TEST_CASE("MidiEventAggregator passes undeclared controllers through") {
+  MidiEventAggregator aggregator(MidiAggregationConfig{});
+  CollectingSink sink;
+  // Modulation, volume, pan and expression are plain 7-bit controllers
+  for (const uint8_t controllerNumber : {1, 7, 10, 11}) {
+    REQUIRE(!aggregator.process(controlChange(0, controllerNumber, 64), sink));
+  }
+  REQUIRE(!aggregator.process(controlChange(0, 33, 64), sink));
+  aggregator.flushExpired(1.0, sink);
+  REQUIRE(sink.events.empty());
+}
+
+TEST_CASE("MidiEventAggregator emits MSB alone after timeout") {
+  auto config = configWith14BitController(2);
+  config.timeoutInSeconds = 0.01;
+  MidiEventAggregator aggregator(config);
+  CollectingSink sink;
+  REQUIRE(aggregator.process(controlChange(0, 2, 0x10, 1.0), sink));
+  aggregator.flushExpired(1.005, sink);
+  REQUIRE(sink.events.empty());
+  aggregator.flushExpired(1.02, sink);
+  REQUIRE(sink.events.size() == 1);
+  REQUIRE(sink.events[0].type == CompositeMidiEvent::Type::ControlChange14Bit);
+  REQUIRE(!sink.events[0].is14Bit);
+  REQUIRE(sink.events[0].value == (0x10 << 7));
+}
+
+TEST_CASE("MidiEventAggregator combines NRPN data entry") {
+  MidiEventAggregator aggregator(MidiAggregationConfig{});
+  CollectingSink sink;
+  REQUIRE(aggregator.process(controlChange(1, 99, 0x01), sink));
+  REQUIRE(aggregator.process(controlChange(1, 98, 0x02), sink));
+  REQUIRE(aggregator.process(controlChange(1, 6, 0x40), sink));
+  REQUIRE(aggregator.process(controlChange(1, 38, 0x03), sink));
+  REQUIRE(sink.events.size() == 1);
+  const auto& event = sink.events[0];
+  REQUIRE(event.type == CompositeMidiEvent::Type::Nrpn);
+  REQUIRE(event.channel == 1);
+  REQUIRE(event.number == ((0x01 << 7) | 0x02));
+  REQUIRE(event.value == ((0x40 << 7) | 0x03));
+  REQUIRE(event.is14Bit);
+  REQUIRE(event.delta == 0);
+}
+
+TEST_CASE("MidiEventAggregator reports NRPN increment and decrement") {
+  MidiEventAggregator aggregator(MidiAggregationConfig{});
+  CollectingSink sink;
+  aggregator.process(controlChange(0, 99, 0x00), sink);
+  aggregator.process(controlChange(0, 98, 0x07), sink);
+  aggregator.process(controlChange(0, 6, 0x20), sink);
+  aggregator.process(controlChange(0, 38, 0x01), sink);
+  sink.events.clear();
+  REQUIRE(aggregator.process(controlChange(0, 96, 0x00), sink));
+  REQUIRE(aggregator.process(controlChange(0, 97, 0x00), sink));
+  REQUIRE(sink.events.size() == 2);
+  REQUIRE(sink.events[0].type == CompositeMidiEvent::Type::Nrpn);
+  REQUIRE(sink.events[0].number == 0x07);
+  REQUIRE(sink.events[0].delta == 1);
+  REQUIRE(sink.events[0].value == ((0x20 << 7) | 0x01));
+  REQUIRE(sink.events[1].delta == -1);
+}
+
+TEST_CASE("MidiEventAggregator reports RPN decrement after MSB-only data entry") {
+  MidiEventAggregator aggregator(MidiAggregationConfig{});
+  CollectingSink sink;
+  aggregator.process(controlChange(0, 101, 0x00), sink);
+  aggregator.process(controlChange(0, 100, 0x00), sink);
+  aggregator.process(controlChange(0, 6, 0x02), sink);
+  // Decrement completes the pending MSB first
+  REQUIRE(aggregator.process(controlChange(0, 97, 0x00), sink));
+  REQUIRE(sink.events.size() == 2);
+  REQUIRE(sink.events[0].type == CompositeMidiEvent::Type::Rpn);
+  REQUIRE(!sink.events[0].is14Bit);
+  REQUIRE(sink.events[0].delta == 0);
+  REQUIRE(sink.events[1].type == CompositeMidiEvent::Type::Rpn);
+  REQUIRE(sink.events[1].delta == -1);
+  REQUIRE(sink.events[1].value == (0x02 << 7));
+}
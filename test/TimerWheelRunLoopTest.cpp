@@ -0,0 +1,102 @@
+#include <catch.hpp>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <reaplus/util/rx-timer-wheel-runloop.hpp>
+
+using rxcpp::schedulers::schedulable;
+using rxcpp::schedulers::timer_wheel_run_loop;
+using std::chrono::milliseconds;
+
+namespace {
+  const int64_t NOT_FIRED = -1;
+
+  // Schedules items with random delays and advances by random jumps, so that items end up in all levels of the wheel
+  // and beyond it. Checks after each jump that exactly the due items have fired.
+  class TimerWheelDriver {
+  private:
+    timer_wheel_run_loop runLoop_;
+    rxcpp::schedulers::worker worker_;
+    // All times are relative to this one in milliseconds
+    timer_wheel_run_loop::clock_type::time_point baseTime_;
+    int64_t now_ = 0;
+    std::vector<int64_t> dueTimes_;
+    std::vector<int64_t> fireTimes_;
+
+  public:
+    TimerWheelDriver() :
+        worker_(runLoop_.get_scheduler().create_worker()),
+        baseTime_(runLoop_.now()) {
+    }
+
+    void schedule(int64_t delay) {
+      const auto id = dueTimes_.size();
+      dueTimes_.push_back(now_ + delay);
+      fireTimes_.push_back(NOT_FIRED);
+      worker_.schedule(
+          baseTime_ + milliseconds(now_ + delay),
+          rxcpp::schedulers::make_schedulable(worker_, [this, id](const schedulable&) {
+            fireTimes_[id] = now_;
+          })
+      );
+    }
+
+    void advance(int64_t jump) {
+      now_ += jump;
+      runLoop_.advance(baseTime_ + milliseconds(now_));
+      while (runLoop_.dispatch_ready()) {
+      }
+      runLoop_.collect_garbage();
+    }
+
+    // Returns the number of items which fired too early or which are overdue by at least one tick. The base time is
+    // not aligned to the 1 ms ticks of the wheel, so an item might only fire up to one tick after its due time.
+    int countMisfiredItems() const {
+      int count = 0;
+      for (size_t id = 0; id < dueTimes_.size(); id++) {
+        const auto hasFired = fireTimes_[id] != NOT_FIRED;
+        const auto isFiredTooEarly = hasFired && fireTimes_[id] < dueTimes_[id];
+        const auto isOverdue = !hasFired && now_ - dueTimes_[id] >= 1;
+        if (isFiredTooEarly || isOverdue) {
+          count++;
+        }
+      }
+      return count;
+    }
+  };
+}
+
+TEST_CASE("timer_wheel_run_loop fires items which are due after a long jump") {
+  TimerWheelDriver driver;
+  // Beyond all levels of the wheel
+  driver.schedule(40000000);
+  driver.schedule(5);
+  driver.advance(10);
+  REQUIRE(driver.countMisfiredItems() == 0);
+  driver.advance(39999990);
+  REQUIRE(driver.countMisfiredItems() == 0);
+  driver.advance(1);
+  REQUIRE(driver.countMisfiredItems() == 0);
+}
+
+TEST_CASE("timer_wheel_run_loop fires exactly the due items with random delays and jumps") {
+  // Fixed seed, so the test is deterministic
+  std::mt19937_64 random(1);
+  const auto randomBelow = [&random](int64_t limit) {
+    return (int64_t) (random() % (uint64_t) limit);
+  };
+  for (int round = 0; round < 50; round++) {
+    TimerWheelDriver driver;
+    for (int step = 0; step < 200; step++) {
+      const auto itemCount = randomBelow(4);
+      for (int i = 0; i < itemCount; i++) {
+        const int64_t delayLimits[] = {70, 5000, 300000, 40000000};
+        driver.schedule(randomBelow(delayLimits[randomBelow(4)]));
+      }
+      const int64_t jumpLimits[] = {3, 100, 100000, 20000000};
+      driver.advance(randomBelow(jumpLimits[randomBelow(4)]));
+      REQUIRE(driver.countMisfiredItems() == 0);
+    }
+  }
+}
@@ -0,0 +1,49 @@
+#include <catch.hpp>
+#include <string>
+#include <reaplus/util/UndoSnapshotStore.h>
+
+using reaplus::util::UndoSnapshotStore;
+
+TEST_CASE("UndoSnapshotStore stores identical states only once") {
+  UndoSnapshotStore store;
+  const auto firstId = store.add("state A");
+  const auto secondId = store.add("state B");
+  REQUIRE(firstId != secondId);
+  REQUIRE(store.add("state A") == firstId);
+  REQUIRE(store.snapshotCount() == 2);
+  REQUIRE(*store.find(firstId) == "state A");
+  REQUIRE(*store.find(secondId) == "state B");
+}
+
+TEST_CASE("UndoSnapshotStore stays bounded over many distinct states") {
+  UndoSnapshotStore store(10, 1000);
+  uint64_t lastId = 0;
+  for (int i = 0; i < 10000; i++) {
+    lastId = store.add("state " + std::to_string(i));
+    REQUIRE(store.snapshotCount() <= 10);
+    REQUIRE(store.totalSize() <= 1000);
+  }
+  REQUIRE(*store.find(lastId) == "state 9999");
+  // The oldest states are gone
+  REQUIRE(store.find(0) == nullptr);
+}
+
+TEST_CASE("UndoSnapshotStore evicts the least recently used state") {
+  UndoSnapshotStore store(2);
+  const auto firstId = store.add("state A");
+  const auto secondId = store.add("state B");
+  // Makes state B the least recently used one
+  store.find(firstId);
+  const auto thirdId = store.add("state C");
+  REQUIRE(store.contains(firstId));
+  REQUIRE(!store.contains(secondId));
+  REQUIRE(store.contains(thirdId));
+}
+
+TEST_CASE("UndoSnapshotStore keeps the latest state even if it exceeds the size limit") {
+  UndoSnapshotStore store(10, 10);
+  store.add("small");
+  const auto largeId = store.add(std::string(100, 'x'));
+  REQUIRE(store.snapshotCount() == 1);
+  REQUIRE(store.find(largeId)->size() == 100);
+}
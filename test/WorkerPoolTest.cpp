@@ -0,0 +1,50 @@
+#include <catch.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <reaplus/WorkerPool.h>
+
+using reaplus::BackgroundJobContext;
+using reaplus::WorkerPool;
+using namespace std::chrono_literals;
+
+TEST_CASE("WorkerPool executes submitted jobs") {
+  std::atomic<int> executedCount{0};
+  {
+    WorkerPool pool(2);
+    for (int i = 0; i < 10; i++) {
+      pool.submit([&executedCount](const BackgroundJobContext&) {
+        executedCount++;
+      });
+    }
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (pool.metrics().executedJobCount < 10 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(pool.metrics().pendingJobCount == 0);
+  }
+  REQUIRE(executedCount == 10);
+}
+
+TEST_CASE("Destroying the WorkerPool drops jobs which haven't started") {
+  const int jobCount = 100;
+  std::atomic<int> startedCount{0};
+  {
+    WorkerPool pool(2);
+    for (int i = 0; i < jobCount; i++) {
+      pool.submit([&startedCount](const BackgroundJobContext&) {
+        startedCount++;
+        std::this_thread::sleep_for(20ms);
+      });
+    }
+    // Let the workers start the first jobs
+    std::this_thread::sleep_for(10ms);
+  }
+  const auto startedCountAfterDestruction = startedCount.load();
+  // Running the whole backlog would take a second. Each worker might still have started one more job before it
+  // noticed the stop request.
+  REQUIRE(startedCountAfterDestruction > 0);
+  REQUIRE(startedCountAfterDestruction <= 4);
+  std::this_thread::sleep_for(50ms);
+  REQUIRE(startedCount == startedCountAfterDestruction);
+}
@@ -8,10 +8,25 @@ includes("external/**/xmake.lua")
 add_requires("spdlog", "concurrentqueue")
 add_requires("boost", { configs = { filesystem = true, exception = true}})
 
+option("rt-safety-checks")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Report allocations, mutex locks and logging in the audio thread")
+    add_defines("REAPLUS_RT_SAFETY_CHECKS")
+option_end()
+
+option("tracing")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Record trace spans of hot paths which can be exported as Chrome trace JSON")
+    add_defines("REAPLUS_TRACING")
+option_end()
+
 target("reaplus")
     set_kind("static")
     add_files("src/**/*.cpp", "src/*.cpp")
     add_defines("NOMINMAX")
+    add_options("rt-safety-checks", "tracing")
     add_includedirs("./include", { public = true})
     add_includedirs("external/reaper",
         "external/WDL/WDL/",